@@ -0,0 +1,531 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+#include <yaml.h>
+
+#include "yaml-path.h"
+#include "yaml-path-private.h"
+
+
+// Bodies of the large block scalars are replaced by a line with this prefix
+// and the index of the scalar
+#define YAML_PATH_BLOCKS_PLACEHOLDER   "yaml-path-block-"
+#define YAML_PATH_BLOCKS_CHUNK_SIZE    (64 * 1024)
+
+
+typedef struct yaml_path_blocks_decoder {
+	yaml_path_blocks_t *blocks;
+	size_t used;
+	yaml_path_blocks_handler_t *handler;
+	void *data;
+	int res;
+} yaml_path_blocks_decoder_t;
+
+
+static bool
+yaml_path_blocks_is_break (const unsigned char *c, const unsigned char *end)
+{
+	return c == end || *c == '\n' || *c == '\r';
+}
+
+static bool
+yaml_path_blocks_is_blank (const unsigned char *c, const unsigned char *end)
+{
+	return c == end || *c == ' ' || *c == '\t' || *c == '\n' || *c == '\r';
+}
+
+static bool
+yaml_path_blocks_is_marker (const unsigned char *line, const unsigned char *end, const char *marker)
+{
+	return end - line >= 3 && !memcmp(line, marker, 3) && yaml_path_blocks_is_blank(line + 3, end);
+}
+
+// Skip the rest of the line in a quoted scalar, NULL if it isn't closed
+static const unsigned char*
+yaml_path_blocks_quoted (const unsigned char *c, const unsigned char *end, unsigned char quote)
+{
+	for (; c < end; c++) {
+		if (quote == '"' && *c == '\\') {
+			c++;
+		} else if (*c == quote) {
+			if (quote == '\'' && c + 1 < end && c[1] == '\'')
+				c++;
+			else
+				return c + 1;
+		}
+	}
+	return NULL;
+}
+
+// Whether a node can start at `c`: after the indentation of the line
+// (`start` follows a document marker), after an indicator (": ", "- ", "? "
+// or the flow "[{,") or after the properties of the node
+static bool
+yaml_path_blocks_node_start (const unsigned char *start, const unsigned char *c, bool flow)
+{
+	const unsigned char *p = c;
+	while (p > start && (p[-1] == ' ' || p[-1] == '\t'))
+		p--;
+	if (p == start)
+		return true;
+	if (flow && (p[-1] == '[' || p[-1] == '{' || p[-1] == ','))
+		return true;
+	if (p == c)
+		return false;
+	if (p[-1] == ':')
+		return true;
+	if ((p[-1] == '-' || p[-1] == '?') && (p - 1 == start || p[-2] == ' ' || p[-2] == '\t'))
+		return true;
+	const unsigned char *word = p;
+	while (word > start && word[-1] != ' ' && word[-1] != '\t')
+		word--;
+	return (*word == '!' || *word == '&') && yaml_path_blocks_node_start(start, word, flow);
+}
+
+static size_t
+yaml_path_blocks_chars (const unsigned char *c, const unsigned char *end)
+{
+	size_t chars = 0;
+	for (; c < end; c++)
+		chars += (*c & 0xc0) != 0x80;
+	return chars;
+}
+
+// Parse the block scalar header ending the content of the line (comments
+// are stripped) as in `[- ]*[key: ][properties ]|` or `--- |`; `indent` is
+// set to the indentation of the parent node (-1 for the root node), `value`
+// tells whether the scalar can be replaced (keys are not)
+static bool
+yaml_path_blocks_header (const unsigned char *line, const unsigned char *end, yaml_path_block_t *block, int *indent, bool *value)
+{
+	const unsigned char *c = line;
+	*value = true;
+	*indent = -2;
+	if (yaml_path_blocks_is_marker(line, end, "---")) {
+		*indent = -1;
+		c += 3;
+	}
+	while (c < end && (*c == ' ' || *c == '\t'))
+		c++;
+	if (*indent == -2 && c < end && (*c == '-' || *c == '?' || *c == ':')) {
+		while (c < end && (*c == '-' || *c == '?' || *c == ':') && c + 1 < end && (c[1] == ' ' || c[1] == '\t')) {
+			*indent = c - line;
+			if (*c == '?')
+				*value = false;
+			for (c++; c < end && (*c == ' ' || *c == '\t'); c++);
+		}
+	}
+
+	// Key of a block mapping
+	if (*indent != -1 && c < end && *c != '|' && *c != '>' && *c != '&' && *c != '!') {
+		const unsigned char *key = c;
+		if (*c == '\'' || *c == '"') {
+			c = yaml_path_blocks_quoted(c + 1, end, *c);
+			if (c == NULL || c == end || *c != ':')
+				return false;
+		} else {
+			if (strchr("[]{},#*%@`", *c) != NULL)
+				return false;
+			while (c < end && !(*c == ':' && c + 1 < end && (c[1] == ' ' || c[1] == '\t')))
+				c++;
+			if (c == end)
+				return false;
+		}
+		*indent = key - line;
+		for (c++; c < end && (*c == ' ' || *c == '\t'); c++);
+	}
+
+	// Properties
+	while (c < end && (*c == '&' || *c == '!')) {
+		while (c < end && *c != ' ' && *c != '\t')
+			c++;
+		while (c < end && (*c == ' ' || *c == '\t'))
+			c++;
+	}
+
+	if (c == end || (*c != '|' && *c != '>'))
+		return false;
+	if (*indent == -2) {
+		// Node on its own line, the parent indentation is a guess
+		*indent = (int)(c - line) - 1;
+		*value = false;
+	}
+	block->folded = *c++ == '>';
+	block->chomping = 0;
+	block->increment = 0;
+	for (int k = 0; k < 2 && c < end; k++, c++) {
+		if ((*c == '+' || *c == '-') && !block->chomping)
+			block->chomping = *c == '+' ? 1 : -1;
+		else if (*c >= '1' && *c <= '9' && !block->increment)
+			block->increment = *c - '0';
+		else
+			break;
+	}
+	return c == end;
+}
+
+// Find the end of the block scalar body (same rules as in the libyaml
+// scanner), false if the indentation contains tabs
+static bool
+yaml_path_blocks_body (const unsigned char *body, const unsigned char *end, int parent, yaml_path_block_t *block, const unsigned char **body_end)
+{
+	const unsigned char *line = body;
+	if (block->increment) {
+		block->indent = parent >= 0 ? parent + block->increment : block->increment;
+	} else {
+		// The first non-empty line (or a longer empty one) sets the indentation
+		size_t max_indent = 0;
+		while (line < end) {
+			const unsigned char *c = line;
+			while (c < end && *c == ' ')
+				c++;
+			if ((size_t)(c - line) > max_indent)
+				max_indent = c - line;
+			if (!yaml_path_blocks_is_break(c, end))
+				break;
+			const unsigned char *eol = memchr(c, '\n', end - c);
+			line = eol != NULL ? eol + 1 : end;
+		}
+		block->indent = max_indent;
+		if ((int)block->indent < parent + 1)
+			block->indent = parent + 1;
+		if (block->indent < 1)
+			block->indent = 1;
+		line = body;
+	}
+
+	while (line < end) {
+		const unsigned char *c = line;
+		while (c < end && *c == ' ' && (size_t)(c - line) < block->indent)
+			c++;
+		if ((size_t)(c - line) < block->indent) {
+			if (c < end && *c == '\t')
+				return false;
+			if (!yaml_path_blocks_is_break(c, end))
+				break;
+		}
+		const unsigned char *eol = memchr(c, '\n', end - c);
+		// Spaces at the end of the input are left to the parser
+		if (eol == NULL && yaml_path_blocks_is_break(c, end))
+			break;
+		line = eol != NULL ? eol + 1 : end;
+	}
+	*body_end = line;
+	return true;
+}
+
+static int
+yaml_path_blocks_add (yaml_path_blocks_t *blocks, const yaml_path_block_t *block)
+{
+	if (blocks->count == blocks->alloc) {
+		size_t alloc = blocks->alloc ? blocks->alloc * 2 : 16;
+		yaml_path_block_t *items = realloc(blocks->items, alloc * sizeof(*items));
+		if (items == NULL)
+			return -1;
+		blocks->items = items;
+		blocks->alloc = alloc;
+	}
+	blocks->items[blocks->count++] = *block;
+	return 0;
+}
+
+static int
+yaml_path_blocks_read (void *data, unsigned char *buffer, size_t size, size_t *size_read)
+{
+	yaml_path_blocks_t *blocks = data;
+	if (blocks->placeholder_pos == blocks->placeholder_size && blocks->read < blocks->count
+	    && blocks->pos == blocks->items[blocks->read].start) {
+		yaml_path_block_t *block = &blocks->items[blocks->read];
+		size_t len = block->indent + sizeof(YAML_PATH_BLOCKS_PLACEHOLDER) + 24;
+		if (len > blocks->placeholder_alloc) {
+			char *placeholder = realloc(blocks->placeholder, len);
+			if (placeholder == NULL)
+				return 0;
+			blocks->placeholder = placeholder;
+			blocks->placeholder_alloc = len;
+		}
+		memset(blocks->placeholder, ' ', block->indent);
+		blocks->placeholder_size = block->indent + snprintf(blocks->placeholder + block->indent, len - block->indent, YAML_PATH_BLOCKS_PLACEHOLDER"%zu\n", blocks->read);
+		blocks->placeholder_pos = 0;
+		block->placeholder = blocks->placeholder_size;
+		blocks->pos = block->end;
+		blocks->read++;
+	}
+
+	const unsigned char *src;
+	size_t len;
+	if (blocks->placeholder_pos < blocks->placeholder_size) {
+		src = (const unsigned char *)blocks->placeholder + blocks->placeholder_pos;
+		len = blocks->placeholder_size - blocks->placeholder_pos;
+	} else {
+		size_t next = blocks->read < blocks->count ? blocks->items[blocks->read].start : blocks->size;
+		src = blocks->input + blocks->pos;
+		len = next - blocks->pos;
+	}
+	if (len > size)
+		len = size;
+	memcpy(buffer, src, len);
+	if (blocks->placeholder_pos < blocks->placeholder_size)
+		blocks->placeholder_pos += len;
+	else
+		blocks->pos += len;
+	*size_read = len;
+	return 1;
+}
+
+static void
+yaml_path_blocks_put (yaml_path_blocks_decoder_t *dec, const unsigned char *data, size_t len)
+{
+	while (len && !dec->res) {
+		size_t n = YAML_PATH_BLOCKS_CHUNK_SIZE - dec->used;
+		if (n > len)
+			n = len;
+		memcpy(dec->blocks->chunk + dec->used, data, n);
+		dec->used += n;
+		data += n;
+		len -= n;
+		if (dec->used == YAML_PATH_BLOCKS_CHUNK_SIZE) {
+			dec->blocks->chunk[dec->used] = '\0';
+			if (!dec->handler(dec->data, dec->blocks->chunk, dec->used, false))
+				dec->res = -2;
+			dec->used = 0;
+		}
+	}
+}
+
+static void
+yaml_path_blocks_put_breaks (yaml_path_blocks_decoder_t *dec, size_t count)
+{
+	for (; count; count--)
+		yaml_path_blocks_put(dec, (const unsigned char *)"\n", 1);
+}
+
+
+/* Private API ------------------------------------------------------------- */
+
+int
+yaml_path_blocks_scan (yaml_path_blocks_t *blocks, const unsigned char *input, size_t size, size_t min_size)
+{
+	assert(blocks != NULL);
+	memset(blocks, 0, sizeof(*blocks));
+	blocks->input = input;
+	blocks->size = size;
+
+	// Only UTF-8 input is scanned
+	if (size >= 2 && ((input[0] == 0xfe && input[1] == 0xff) || (input[0] == 0xff && input[1] == 0xfe)))
+		return 0;
+
+	const unsigned char *end = input + size;
+	const unsigned char *line = input;
+	// Characters are counted as in the marks (without the byte order mark)
+	const unsigned char *counted = size >= 3 && !memcmp(input, "\xef\xbb\xbf", 3) ? input + 3 : input;
+	size_t chars = 0;
+	unsigned char quote = 0;
+	size_t flow = 0;
+	while (line < end) {
+		const unsigned char *eol = memchr(line, '\n', end - line);
+		eol = eol != NULL ? eol + 1 : end;
+		bool block_context = !quote && !flow;
+		if (block_context && *line == '%') {
+			line = eol;
+			continue;
+		}
+
+		// Quotes and flow collections span lines, comments end them
+		const unsigned char *c = line, *content_end = eol;
+		if (block_context && (yaml_path_blocks_is_marker(line, eol, "---") || yaml_path_blocks_is_marker(line, eol, "...")))
+			c += 3;
+		const unsigned char *start = c;
+		for (; c < eol; c++) {
+			if (quote) {
+				const unsigned char *q = yaml_path_blocks_quoted(c, eol, quote);
+				if (q == NULL)
+					break;
+				quote = 0;
+				c = q - 1;
+				continue;
+			}
+			if (*c == '#' && (c == line || c[-1] == ' ' || c[-1] == '\t')) {
+				content_end = c;
+				break;
+			}
+			// Quotes and brackets inside plain scalars are ignored
+			if ((*c == '\'' || *c == '"') && yaml_path_blocks_node_start(start, c, flow))
+				quote = *c;
+			else if ((*c == '[' || *c == '{') && yaml_path_blocks_node_start(start, c, flow))
+				flow++;
+			else if (flow && (*c == ']' || *c == '}'))
+				flow--;
+		}
+		while (content_end > line && yaml_path_blocks_is_blank(content_end - 1, content_end))
+			content_end--;
+
+		yaml_path_block_t block = {0};
+		int parent;
+		bool value;
+		const unsigned char *body_end;
+		if (!block_context || quote || flow || eol == end
+		    || !yaml_path_blocks_header(line, content_end, &block, &parent, &value)) {
+			line = eol;
+			continue;
+		}
+		if (!yaml_path_blocks_body(eol, end, parent, &block, &body_end)) {
+			line = eol;
+			continue;
+		}
+		if (value && (size_t)(body_end - eol) >= min_size) {
+			chars += yaml_path_blocks_chars(counted, eol);
+			counted = eol;
+			block.chars = chars;
+			block.start = eol - input;
+			block.end = body_end - input;
+			if (yaml_path_blocks_add(blocks, &block))
+				return -1;
+		}
+		line = body_end;
+	}
+
+	if (blocks->count && (blocks->chunk = malloc(YAML_PATH_BLOCKS_CHUNK_SIZE + 1)) == NULL)
+		return -1;
+	return 0;
+}
+
+void
+yaml_path_blocks_delete (yaml_path_blocks_t *blocks)
+{
+	if (blocks == NULL)
+		return;
+	free(blocks->items);
+	free(blocks->placeholder);
+	free(blocks->chunk);
+	memset(blocks, 0, sizeof(*blocks));
+}
+
+void
+yaml_path_blocks_set_parser (yaml_path_blocks_t *blocks, yaml_parser_t *parser)
+{
+	assert(blocks != NULL && parser != NULL);
+	yaml_parser_set_input(parser, yaml_path_blocks_read, blocks);
+}
+
+void
+yaml_path_blocks_mark (yaml_path_blocks_t *blocks, yaml_mark_t *mark)
+{
+	assert(blocks != NULL && mark != NULL);
+	// Bodies are at least as long as the placeholders (wrapping is fine)
+	mark->index += blocks->chars - blocks->placeholder_chars;
+	mark->line += blocks->lines - blocks->seen;
+}
+
+bool
+yaml_path_blocks_passed (yaml_path_blocks_t *blocks, const yaml_mark_t *mark)
+{
+	assert(blocks != NULL && mark != NULL);
+	if (blocks->seen == blocks->count)
+		return false;
+	const yaml_path_block_t *block = &blocks->items[blocks->seen];
+	return mark->index > block->chars - blocks->chars + blocks->placeholder_chars;
+}
+
+int
+yaml_path_blocks_event (yaml_path_blocks_t *blocks, yaml_event_t *event, size_t *idx)
+{
+	assert(blocks != NULL && event != NULL && idx != NULL);
+	*idx = SIZE_MAX;
+
+	// The first event passing the placeholder must be its scalar
+	yaml_path_block_t *block = blocks->seen < blocks->count ? &blocks->items[blocks->seen] : NULL;
+	if (block != NULL && (yaml_path_blocks_passed(blocks, &event->end_mark) || event->type == YAML_STREAM_END_EVENT)) {
+		const char *value = (const char *)event->data.scalar.value;
+		char expected[sizeof(YAML_PATH_BLOCKS_PLACEHOLDER) + 24];
+		int len = snprintf(expected, sizeof(expected), YAML_PATH_BLOCKS_PLACEHOLDER"%zu%s", blocks->seen, block->chomping < 0 ? "" : "\n");
+		if (event->type != YAML_SCALAR_EVENT
+		    || event->start_mark.index > block->chars - blocks->chars + blocks->placeholder_chars
+		    || (event->data.scalar.style != YAML_LITERAL_SCALAR_STYLE && event->data.scalar.style != YAML_FOLDED_SCALAR_STYLE)
+		    || event->data.scalar.length != (size_t)len || memcmp(value, expected, len))
+			return -1;
+	} else {
+		block = NULL;
+	}
+
+	yaml_path_blocks_mark(blocks, &event->start_mark);
+	if (block != NULL) {
+		// The marks following the placeholder are moved behind the body
+		const unsigned char *c = blocks->input + block->start, *end = blocks->input + block->end;
+		for (; c < end; c++) {
+			if ((*c & 0xc0) != 0x80)
+				blocks->chars++;
+			if (*c == '\n')
+				blocks->lines++;
+		}
+		blocks->placeholder_chars += block->placeholder;
+		*idx = blocks->seen++;
+	}
+	yaml_path_blocks_mark(blocks, &event->end_mark);
+	return 0;
+}
+
+bool
+yaml_path_blocks_done (yaml_path_blocks_t *blocks)
+{
+	assert(blocks != NULL);
+	return blocks->seen == blocks->count;
+}
+
+int
+yaml_path_blocks_decode (yaml_path_blocks_t *blocks, size_t idx, yaml_path_blocks_handler_t *handler, void *data)
+{
+	assert(blocks != NULL && idx < blocks->count && handler != NULL);
+	const yaml_path_block_t *block = &blocks->items[idx];
+	yaml_path_blocks_decoder_t dec = {.blocks = blocks, .handler = handler, .data = data};
+
+	// Line folding and chomping of the libyaml scanner
+	const unsigned char *line = blocks->input + block->start, *end = blocks->input + block->end;
+	bool leading_break = false, leading_blank = false;
+	size_t trailing_breaks = 0;
+	while (line < end && !dec.res) {
+		const unsigned char *c = line;
+		while (c < end && *c == ' ' && (size_t)(c - line) < block->indent)
+			c++;
+		const unsigned char *eol = memchr(c, '\n', end - c);
+		const unsigned char *next = eol != NULL ? eol + 1 : end;
+		if (eol == NULL)
+			eol = end;
+		else if (eol > c && eol[-1] == '\r')
+			eol--;
+		line = next;
+		if (c == eol) {
+			// Spaces at the end of the input are not a line
+			if (next > eol)
+				trailing_breaks++;
+			continue;
+		}
+
+		bool trailing_blank = *c == ' ' || *c == '\t';
+		if (block->folded && leading_break && !leading_blank && !trailing_blank) {
+			if (!trailing_breaks)
+				yaml_path_blocks_put(&dec, (const unsigned char *)" ", 1);
+		} else if (leading_break) {
+			yaml_path_blocks_put_breaks(&dec, 1);
+		}
+		yaml_path_blocks_put_breaks(&dec, trailing_breaks);
+		trailing_breaks = 0;
+		leading_blank = trailing_blank;
+		yaml_path_blocks_put(&dec, c, eol - c);
+		leading_break = next > eol;
+	}
+	if (block->chomping >= 0 && leading_break)
+		yaml_path_blocks_put_breaks(&dec, 1);
+	if (block->chomping > 0)
+		yaml_path_blocks_put_breaks(&dec, trailing_breaks);
+
+	if (!dec.res) {
+		blocks->chunk[dec.used] = '\0';
+		if (!handler(data, blocks->chunk, dec.used, true))
+			dec.res = -2;
+	}
+	return dec.res;
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "yaml-path.h"
+#include "yaml-path-private.h"
+
+
+#define YAML_PATH_BUNDLE_MAGIC         "YPBUNDL"
+#define YAML_PATH_BUNDLE_VERSION       1
+#define YAML_PATH_BUNDLE_BYTE_ORDER    0x01020304
+
+
+typedef struct yaml_path_bundle_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t paths_count;
+	uint64_t records_size;
+} yaml_path_bundle_header_t;
+
+typedef struct yaml_path_bundle_entry {
+	uint64_t offset; // Offset of the record in the records area
+	uint64_t size;
+} yaml_path_bundle_entry_t;
+
+struct yaml_path_bundle {
+	void *map;
+	size_t map_size;
+
+	const yaml_path_bundle_header_t *header;
+	const yaml_path_bundle_entry_t *entries;
+	const unsigned char *records;
+};
+
+
+/* Public API -------------------------------------------------------------- */
+
+int
+yaml_path_bundle_write (const char *file_name, yaml_path_t **paths, size_t count)
+{
+	if (file_name == NULL || (paths == NULL && count))
+		return -1;
+
+	int res = -1;
+	yaml_path_bundle_entry_t *entries = malloc((count ? count : 1) * sizeof(*entries));
+	unsigned char *records = NULL;
+	char *tmp_name = NULL;
+	FILE *f = NULL;
+	if (entries == NULL)
+		goto cleanup;
+
+	size_t records_size = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (paths[i] == NULL)
+			goto cleanup;
+		entries[i].offset = records_size;
+		entries[i].size = yaml_path_record_write(paths[i], NULL, 0);
+		if (entries[i].size == 0)
+			goto cleanup;
+		records_size += (entries[i].size + 7) & ~(size_t)7;
+	}
+	records = calloc(records_size ? records_size : 1, 1);
+	if (records == NULL)
+		goto cleanup;
+	for (size_t i = 0; i < count; i++)
+		yaml_path_record_write(paths[i], records + entries[i].offset, entries[i].size);
+
+	yaml_path_bundle_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, YAML_PATH_BUNDLE_MAGIC, sizeof(header.magic));
+	header.version = YAML_PATH_BUNDLE_VERSION;
+	header.byte_order = YAML_PATH_BUNDLE_BYTE_ORDER;
+	header.paths_count = count;
+	header.records_size = records_size;
+
+	size_t tmp_len = strlen(file_name) + 5;
+	tmp_name = malloc(tmp_len);
+	if (tmp_name == NULL)
+		goto cleanup;
+	snprintf(tmp_name, tmp_len, "%s.tmp", file_name);
+	f = fopen(tmp_name, "wb");
+	if (f != NULL
+	    && fwrite(&header, sizeof(header), 1, f) == 1
+	    && fwrite(entries, sizeof(*entries), count, f) == count
+	    && fwrite(records, 1, records_size, f) == records_size
+	    && !fclose(f)) {
+		f = NULL;
+		if (!rename(tmp_name, file_name))
+			res = 0;
+	}
+	if (res)
+		unlink(tmp_name);
+
+cleanup:
+	if (f != NULL)
+		fclose(f);
+	free(tmp_name);
+	free(records);
+	free(entries);
+	return res;
+}
+
+yaml_path_bundle_t*
+yaml_path_bundle_open (const char *file_name)
+{
+	if (file_name == NULL)
+		return NULL;
+
+	yaml_path_bundle_t *bundle = malloc(sizeof(*bundle));
+	if (bundle == NULL)
+		return NULL;
+	memset(bundle, 0, sizeof(*bundle));
+
+	int fd = open(file_name, O_RDONLY);
+	if (fd < 0)
+		goto error;
+	struct stat st;
+	if (!fstat(fd, &st) && (size_t)st.st_size >= sizeof(*bundle->header)) {
+		bundle->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (bundle->map == MAP_FAILED)
+			bundle->map = NULL;
+		bundle->map_size = st.st_size;
+	}
+	close(fd);
+	if (bundle->map == NULL)
+		goto error;
+
+	// Records are checked once they are used
+	bundle->header = bundle->map;
+	if (memcmp(bundle->header->magic, YAML_PATH_BUNDLE_MAGIC, sizeof(bundle->header->magic))
+	    || bundle->header->version != YAML_PATH_BUNDLE_VERSION
+	    || bundle->header->byte_order != YAML_PATH_BUNDLE_BYTE_ORDER
+	    || bundle->header->paths_count > (bundle->map_size - sizeof(*bundle->header)) / sizeof(*bundle->entries)
+	    || sizeof(*bundle->header) + bundle->header->paths_count * sizeof(*bundle->entries) + bundle->header->records_size != bundle->map_size)
+		goto error;
+
+	bundle->entries = (const yaml_path_bundle_entry_t *)(bundle->header + 1);
+	bundle->records = (const unsigned char *)(bundle->entries + bundle->header->paths_count);
+	return bundle;
+
+error:
+	yaml_path_bundle_close(bundle);
+	return NULL;
+}
+
+void
+yaml_path_bundle_close (yaml_path_bundle_t *bundle)
+{
+	if (bundle == NULL)
+		return;
+	if (bundle->map != NULL)
+		munmap(bundle->map, bundle->map_size);
+	free(bundle);
+}
+
+size_t
+yaml_path_bundle_count (yaml_path_bundle_t *bundle)
+{
+	if (bundle == NULL)
+		return 0;
+	return bundle->header->paths_count;
+}
+
+int
+yaml_path_bundle_get (yaml_path_bundle_t *bundle, size_t index, yaml_path_t *path)
+{
+	if (bundle == NULL || path == NULL || index >= bundle->header->paths_count)
+		return -1;
+
+	const yaml_path_bundle_entry_t *entry = &bundle->entries[index];
+	if (entry->offset % 8
+	    || entry->offset > bundle->header->records_size
+	    || entry->size > bundle->header->records_size - entry->offset)
+		return -1;
+	return yaml_path_record_read(path, bundle->records + entry->offset, entry->size);
+}
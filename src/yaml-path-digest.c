@@ -0,0 +1,348 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "yaml-path.h"
+#include "yaml-path-private.h"
+
+
+#define YAML_PATH_DIGEST_FRAMES_MIN_ALLOC    8
+#define YAML_PATH_DIGEST_PAIRS_MIN_ALLOC     16
+
+// Fixed key, digests are comparable between runs
+#define YAML_PATH_DIGEST_K0    0x0706050403020100ULL
+#define YAML_PATH_DIGEST_K1    0x0f0e0d0c0b0a0908ULL
+
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+
+typedef struct yaml_path_siphash {
+	uint64_t v[4];
+	uint64_t tail; // Bytes not hashed yet (less than 8)
+	size_t len;
+} yaml_path_siphash_t;
+
+// Hashed node (the first frame) or an open mapping whose pairs are hashed
+// one by one and then taken in the order of their digests
+struct yaml_path_digest_frame {
+	yaml_path_siphash_t hash;
+	size_t depth;
+	size_t children; // Keys and values completed so far
+	unsigned char *pairs;
+	size_t pairs_count;
+	size_t pairs_alloc;
+	char *tag; // Explicit tag of the mapping
+};
+
+
+static void
+yaml_path_siphash_init (yaml_path_siphash_t *hash)
+{
+	hash->v[0] = YAML_PATH_DIGEST_K0 ^ 0x736f6d6570736575ULL;
+	hash->v[1] = YAML_PATH_DIGEST_K1 ^ 0x646f72616e646f6dULL ^ 0xee;
+	hash->v[2] = YAML_PATH_DIGEST_K0 ^ 0x6c7967656e657261ULL;
+	hash->v[3] = YAML_PATH_DIGEST_K1 ^ 0x7465646279746573ULL;
+	hash->tail = 0;
+	hash->len = 0;
+}
+
+static inline void
+yaml_path_siphash_rounds (uint64_t *v, int rounds)
+{
+	while (rounds--) {
+		v[0] += v[1]; v[1] = ROTL(v[1], 13); v[1] ^= v[0]; v[0] = ROTL(v[0], 32);
+		v[2] += v[3]; v[3] = ROTL(v[3], 16); v[3] ^= v[2];
+		v[0] += v[3]; v[3] = ROTL(v[3], 21); v[3] ^= v[0];
+		v[2] += v[1]; v[1] = ROTL(v[1], 17); v[1] ^= v[2]; v[2] = ROTL(v[2], 32);
+	}
+}
+
+static inline void
+yaml_path_siphash_word (yaml_path_siphash_t *hash, uint64_t m)
+{
+	hash->v[3] ^= m;
+	yaml_path_siphash_rounds(hash->v, 2);
+	hash->v[0] ^= m;
+}
+
+static void
+yaml_path_siphash_update (yaml_path_siphash_t *hash, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	size_t fill = hash->len % 8;
+	hash->len += size;
+	if (fill) {
+		for (; size && fill < 8; size--, fill++)
+			hash->tail |= (uint64_t)*p++ << (8 * fill);
+		if (fill < 8)
+			return;
+		yaml_path_siphash_word(hash, hash->tail);
+		hash->tail = 0;
+	}
+	for (; size >= 8; size -= 8, p += 8) {
+		// Little-endian words (a single load on such machines)
+		uint64_t m = (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24
+		             | (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+		yaml_path_siphash_word(hash, m);
+	}
+	for (fill = 0; fill < size; fill++)
+		hash->tail |= (uint64_t)p[fill] << (8 * fill);
+}
+
+static void
+yaml_path_siphash_final (yaml_path_siphash_t *hash, unsigned char *out)
+{
+	uint64_t *v = hash->v;
+	uint64_t b = (uint64_t)hash->len << 56 | hash->tail;
+	yaml_path_siphash_word(hash, b);
+	v[2] ^= 0xee;
+	yaml_path_siphash_rounds(v, 4);
+	uint64_t h[2];
+	h[0] = v[0] ^ v[1] ^ v[2] ^ v[3];
+	v[1] ^= 0xdd;
+	yaml_path_siphash_rounds(v, 4);
+	h[1] = v[0] ^ v[1] ^ v[2] ^ v[3];
+	for (int i = 0; i < 16; i++)
+		out[i] = (unsigned char)(h[i / 8] >> (8 * (i % 8)));
+}
+
+static void
+yaml_path_digest_put_u64 (yaml_path_siphash_t *hash, uint64_t n)
+{
+	unsigned char b[8];
+	for (int i = 0; i < 8; i++)
+		b[i] = (unsigned char)(n >> (8 * i));
+	yaml_path_siphash_update(hash, b, sizeof(b));
+}
+
+// Strings are prefixed by their length, so the serialization can't be
+// ambiguous
+static void
+yaml_path_digest_put_string (yaml_path_siphash_t *hash, char type, const void *s, size_t len)
+{
+	yaml_path_siphash_update(hash, &type, 1);
+	yaml_path_digest_put_u64(hash, len);
+	yaml_path_siphash_update(hash, s, len);
+}
+
+// Tags resolved by the schema (and the non-specific one) are left out
+static bool
+yaml_path_digest_tag_is_explicit (const char *tag, const char *default_tag)
+{
+	return tag != NULL && strcmp(tag, "!") && strcmp(tag, default_tag);
+}
+
+static void
+yaml_path_digest_put_tag (yaml_path_siphash_t *hash, const char *tag, const char *default_tag)
+{
+	if (yaml_path_digest_tag_is_explicit(tag, default_tag))
+		yaml_path_digest_put_string(hash, 't', tag, strlen(tag));
+}
+
+static void
+yaml_path_digest_put_scalar (yaml_path_siphash_t *hash, const yaml_event_t *event)
+{
+	yaml_path_value_t value = {
+		.value = (const char *)event->data.scalar.value,
+		.length = event->data.scalar.length,
+		.style = event->data.scalar.style,
+		.tag = (const char *)event->data.scalar.tag,
+	};
+	yaml_path_scalar_t scalar;
+	yaml_path_scalar_resolve(&value, &scalar);
+	switch (scalar.type) {
+	case YAML_PATH_SCALAR_NULL:
+		yaml_path_siphash_update(hash, "N", 1);
+		break;
+	case YAML_PATH_SCALAR_BOOL:
+		yaml_path_siphash_update(hash, scalar.b ? "BT" : "BF", 2);
+		break;
+	case YAML_PATH_SCALAR_INT:
+		yaml_path_siphash_update(hash, "I", 1);
+		yaml_path_digest_put_u64(hash, (uint64_t)scalar.i);
+		break;
+	case YAML_PATH_SCALAR_FLOAT: {
+			// Zeros and NaNs of any sign are the same
+			double d = scalar.d == 0 ? 0 : isnan(scalar.d) ? NAN : scalar.d;
+			uint64_t bits;
+			memcpy(&bits, &d, sizeof(bits));
+			yaml_path_siphash_update(hash, "F", 1);
+			yaml_path_digest_put_u64(hash, bits);
+		}
+		break;
+	default:
+		yaml_path_digest_put_tag(hash, value.tag, YAML_STR_TAG);
+		yaml_path_digest_put_string(hash, 'S', value.value, value.length);
+		break;
+	}
+}
+
+static void
+yaml_path_digest_frame_drop (yaml_path_digest_frame_t *frame)
+{
+	free(frame->pairs);
+	free(frame->tag);
+}
+
+static void
+yaml_path_digest_reset (yaml_path_digest_t *digest)
+{
+	while (digest->frames_count)
+		yaml_path_digest_frame_drop(&digest->frames[--digest->frames_count]);
+}
+
+static yaml_path_digest_frame_t*
+yaml_path_digest_frame_push (yaml_path_digest_t *digest, size_t depth, const char *tag)
+{
+	yaml_path_digest_frame_t *frames = yaml_path_grow(digest->frames, &digest->frames_alloc, digest->frames_count, sizeof(*frames), YAML_PATH_DIGEST_FRAMES_MIN_ALLOC);
+	if (frames == NULL)
+		return NULL;
+	digest->frames = frames;
+	yaml_path_digest_frame_t *frame = &digest->frames[digest->frames_count];
+	memset(frame, 0, sizeof(*frame));
+	if (tag != NULL && (frame->tag = strdup(tag)) == NULL)
+		return NULL;
+	yaml_path_siphash_init(&frame->hash);
+	frame->depth = depth;
+	digest->frames_count++;
+	return frame;
+}
+
+static int
+yaml_path_digest_pair_compare (const void *a, const void *b)
+{
+	return memcmp(a, b, YAML_PATH_DIGEST_SIZE);
+}
+
+// The mapping is serialized into the enclosing frame with its pairs sorted
+static void
+yaml_path_digest_frame_pop (yaml_path_digest_t *digest)
+{
+	assert(digest->frames_count > 1);
+	yaml_path_digest_frame_t *frame = &digest->frames[--digest->frames_count];
+	yaml_path_siphash_t *hash = &digest->frames[digest->frames_count - 1].hash;
+	qsort(frame->pairs, frame->pairs_count, YAML_PATH_DIGEST_SIZE, yaml_path_digest_pair_compare);
+	yaml_path_siphash_update(hash, "{", 1);
+	yaml_path_digest_put_tag(hash, frame->tag, YAML_MAP_TAG);
+	yaml_path_digest_put_string(hash, 'P', frame->pairs, frame->pairs_count * YAML_PATH_DIGEST_SIZE);
+	yaml_path_digest_frame_drop(frame);
+}
+
+// The node ended, the digest is passed on once it's the matched one
+static int
+yaml_path_digest_node_end (yaml_path_digest_t *digest, size_t depth)
+{
+	yaml_path_digest_frame_t *frame = &digest->frames[digest->frames_count - 1];
+	unsigned char out[YAML_PATH_DIGEST_SIZE];
+	if (depth == 1) {
+		yaml_path_siphash_final(&frame->hash, out);
+		yaml_path_digest_reset(digest);
+		if (digest->handler != NULL)
+			digest->handler(digest->handler_data, out);
+		return 0;
+	}
+	if (frame->depth + 1 != depth || ++frame->children % 2)
+		return 0;
+
+	// Key and value of a sorted mapping
+	unsigned char *pairs = yaml_path_grow(frame->pairs, &frame->pairs_alloc, frame->pairs_count, YAML_PATH_DIGEST_SIZE, YAML_PATH_DIGEST_PAIRS_MIN_ALLOC);
+	if (pairs == NULL)
+		return -1;
+	frame->pairs = pairs;
+	yaml_path_siphash_final(&frame->hash, frame->pairs + frame->pairs_count++ * YAML_PATH_DIGEST_SIZE);
+	yaml_path_siphash_init(&frame->hash);
+	return 0;
+}
+
+
+/* Public API -------------------------------------------------------------- */
+
+void
+yaml_path_digest_init (yaml_path_digest_t *digest, int sort_keys, yaml_path_digest_handler_t *handler, void *data)
+{
+	if (digest == NULL)
+		return;
+	memset(digest, 0, sizeof(*digest));
+	digest->sort_keys = sort_keys;
+	digest->handler = handler;
+	digest->handler_data = data;
+}
+
+void
+yaml_path_digest_delete (yaml_path_digest_t *digest)
+{
+	if (digest == NULL)
+		return;
+	yaml_path_digest_reset(digest);
+	free(digest->frames);
+	digest->frames = NULL;
+	digest->frames_alloc = 0;
+}
+
+void
+yaml_path_digest_node_handler (void *data, const yaml_event_t *event, size_t depth)
+{
+	yaml_path_digest_t *digest = data;
+	if (digest == NULL || event == NULL || !depth)
+		return;
+
+	bool end = event->type == YAML_MAPPING_END_EVENT || event->type == YAML_SEQUENCE_END_EVENT;
+	if (depth == 1 && !end) {
+		yaml_path_digest_reset(digest);
+		if (yaml_path_digest_frame_push(digest, 0, NULL) == NULL) {
+			digest->error = 1;
+			return;
+		}
+	}
+	// Skipped after an error
+	if (!digest->frames_count)
+		return;
+
+	yaml_path_siphash_t *hash = &digest->frames[digest->frames_count - 1].hash;
+	int res = 0;
+	switch (event->type) {
+	case YAML_MAPPING_START_EVENT:
+		if (digest->sort_keys) {
+			const char *tag = (const char *)event->data.mapping_start.tag;
+			if (yaml_path_digest_frame_push(digest, depth, yaml_path_digest_tag_is_explicit(tag, YAML_MAP_TAG) ? tag : NULL) == NULL)
+				res = -1;
+		} else {
+			yaml_path_siphash_update(hash, "{", 1);
+			yaml_path_digest_put_tag(hash, (const char *)event->data.mapping_start.tag, YAML_MAP_TAG);
+		}
+		break;
+	case YAML_SEQUENCE_START_EVENT:
+		yaml_path_siphash_update(hash, "[", 1);
+		yaml_path_digest_put_tag(hash, (const char *)event->data.sequence_start.tag, YAML_SEQ_TAG);
+		break;
+	case YAML_MAPPING_END_EVENT:
+		if (digest->sort_keys)
+			yaml_path_digest_frame_pop(digest);
+		else
+			yaml_path_siphash_update(hash, "}", 1);
+		res = yaml_path_digest_node_end(digest, depth);
+		break;
+	case YAML_SEQUENCE_END_EVENT:
+		yaml_path_siphash_update(hash, "]", 1);
+		res = yaml_path_digest_node_end(digest, depth);
+		break;
+	case YAML_SCALAR_EVENT:
+		yaml_path_digest_put_scalar(hash, event);
+		res = yaml_path_digest_node_end(digest, depth);
+		break;
+	case YAML_ALIAS_EVENT:
+		// Aliases are not resolved
+		yaml_path_digest_put_string(hash, '*', event->data.alias.anchor, strlen((const char *)event->data.alias.anchor));
+		res = yaml_path_digest_node_end(digest, depth);
+		break;
+	default:
+		break;
+	}
+	if (res) {
+		digest->error = 1;
+		yaml_path_digest_reset(digest);
+	}
+}
@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "yaml-path.h"
+#include "yaml-path-private.h"
+
+
+#define YAML_PATH_DOM_NODES_MIN_ALLOC      64
+#define YAML_PATH_DOM_FRAMES_MIN_ALLOC     16
+#define YAML_PATH_DOM_STRINGS_MIN_ALLOC    256 // Power of two
+// Longer strings (block scalars mostly) are copied without interning
+#define YAML_PATH_DOM_INTERN_MAX           64
+
+#define YAML_PATH_DOM_ALIGN    sizeof(void *)
+
+
+struct yaml_path_dom_string {
+	const char *value; // NULL for free slots
+	size_t length;
+	uint32_t hash;
+};
+
+
+static char*
+yaml_path_dom_copy (yaml_path_dom_t *dom, const char *value, size_t length)
+{
+	char *copy = yaml_path_arena_alloc(&dom->blocks, length + 1, 1);
+	if (copy != NULL) {
+		memcpy(copy, value, length);
+		copy[length] = '\0';
+	}
+	return copy;
+}
+
+// FNV-1a
+static uint32_t
+yaml_path_dom_hash (const char *value, size_t length)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)value[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static int
+yaml_path_dom_strings_grow (yaml_path_dom_t *dom)
+{
+	size_t alloc = dom->strings_alloc ? dom->strings_alloc * 2 : YAML_PATH_DOM_STRINGS_MIN_ALLOC;
+	yaml_path_dom_string_t *strings = calloc(alloc, sizeof(*strings));
+	if (strings == NULL)
+		return -1;
+	for (size_t i = 0; i < dom->strings_alloc; i++) {
+		if (dom->strings[i].value == NULL)
+			continue;
+		size_t idx = dom->strings[i].hash & (alloc - 1);
+		while (strings[idx].value != NULL)
+			idx = (idx + 1) & (alloc - 1);
+		strings[idx] = dom->strings[i];
+	}
+	free(dom->strings);
+	dom->strings = strings;
+	dom->strings_alloc = alloc;
+	return 0;
+}
+
+static const char*
+yaml_path_dom_intern (yaml_path_dom_t *dom, const char *value, size_t length)
+{
+	if (length > YAML_PATH_DOM_INTERN_MAX)
+		return yaml_path_dom_copy(dom, value, length);
+	if (dom->strings_count * 2 >= dom->strings_alloc && yaml_path_dom_strings_grow(dom))
+		return NULL;
+
+	uint32_t hash = yaml_path_dom_hash(value, length);
+	size_t idx = hash & (dom->strings_alloc - 1);
+	for (; dom->strings[idx].value != NULL; idx = (idx + 1) & (dom->strings_alloc - 1)) {
+		yaml_path_dom_string_t *string = &dom->strings[idx];
+		if (string->hash == hash && string->length == length && !memcmp(string->value, value, length))
+			return string->value;
+	}
+	const char *copy = yaml_path_dom_copy(dom, value, length);
+	if (copy == NULL)
+		return NULL;
+	dom->strings[idx].value = copy;
+	dom->strings[idx].length = length;
+	dom->strings[idx].hash = hash;
+	dom->strings_count++;
+	return copy;
+}
+
+static yaml_path_dom_node_t*
+yaml_path_dom_node_push (yaml_path_dom_t *dom)
+{
+	yaml_path_dom_node_t *nodes = yaml_path_grow(dom->roots, &dom->nodes_alloc, dom->nodes_count, sizeof(*nodes), YAML_PATH_DOM_NODES_MIN_ALLOC);
+	if (nodes == NULL)
+		return NULL;
+	dom->roots = nodes;
+	yaml_path_dom_node_t *node = &dom->roots[dom->nodes_count++];
+	memset(node, 0, sizeof(*node));
+	return node;
+}
+
+static int
+yaml_path_dom_frame_push (yaml_path_dom_t *dom, size_t pos)
+{
+	size_t *frames = yaml_path_grow(dom->frames, &dom->frames_alloc, dom->frames_count, sizeof(*frames), YAML_PATH_DOM_FRAMES_MIN_ALLOC);
+	if (frames == NULL)
+		return -1;
+	dom->frames = frames;
+	dom->frames[dom->frames_count++] = pos;
+	return 0;
+}
+
+// Tag and anchor of the node
+static int
+yaml_path_dom_node_props (yaml_path_dom_t *dom, yaml_path_dom_node_t *node, const yaml_char_t *tag, const yaml_char_t *anchor)
+{
+	if (tag != NULL && (node->tag = yaml_path_dom_intern(dom, (const char *)tag, strlen((const char *)tag))) == NULL)
+		return -1;
+	if (anchor != NULL && (node->anchor = yaml_path_dom_intern(dom, (const char *)anchor, strlen((const char *)anchor))) == NULL)
+		return -1;
+	return 0;
+}
+
+
+/* Public API -------------------------------------------------------------- */
+
+void
+yaml_path_dom_init (yaml_path_dom_t *dom)
+{
+	if (dom == NULL)
+		return;
+	memset(dom, 0, sizeof(*dom));
+}
+
+void
+yaml_path_dom_delete (yaml_path_dom_t *dom)
+{
+	if (dom == NULL)
+		return;
+	yaml_path_arena_free(&dom->blocks, false);
+	free(dom->strings);
+	free(dom->frames);
+	free(dom->roots);
+	yaml_path_dom_init(dom);
+}
+
+void
+yaml_path_dom_node_handler (void *data, const yaml_event_t *event, size_t depth)
+{
+	yaml_path_dom_t *dom = data;
+	if (dom == NULL || event == NULL || !depth)
+		return;
+
+	bool end = event->type == YAML_MAPPING_END_EVENT || event->type == YAML_SEQUENCE_END_EVENT;
+	// Pending nodes of an unfinished match are dropped
+	if (depth == 1 && !end) {
+		dom->nodes_count = dom->count;
+		dom->frames_count = 0;
+	}
+	if (end) {
+		// Skipped after an error
+		if (depth != dom->frames_count)
+			return;
+		size_t pos = dom->frames[--dom->frames_count];
+		size_t count = dom->nodes_count - pos - 1;
+		if (count) {
+			yaml_path_dom_node_t *children = yaml_path_arena_alloc(&dom->blocks, count * sizeof(*children), YAML_PATH_DOM_ALIGN);
+			if (children == NULL)
+				goto error;
+			memcpy(children, &dom->roots[pos + 1], count * sizeof(*children));
+			dom->roots[pos].children = children;
+		}
+		dom->roots[pos].length = count;
+		dom->nodes_count = pos + 1;
+	} else {
+		if (depth != dom->frames_count + 1)
+			return;
+		yaml_path_dom_node_t *node;
+		switch (event->type) {
+		case YAML_SCALAR_EVENT:
+			if ((node = yaml_path_dom_node_push(dom)) == NULL)
+				goto error;
+			node->type = YAML_PATH_DOM_SCALAR;
+			node->style = event->data.scalar.style;
+			node->length = event->data.scalar.length;
+			node->value = yaml_path_dom_intern(dom, (const char *)event->data.scalar.value, event->data.scalar.length);
+			if (node->value == NULL || yaml_path_dom_node_props(dom, node, event->data.scalar.tag, event->data.scalar.anchor))
+				goto error;
+			break;
+		case YAML_ALIAS_EVENT:
+			if ((node = yaml_path_dom_node_push(dom)) == NULL)
+				goto error;
+			node->type = YAML_PATH_DOM_ALIAS;
+			if (yaml_path_dom_node_props(dom, node, NULL, event->data.alias.anchor))
+				goto error;
+			break;
+		case YAML_SEQUENCE_START_EVENT:
+			if ((node = yaml_path_dom_node_push(dom)) == NULL)
+				goto error;
+			node->type = YAML_PATH_DOM_SEQUENCE;
+			if (yaml_path_dom_node_props(dom, node, event->data.sequence_start.tag, event->data.sequence_start.anchor)
+			    || yaml_path_dom_frame_push(dom, dom->nodes_count - 1))
+				goto error;
+			return;
+		case YAML_MAPPING_START_EVENT:
+			if ((node = yaml_path_dom_node_push(dom)) == NULL)
+				goto error;
+			node->type = YAML_PATH_DOM_MAPPING;
+			if (yaml_path_dom_node_props(dom, node, event->data.mapping_start.tag, event->data.mapping_start.anchor)
+			    || yaml_path_dom_frame_push(dom, dom->nodes_count - 1))
+				goto error;
+			return;
+		default:
+			return;
+		}
+	}
+
+	// The matched node is complete
+	if (depth == 1)
+		dom->count = dom->nodes_count;
+	return;
+
+error:
+	dom->error = 1;
+	dom->nodes_count = dom->count;
+	dom->frames_count = 0;
+}
+
+const yaml_path_dom_node_t*
+yaml_path_dom_mapping_get (const yaml_path_dom_node_t *mapping, const char *key)
+{
+	if (mapping == NULL || key == NULL || mapping->type != YAML_PATH_DOM_MAPPING)
+		return NULL;
+	size_t length = strlen(key);
+	for (size_t i = 0; i + 1 < mapping->length; i += 2) {
+		const yaml_path_dom_node_t *child = &mapping->children[i];
+		if (child->type == YAML_PATH_DOM_SCALAR && child->length == length && !memcmp(child->value, key, length))
+			return &mapping->children[i + 1];
+	}
+	return NULL;
+}
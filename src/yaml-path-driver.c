@@ -0,0 +1,1774 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include <yaml.h>
+
+#include "yaml-path.h"
+#include "yaml-path-private.h"
+
+
+// Huge sequences are parsed in parallel in chunks of items of at least this
+// size
+#define YAML_PATH_DRIVER_CHUNK_MIN_SIZE (64 * 1024)
+#define YAML_PATH_DRIVER_MAX_THREADS    64
+
+#define YAML_PATH_DRIVER_FEED_EVENTS_MIN_ALLOC 64
+
+
+typedef struct yaml_path_driver_scan {
+	size_t pos;  // Start of the current document candidate
+	size_t line; // Next line to scan
+	size_t doc;  // Position of the '---' marker of the current document
+	bool content;
+	bool directives; // Before the '---' marker, they start the document
+} yaml_path_driver_scan_t;
+
+// Characters and lines of the input before a position (counted as by the
+// marks), parts of the input are parsed with the marks moved by them
+typedef struct yaml_path_driver_cursor {
+	size_t pos;
+	size_t chars;
+	size_t lines;
+} yaml_path_driver_cursor_t;
+
+// Item boundaries of a huge sequence, the first chunk starts at the start
+// of the input
+typedef struct yaml_path_driver_split {
+	size_t count;
+	size_t pos[YAML_PATH_DRIVER_MAX_THREADS + 1];
+	size_t chars[YAML_PATH_DRIVER_MAX_THREADS + 1]; // Characters before `pos`
+	size_t lines[YAML_PATH_DRIVER_MAX_THREADS + 1];
+} yaml_path_driver_split_t;
+
+// Chunk of the input parsed by its own parser, items of the chunks following
+// the first one are preceded by the key of the sequence (`prefix`); events of
+// the first one go to the `output` driver right away, except the last three
+typedef struct yaml_path_driver_chunk {
+	const unsigned char *input;
+	size_t size;
+	const char *prefix;
+	size_t prefix_size;
+	size_t pos;
+	size_t index_offset; // Marks of the events are moved by the offsets
+	size_t line_offset;
+	int flow;
+
+	yaml_path_t *path;
+	yaml_event_t *events;
+	size_t events_count;
+	size_t events_alloc;
+	yaml_path_driver_t *output;
+	size_t emitted;
+	bool output_failed;
+	int res;
+	pthread_t thread;
+	bool started;
+} yaml_path_driver_chunk_t;
+
+// Large block scalar decoded in one piece
+typedef struct yaml_path_driver_string {
+	char *data;
+	size_t size;
+	size_t alloc;
+} yaml_path_driver_string_t;
+
+struct yaml_path_driver {
+	yaml_emitter_t *emitter;
+	yaml_path_event_handler_t *handler;
+	void *handler_data;
+	int flow;
+	size_t threads;
+
+	// Limits are checked only when any is set
+	yaml_path_limits_t limits;
+	bool limited;
+	size_t depth;
+	size_t events;
+	size_t output_bytes;
+	struct timespec deadline;
+	yaml_write_handler_t *emitter_write_handler;
+	void *emitter_write_handler_data;
+
+	yaml_event_type_t prev_event_type;
+	yaml_path_filter_result_t prev_result;
+	size_t output_skip; // Events sent by the parallel run before its fallback
+
+	// Parsing stops once the path matches `count_limit` nodes
+	size_t count_limit;
+	bool stopped;
+
+	// Parser for the string and file descriptor inputs
+	yaml_parser_t parser;
+
+	// Parser input is a part of a larger input starting at `origin_start`
+	bool origin_set;
+	yaml_mark_t origin_start;
+	yaml_mark_t origin;
+
+	// Byte offsets of the matches in the string or the pushed input
+	const unsigned char *offset_input;
+	size_t offset_size;
+	size_t offset_base; // Bytes dropped from the start of the input
+	yaml_path_driver_cursor_t offset_cursor;
+
+	// Incremental input, documents are parsed once they are complete (or the
+	// entries of their root collections, see below)
+	unsigned char *feed_buffer;
+	size_t feed_size;
+	size_t feed_alloc;
+	yaml_path_driver_scan_t feed_scan;
+	yaml_path_driver_cursor_t feed_cursor; // Relative to the buffer
+	size_t feed_documents;
+	bool feed_started;
+	bool feed_raw; // No raw scan possible, everything is parsed at the end
+
+	// Entries of the root collection of the open document are filtered once
+	// the next one starts, the rest is parsed at the end of the document if
+	// they don't parse on their own
+	bool feed_open;
+	bool feed_open_failed;
+	yaml_event_type_t feed_open_root;
+	size_t feed_open_pos;    // Start of the next entry
+	size_t feed_entry_line;  // Next line to scan for the start of an entry
+	bool feed_entry;
+	size_t feed_open_events; // Events sent for the document
+	yaml_path_driver_cursor_t feed_open_cursor; // At the start of the document
+	yaml_event_t *feed_events; // Of an entry, sent once they are checked
+	size_t feed_events_alloc;
+
+	// Large block scalars of the string input are decoded by the driver
+	size_t block_min_size;
+	yaml_path_chunk_handler_t *chunk_handler;
+	void *chunk_handler_data;
+	yaml_path_blocks_t blocks;
+	bool blocks_active;
+	bool blocks_mismatch; // The input is parsed without the placeholders then
+	size_t blocks_events; // Events passed before the mismatch
+	const yaml_path_driver_cursor_t *blocks_cursor; // Of a part of the input
+	bool block_matched;
+	yaml_path_value_t block_value;
+
+	yaml_path_error_t error;
+};
+
+
+static void
+yaml_path_driver_error_set (yaml_path_driver_t *driver, yaml_path_error_type_t error_type, const char *message, size_t pos)
+{
+	assert(driver != NULL);
+	driver->error.type = error_type;
+	driver->error.message = message;
+	driver->error.pos = pos;
+}
+
+static void
+yaml_path_driver_input_error_set (yaml_path_driver_t *driver, yaml_parser_t *parser)
+{
+	switch (parser->error) {
+	case YAML_MEMORY_ERROR:
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for parsing", 0);
+		break;
+	case YAML_READER_ERROR:
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_INPUT, parser->problem, parser->problem_offset);
+		break;
+	case YAML_SCANNER_ERROR:
+	case YAML_PARSER_ERROR:
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_INPUT, parser->problem, parser->problem_mark.index);
+		break;
+	default:
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_INPUT, "Unable to parse the input", 0);
+		break;
+	}
+}
+
+// How often the deadline is checked (in events)
+#define YAML_PATH_DRIVER_DEADLINE_EVENTS 256
+
+static int
+yaml_path_driver_limits_check (yaml_path_driver_t *driver, yaml_event_t *event)
+{
+	const yaml_path_limits_t *limits = &driver->limits;
+	size_t pos = event->start_mark.index;
+
+	driver->events++;
+	if (limits->max_events && driver->events > limits->max_events) {
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_LIMIT_EVENTS, "Too many events", pos);
+		return -1;
+	}
+
+	switch (event->type) {
+	case YAML_SEQUENCE_START_EVENT:
+	case YAML_MAPPING_START_EVENT:
+		driver->depth++;
+		if (limits->max_depth && driver->depth > limits->max_depth) {
+			yaml_path_driver_error_set(driver, YAML_PATH_ERROR_LIMIT_DEPTH, "Nesting is too deep", pos);
+			return -1;
+		}
+		break;
+	case YAML_SEQUENCE_END_EVENT:
+	case YAML_MAPPING_END_EVENT:
+		driver->depth--;
+		break;
+	case YAML_SCALAR_EVENT:
+		if (limits->max_scalar_length && event->data.scalar.length > limits->max_scalar_length) {
+			yaml_path_driver_error_set(driver, YAML_PATH_ERROR_LIMIT_SCALAR, "Scalar is too long", pos);
+			return -1;
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (limits->timeout_ms && !(driver->events % YAML_PATH_DRIVER_DEADLINE_EVENTS)) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (now.tv_sec > driver->deadline.tv_sec
+		    || (now.tv_sec == driver->deadline.tv_sec && now.tv_nsec >= driver->deadline.tv_nsec)) {
+			yaml_path_driver_error_set(driver, YAML_PATH_ERROR_LIMIT_DEADLINE, "Deadline exceeded", pos);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// Counts the emitter output, installed for the time of a run
+static int
+yaml_path_driver_write_handler (void *data, unsigned char *buffer, size_t size)
+{
+	yaml_path_driver_t *driver = data;
+	driver->output_bytes += size;
+	if (driver->output_bytes > driver->limits.max_output_bytes)
+		return 0;
+	return driver->emitter_write_handler(driver->emitter_write_handler_data, buffer, size);
+}
+
+static void
+yaml_path_driver_output_release (yaml_path_driver_t *driver)
+{
+	if (driver->emitter_write_handler == NULL)
+		return;
+	driver->emitter->write_handler = driver->emitter_write_handler;
+	driver->emitter->write_handler_data = driver->emitter_write_handler_data;
+	driver->emitter_write_handler = NULL;
+	driver->emitter_write_handler_data = NULL;
+}
+
+static int
+yaml_path_driver_output (yaml_path_driver_t *driver, yaml_event_t *event)
+{
+	if (driver->output_skip) {
+		driver->output_skip--;
+		yaml_event_delete(event);
+		return 0;
+	}
+	if (driver->limited && driver->limits.max_output_bytes) {
+		if (driver->emitter != NULL && driver->emitter_write_handler == NULL) {
+			driver->emitter_write_handler = driver->emitter->write_handler;
+			driver->emitter_write_handler_data = driver->emitter->write_handler_data;
+			driver->emitter->write_handler = yaml_path_driver_write_handler;
+			driver->emitter->write_handler_data = driver;
+		} else if (driver->emitter == NULL && driver->handler != NULL && event->type == YAML_SCALAR_EVENT) {
+			driver->output_bytes += event->data.scalar.length;
+			if (driver->output_bytes > driver->limits.max_output_bytes) {
+				yaml_event_delete(event);
+				yaml_path_driver_error_set(driver, YAML_PATH_ERROR_LIMIT_OUTPUT, "Output is too large", 0);
+				return -1;
+			}
+		}
+	}
+
+	if (driver->emitter != NULL) {
+		if (!yaml_emitter_emit(driver->emitter, event)) {
+			if (driver->emitter->error == YAML_MEMORY_ERROR)
+				yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for emitting", 0);
+			else if (driver->emitter->error == YAML_WRITER_ERROR
+			         && driver->limited && driver->output_bytes > driver->limits.max_output_bytes)
+				yaml_path_driver_error_set(driver, YAML_PATH_ERROR_LIMIT_OUTPUT, "Output is too large", 0);
+			else
+				yaml_path_driver_error_set(driver, YAML_PATH_ERROR_OUTPUT, driver->emitter->problem, 0);
+			return -1;
+		}
+	} else if (driver->handler != NULL) {
+		int res = driver->handler(driver->handler_data, event);
+		yaml_event_delete(event);
+		if (!res) {
+			yaml_path_driver_error_set(driver, YAML_PATH_ERROR_OUTPUT, "Output handler failed", 0);
+			return -1;
+		}
+	} else {
+		yaml_event_delete(event);
+	}
+	return 0;
+}
+
+// The value of the placeholder scalar is seen by the value handler of the
+// path, it's only noted
+static void
+yaml_path_driver_block_value (void *data, const yaml_path_value_t *value)
+{
+	yaml_path_driver_t *driver = data;
+	driver->block_matched = true;
+	driver->block_value = *value;
+}
+
+static int
+yaml_path_driver_block_chunk (void *data, const char *chunk, size_t size, bool last)
+{
+	yaml_path_driver_t *driver = data;
+	yaml_path_value_t value = driver->block_value;
+	value.value = chunk;
+	value.length = size;
+	if (driver->limited && driver->limits.max_output_bytes) {
+		driver->output_bytes += size;
+		if (driver->output_bytes > driver->limits.max_output_bytes)
+			return 0;
+	}
+	return driver->chunk_handler(driver->chunk_handler_data, &value, last);
+}
+
+static int
+yaml_path_driver_block_string (void *data, const char *chunk, size_t size, bool last)
+{
+	yaml_path_driver_string_t *string = data;
+	(void)last;
+	if (string->size + size + 1 > string->alloc) {
+		size_t alloc = string->alloc ? string->alloc : 4096;
+		while (alloc < string->size + size + 1)
+			alloc *= 2;
+		char *str = realloc(string->data, alloc);
+		if (str == NULL)
+			return 0;
+		string->data = str;
+		string->alloc = alloc;
+	}
+	memcpy(string->data + string->size, chunk, size);
+	string->size += size;
+	string->data[string->size] = '\0';
+	return 1;
+}
+
+static int
+yaml_path_driver_block_length (void *data, const char *chunk, size_t size, bool last)
+{
+	(void)chunk;
+	(void)last;
+	*(size_t *)data += size;
+	return 1;
+}
+
+// The placeholder is short, the value of the block scalar is measured (its
+// body in the input is never shorter)
+static int
+yaml_path_driver_block_limits_check (yaml_path_driver_t *driver, size_t idx, yaml_event_t *event)
+{
+	size_t max = driver->limits.max_scalar_length;
+	const yaml_path_block_t *block = &driver->blocks.items[idx];
+	if (!max || block->end - block->start <= max)
+		return 0;
+	size_t length = 0;
+	yaml_path_blocks_decode(&driver->blocks, idx, yaml_path_driver_block_length, &length);
+	if (length > max) {
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_LIMIT_SCALAR, "Scalar is too long", event->start_mark.index);
+		return -1;
+	}
+	return 0;
+}
+
+// Filter the placeholder of a large block scalar, the value is decoded from
+// the input only for the handlers and the output
+static int
+yaml_path_driver_block_filter (yaml_path_driver_t *driver, yaml_path_t *path, yaml_parser_t *parser, yaml_event_t *event, size_t idx, yaml_path_filter_result_t *result)
+{
+	yaml_path_value_handler_t *value_handler;
+	void *value_handler_data;
+	yaml_path_value_handler_get(path, &value_handler, &value_handler_data);
+	driver->block_matched = false;
+	if (value_handler != NULL)
+		yaml_path_set_value_handler(path, yaml_path_driver_block_value, driver);
+	*result = yaml_path_filter_event(path, parser, event);
+	if (value_handler != NULL)
+		yaml_path_set_value_handler(path, value_handler, value_handler_data);
+
+	bool output = *result != YAML_PATH_FILTER_RESULT_OUT && (driver->emitter != NULL || driver->handler != NULL);
+	bool whole = driver->block_matched && driver->chunk_handler == NULL;
+	int res = 0;
+	if (driver->block_matched && driver->chunk_handler != NULL)
+		res = yaml_path_blocks_decode(&driver->blocks, idx, yaml_path_driver_block_chunk, driver);
+	if (!res && (output || whole)) {
+		yaml_path_driver_string_t string = {0};
+		res = yaml_path_blocks_decode(&driver->blocks, idx, yaml_path_driver_block_string, &string) ? -1 : 0;
+		if (!res && whole) {
+			yaml_path_value_t value = driver->block_value;
+			value.value = string.data;
+			value.length = string.size;
+			value_handler(value_handler_data, &value);
+		}
+		if (!res && output) {
+			// The event owns the value now
+			free(event->data.scalar.value);
+			event->data.scalar.value = (yaml_char_t *)string.data;
+			event->data.scalar.length = string.size;
+			string.data = NULL;
+		}
+		free(string.data);
+	}
+
+	if (res) {
+		if (res == -2 && driver->limited && driver->limits.max_output_bytes
+		    && driver->output_bytes > driver->limits.max_output_bytes)
+			yaml_path_driver_error_set(driver, YAML_PATH_ERROR_LIMIT_OUTPUT, "Output is too large", event->start_mark.index);
+		else if (res == -2)
+			yaml_path_driver_error_set(driver, YAML_PATH_ERROR_OUTPUT, "Chunk handler failed", event->start_mark.index);
+		else
+			yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for block scalar", event->start_mark.index);
+		yaml_event_delete(event);
+		return -1;
+	}
+	return 0;
+}
+
+static void
+yaml_path_driver_cursor_move (yaml_path_driver_cursor_t *cursor, const unsigned char *input, size_t pos)
+{
+	for (; cursor->pos < pos; cursor->pos++) {
+		cursor->chars += (input[cursor->pos] & 0xc0) != 0x80;
+		cursor->lines += input[cursor->pos] == '\n';
+	}
+}
+
+// Parts start at the start of a line, columns are kept
+static void
+yaml_path_driver_mark_move (yaml_mark_t *mark, const yaml_path_driver_cursor_t *cursor)
+{
+	mark->index += cursor->chars;
+	mark->line += cursor->lines;
+}
+
+static int
+yaml_path_driver_event (yaml_path_driver_t *driver, yaml_path_t *path, yaml_parser_t *parser, yaml_event_t *event)
+{
+	size_t block = SIZE_MAX;
+	if (driver->blocks_active) {
+		if (yaml_path_blocks_event(&driver->blocks, event, &block)
+		    || (event->type == YAML_STREAM_END_EVENT && !yaml_path_blocks_done(&driver->blocks))) {
+			driver->blocks_mismatch = true;
+			yaml_event_delete(event);
+			return -1;
+		}
+		driver->blocks_events++;
+		// Placeholders are found at their marks in the part
+		if (driver->blocks_cursor != NULL) {
+			yaml_path_driver_mark_move(&event->start_mark, driver->blocks_cursor);
+			yaml_path_driver_mark_move(&event->end_mark, driver->blocks_cursor);
+		}
+	}
+
+	if (driver->limited && (yaml_path_driver_limits_check(driver, event)
+	                        || (block != SIZE_MAX && yaml_path_driver_block_limits_check(driver, block, event)))) {
+		yaml_event_delete(event);
+		return -1;
+	}
+
+	yaml_event_type_t event_type = event->type;
+	yaml_path_filter_result_t result;
+	if (block == SIZE_MAX)
+		result = yaml_path_filter_event(path, parser, event);
+	else if (yaml_path_driver_block_filter(driver, path, parser, event, block, &result))
+		return -1;
+	if (result == YAML_PATH_FILTER_RESULT_OUT) {
+		yaml_event_delete(event);
+		return 0;
+	}
+
+	if (driver->flow) {
+		switch (event_type) {
+		case YAML_SEQUENCE_START_EVENT:
+			event->data.sequence_start.style = YAML_FLOW_SEQUENCE_STYLE;
+			break;
+		case YAML_MAPPING_START_EVENT:
+			event->data.mapping_start.style = YAML_FLOW_MAPPING_STYLE;
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Empty documents and keys without values get null values
+	if ((driver->prev_event_type == YAML_DOCUMENT_START_EVENT && event_type == YAML_DOCUMENT_END_EVENT)
+	    || (driver->prev_result == YAML_PATH_FILTER_RESULT_IN_DANGLING_KEY
+	        && (event_type == YAML_MAPPING_END_EVENT
+	            || event_type == YAML_SEQUENCE_END_EVENT
+	            || result == YAML_PATH_FILTER_RESULT_IN_DANGLING_KEY))) {
+		yaml_event_t null_event = {0};
+		if (!yaml_scalar_event_initialize(&null_event, NULL, (yaml_char_t *)"!!null", (yaml_char_t *)"null", 4, 1, 0, YAML_ANY_SCALAR_STYLE)) {
+			yaml_event_delete(event);
+			yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for null value", 0);
+			return -1;
+		}
+		if (yaml_path_driver_output(driver, &null_event)) {
+			yaml_event_delete(event);
+			return -1;
+		}
+	}
+	driver->prev_result = result;
+	driver->prev_event_type = event_type;
+
+	if (driver->count_limit && yaml_path_matches_get(path) >= driver->count_limit)
+		driver->stopped = true;
+	return yaml_path_driver_output(driver, event);
+}
+
+static int
+yaml_path_driver_stream_end (yaml_path_driver_t *driver, yaml_path_t *path, yaml_parser_t *parser)
+{
+	yaml_event_t event;
+	yaml_stream_end_event_initialize(&event);
+	return yaml_path_driver_event(driver, path, parser, &event);
+}
+
+static bool
+yaml_path_driver_line_is_marker (const unsigned char *line, const unsigned char *end, const char *marker)
+{
+	return end - line >= 3 && !memcmp(line, marker, 3)
+	       && (end - line == 3 || line[3] == ' ' || line[3] == '\t' || line[3] == '\r' || line[3] == '\n');
+}
+
+static void
+yaml_path_driver_scan_init (yaml_path_driver_scan_t *scan, size_t pos)
+{
+	scan->pos = pos;
+	scan->line = pos;
+	scan->doc = SIZE_MAX;
+	scan->content = false;
+	scan->directives = false;
+}
+
+// Find the next document in the raw input without parsing it, returns 0 if
+// it was found, 1 at the end of the input, and -1 if the raw scan can't tell
+// document boundaries reliably (directives inside a document); unless the
+// input is final, only
+// documents ended by a complete '...' line or followed by a '---' line are
+// found
+static int
+yaml_path_driver_document_next (const unsigned char *input, size_t size, bool final, yaml_path_driver_scan_t *scan, size_t *start, size_t *end)
+{
+	const unsigned char *line = input + scan->line;
+	const unsigned char *input_end = input + size;
+
+	while (line < input_end) {
+		const unsigned char *eol = memchr(line, '\n', input_end - line);
+		if (eol == NULL && !final)
+			return 1;
+		eol = eol != NULL ? eol + 1 : input_end;
+		if (yaml_path_driver_line_is_marker(line, eol, "---")) {
+			if (scan->doc != SIZE_MAX || scan->content) {
+				*start = scan->doc != SIZE_MAX ? scan->doc : scan->pos;
+				*end = line - input;
+				// The marker starts the next document
+				scan->pos = *end;
+				scan->line = eol - input;
+				scan->doc = *end;
+				scan->content = false;
+				scan->directives = false;
+				return 0;
+			}
+			scan->doc = scan->directives ? scan->pos : (size_t)(line - input);
+		} else if (yaml_path_driver_line_is_marker(line, eol, "...")) {
+			if (scan->doc != SIZE_MAX || scan->content) {
+				*start = scan->doc != SIZE_MAX ? scan->doc : scan->pos;
+				*end = eol - input;
+				yaml_path_driver_scan_init(scan, *end);
+				return 0;
+			}
+			// Nothing to end
+			if (scan->directives)
+				return -1;
+			scan->pos = eol - input;
+		} else if (*line == '%') {
+			// Directives start the next document
+			if (scan->doc != SIZE_MAX || scan->content)
+				return -1;
+			scan->directives = true;
+		} else if (scan->doc == SIZE_MAX && !scan->content) {
+			const unsigned char *c = line;
+			while (c < eol && (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n'))
+				c++;
+			scan->content = c < eol && *c != '#';
+		}
+		line = eol;
+		scan->line = line - input;
+	}
+	if ((scan->doc == SIZE_MAX && !scan->content && !scan->directives) || !final)
+		return 1;
+	*start = scan->doc != SIZE_MAX ? scan->doc : scan->pos;
+	*end = size;
+	yaml_path_driver_scan_init(scan, size);
+	return 0;
+}
+
+// Parse the events of a part (after the skipped ones), stream events are
+// dropped
+static int
+yaml_path_driver_part_events (yaml_path_driver_t *driver, yaml_path_t *path, const yaml_path_driver_cursor_t *cursor, size_t skip)
+{
+	yaml_event_t event;
+	yaml_event_type_t event_type;
+	do {
+		if (!yaml_parser_parse(&driver->parser, &event)) {
+			if (driver->blocks_active && yaml_path_blocks_passed(&driver->blocks, &driver->parser.problem_mark)) {
+				driver->blocks_mismatch = true;
+				return -2;
+			}
+			if (driver->blocks_active)
+				yaml_path_blocks_mark(&driver->blocks, &driver->parser.problem_mark);
+			yaml_path_driver_input_error_set(driver, &driver->parser);
+			// Reader errors are at byte offsets
+			driver->error.pos += driver->parser.error == YAML_READER_ERROR ? cursor->pos : cursor->chars;
+			return -2;
+		}
+		event_type = event.type;
+		if (skip) {
+			skip--;
+			yaml_event_delete(&event);
+			continue;
+		}
+		if (!driver->blocks_active) {
+			yaml_path_driver_mark_move(&event.start_mark, cursor);
+			yaml_path_driver_mark_move(&event.end_mark, cursor);
+		}
+		if (event_type == YAML_STREAM_START_EVENT || event_type == YAML_STREAM_END_EVENT) {
+			yaml_event_delete(&event);
+			if (driver->blocks_active && event_type == YAML_STREAM_START_EVENT)
+				driver->blocks_events++;
+			if (driver->blocks_active && event_type == YAML_STREAM_END_EVENT && !yaml_path_blocks_done(&driver->blocks)) {
+				driver->blocks_mismatch = true;
+				return -2;
+			}
+		} else if (yaml_path_driver_event(driver, path, &driver->parser, &event)) {
+			return -2;
+		}
+	} while (event_type != YAML_STREAM_END_EVENT);
+	return 0;
+}
+
+// Large block scalars of the part are decoded by the driver, the part is
+// parsed as is after a mismatch of the placeholders
+static int
+yaml_path_driver_part_blocks (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *input, size_t size, const yaml_path_driver_cursor_t *cursor)
+{
+	if (yaml_path_blocks_scan(&driver->blocks, input, size, driver->block_min_size)) {
+		yaml_path_blocks_delete(&driver->blocks);
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for block scalars", 0);
+		return -2;
+	}
+	yaml_path_blocks_set_parser(&driver->blocks, &driver->parser);
+	driver->blocks_active = true;
+	driver->blocks_mismatch = false;
+	driver->blocks_events = 0;
+	driver->blocks_cursor = cursor;
+	int res = yaml_path_driver_part_events(driver, path, cursor, 0);
+	driver->blocks_active = false;
+	driver->blocks_cursor = NULL;
+	yaml_path_blocks_delete(&driver->blocks);
+	if (!res || !driver->blocks_mismatch)
+		return res;
+
+	yaml_parser_delete(&driver->parser);
+	if (!yaml_parser_initialize(&driver->parser)) {
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for parser", 0);
+		return -2;
+	}
+	yaml_parser_set_input_string(&driver->parser, input, size);
+	return yaml_path_driver_part_events(driver, path, cursor, driver->blocks_events);
+}
+
+// Parse documents from a part of the input (starting at the cursor) as a
+// continuation of the current stream (stream events of the part are dropped)
+static int
+yaml_path_driver_run_part (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *input, size_t size, const yaml_path_driver_cursor_t *cursor, bool blocks)
+{
+	if (!yaml_parser_initialize(&driver->parser)) {
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for parser", 0);
+		return -2;
+	}
+
+	int res;
+	if (blocks) {
+		res = yaml_path_driver_part_blocks(driver, path, input, size, cursor);
+	} else {
+		yaml_parser_set_input_string(&driver->parser, input, size);
+		res = yaml_path_driver_part_events(driver, path, cursor, 0);
+	}
+
+	yaml_parser_delete(&driver->parser);
+	return res;
+}
+
+static int
+yaml_path_driver_run_documents (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *input, size_t size)
+{
+	// Only UTF-8 input can be scanned for document markers
+	size_t pos = size >= 3 && !memcmp(input, "\xef\xbb\xbf", 3) ? 3 : 0;
+	if (size >= 2 && ((input[0] == 0xfe && input[1] == 0xff) || (input[0] == 0xff && input[1] == 0xfe)))
+		return 1;
+
+	// Check the boundaries up to the last selected document first, nothing
+	// can be sent to the output before the decision about the raw scan
+	size_t start, end;
+	yaml_path_driver_scan_t scan;
+	yaml_path_driver_scan_init(&scan, pos);
+	yaml_path_documents_seek(path, 0);
+	for (size_t idx = 0; yaml_path_documents_next(path) != SIZE_MAX; idx++) {
+		int res = yaml_path_driver_document_next(input, size, true, &scan, &start, &end);
+		if (res < 0)
+			return 1;
+		if (res > 0)
+			break;
+		yaml_path_documents_seek(path, idx + 1);
+	}
+
+	yaml_event_t event;
+	yaml_stream_start_event_initialize(&event, YAML_UTF8_ENCODING);
+	if (yaml_path_driver_event(driver, path, &driver->parser, &event))
+		return -2;
+
+	// Node handlers get the events with the whole values
+	bool blocks = driver->block_min_size && !yaml_path_node_handler_is_set(path);
+	yaml_path_driver_scan_init(&scan, pos);
+	yaml_path_driver_cursor_t cursor = {pos, 0, 0};
+	for (size_t idx = 0;; idx++) {
+		yaml_path_documents_seek(path, idx);
+		if (yaml_path_documents_next(path) == SIZE_MAX
+		    || yaml_path_driver_document_next(input, size, true, &scan, &start, &end))
+			break;
+		if (yaml_path_documents_next(path) != idx)
+			continue;
+
+		yaml_path_driver_cursor_move(&cursor, input, start);
+		if (yaml_path_driver_run_part(driver, path, input + start, end - start, &cursor, blocks))
+			return -2;
+	}
+
+	return yaml_path_driver_stream_end(driver, path, &driver->parser) ? -2 : 0;
+}
+
+static bool
+yaml_path_driver_line_is_blank (const unsigned char *line, const unsigned char *end)
+{
+	while (line < end && (*line == ' ' || *line == '\t' || *line == '\r' || *line == '\n'))
+		line++;
+	return line == end || *line == '#';
+}
+
+static bool
+yaml_path_driver_line_is_item (const unsigned char *line, const unsigned char *end)
+{
+	return end - line >= 1 && *line == '-'
+	       && (end - line == 1 || line[1] == ' ' || line[1] == '\t' || line[1] == '\r' || line[1] == '\n');
+}
+
+// Split the items of the block sequence which is the root node of the only
+// document of the input (`key` is NULL) or the value of the key of the root
+// mapping into at most `chunks` parts; items are found by indentation only,
+// as continuation lines of nodes inside of the items must be indented more
+// in valid YAML (parsing of the chunks fails otherwise), returns 0 if there
+// are at least two chunks, the rest of the document belongs to the last one
+static int
+yaml_path_driver_sequence_split (const unsigned char *input, size_t size, const char *key, size_t chunks, yaml_path_driver_split_t *split)
+{
+	// Only UTF-8 without BOM, other encodings have NUL bytes in the first two
+	if (size < 2 || input[0] == 0xef || input[0] == 0xfe || input[0] == 0xff || !input[0] || !input[1])
+		return 1;
+
+	size_t key_len = key != NULL ? strlen(key) : 0;
+	bool key_found = key == NULL;
+	bool content = false;
+	size_t indent = SIZE_MAX; // Indentation of the items
+	size_t chars = 0, lines = 0;
+
+	split->count = 1;
+	split->pos[0] = split->chars[0] = split->lines[0] = 0;
+	const unsigned char *line = input, *end = input + size;
+	while (line < end) {
+		const unsigned char *eol = memchr(line, '\n', end - line);
+		eol = eol != NULL ? eol + 1 : end;
+		const unsigned char *c = line;
+		while (c < eol && *c == ' ')
+			c++;
+		size_t line_indent = c - line;
+		bool blank = yaml_path_driver_line_is_blank(c, eol);
+
+		if (blank) {
+			// Empty lines and comments
+		} else if (indent != SIZE_MAX) {
+			if (line_indent == indent && yaml_path_driver_line_is_item(c, eol)) {
+				if (split->count < chunks && (size_t)(line - input) >= size / chunks * split->count) {
+					split->pos[split->count] = line - input;
+					split->chars[split->count] = chars;
+					split->lines[split->count] = lines;
+					split->count++;
+				}
+			} else if (line_indent <= indent) {
+				if (key == NULL)
+					return 1;
+				break;
+			}
+		} else if (!line_indent && (*c == '%' || yaml_path_driver_line_is_marker(c, eol, "..."))) {
+			return 1;
+		} else if (!line_indent && yaml_path_driver_line_is_marker(c, eol, "---")) {
+			if (content || !yaml_path_driver_line_is_blank(c + 3, eol))
+				return 1;
+			content = true;
+		} else if (key_found) {
+			if (!yaml_path_driver_line_is_item(c, eol))
+				return 1;
+			indent = line_indent;
+		} else if (!line_indent && (size_t)(eol - c) > key_len && !memcmp(c, key, key_len) && c[key_len] == ':') {
+			if (!yaml_path_driver_line_is_blank(c + key_len + 1, eol))
+				return 1;
+			key_found = true;
+		}
+		if (!blank)
+			content = true;
+
+		for (const unsigned char *b = line; b < eol; b++)
+			chars += (*b & 0xc0) != 0x80;
+		lines++;
+		line = eol;
+	}
+	if (indent == SIZE_MAX || split->count < 2)
+		return 1;
+	split->pos[split->count] = size;
+	return 0;
+}
+
+static int
+yaml_path_driver_chunk_read (void *data, unsigned char *buffer, size_t size, size_t *size_read)
+{
+	yaml_path_driver_chunk_t *chunk = data;
+	size_t len;
+	if (chunk->pos < chunk->prefix_size) {
+		len = chunk->prefix_size - chunk->pos;
+		if (len > size)
+			len = size;
+		memcpy(buffer, chunk->prefix + chunk->pos, len);
+	} else {
+		size_t pos = chunk->pos - chunk->prefix_size;
+		len = chunk->size - pos;
+		if (len > size)
+			len = size;
+		memcpy(buffer, chunk->input + pos, len);
+	}
+	chunk->pos += len;
+	*size_read = len;
+	return 1;
+}
+
+// Filtered events are kept until the chunk is parsed, the ones of the first
+// chunk are sent once its start is checked
+static int
+yaml_path_driver_chunk_collect (void *data, yaml_event_t *event)
+{
+	yaml_path_driver_chunk_t *chunk = data;
+	if (chunk->events_count == chunk->events_alloc) {
+		size_t alloc = chunk->events_alloc ? chunk->events_alloc * 2 : 256;
+		yaml_event_t *events = realloc(chunk->events, alloc * sizeof(*events));
+		if (events == NULL)
+			return 0;
+		chunk->events = events;
+		chunk->events_alloc = alloc;
+	}
+
+	// The event is taken over, the driver deletes an empty one then
+	yaml_event_t *copy = &chunk->events[chunk->events_count++];
+	*copy = *event;
+	memset(event, 0, sizeof(*event));
+	// Null values added by the driver have no marks
+	if (copy->start_mark.index || copy->end_mark.index) {
+		copy->start_mark.index += chunk->index_offset;
+		copy->start_mark.line += chunk->line_offset;
+		copy->end_mark.index += chunk->index_offset;
+		copy->end_mark.line += chunk->line_offset;
+	}
+
+	if (chunk->output == NULL || chunk->events_count < 4)
+		return 1;
+	if (!chunk->emitted && (chunk->events[0].type != YAML_STREAM_START_EVENT
+	                        || chunk->events[1].type != YAML_DOCUMENT_START_EVENT
+	                        || chunk->events[2].type != YAML_SEQUENCE_START_EVENT)) {
+		chunk->output = NULL;
+		return 1;
+	}
+	chunk->emitted++;
+	if (yaml_path_driver_output(chunk->output, &chunk->events[0])) {
+		chunk->output_failed = true;
+		return 0;
+	}
+	memmove(chunk->events, chunk->events + 1, 3 * sizeof(*chunk->events));
+	chunk->events_count = 3;
+	return 1;
+}
+
+static void*
+yaml_path_driver_chunk_run (void *data)
+{
+	yaml_path_driver_chunk_t *chunk = data;
+	chunk->res = -2;
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	if (driver == NULL)
+		return NULL;
+	yaml_path_driver_set_output_handler(driver, yaml_path_driver_chunk_collect, chunk);
+	yaml_path_driver_set_flow_style(driver, chunk->flow);
+	if (yaml_parser_initialize(&driver->parser)) {
+		yaml_parser_set_input(&driver->parser, yaml_path_driver_chunk_read, chunk);
+		chunk->res = yaml_path_driver_run(driver, chunk->path, &driver->parser);
+		yaml_parser_delete(&driver->parser);
+	}
+	yaml_path_driver_destroy(driver);
+	return NULL;
+}
+
+// Events of a chunk are the stream and document start, the sequence of the
+// items, the end of the document and the stream (another documents may be
+// parsed with the last chunk); the start of a sent one was checked before
+static bool
+yaml_path_driver_chunk_is_valid (const yaml_path_driver_chunk_t *chunk)
+{
+	const yaml_event_t *events = chunk->events;
+	size_t count = chunk->events_count;
+	return !chunk->res && chunk->emitted + count >= 6
+	       && (chunk->emitted || (events[0].type == YAML_STREAM_START_EVENT
+	                              && events[1].type == YAML_DOCUMENT_START_EVENT
+	                              && events[2].type == YAML_SEQUENCE_START_EVENT))
+	       && events[count - 3].type == YAML_SEQUENCE_END_EVENT
+	       && events[count - 2].type == YAML_DOCUMENT_END_EVENT
+	       && events[count - 1].type == YAML_STREAM_END_EVENT;
+}
+
+// Parse a document with one huge sequence addressed by the path on several
+// threads, the chunks are sent in order as they are parsed; returns 1 if the
+// input or the path doesn't allow that, parse errors are left for the serial
+// run (which skips the events sent already, the same as its first ones)
+static int
+yaml_path_driver_run_parallel (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *input, size_t size)
+{
+	size_t chunks = size / YAML_PATH_DRIVER_CHUNK_MIN_SIZE;
+	if (chunks > driver->threads)
+		chunks = driver->threads;
+	if (chunks < 2 || driver->limited || yaml_path_documents_selective(path) || yaml_path_handlers_set(path))
+		return 1;
+
+	// Items of the root sequence (`[:]...`) or of a key of the root mapping
+	// (`.key[:]...`) are addressed
+	yaml_path_step_t step;
+	size_t steps = yaml_path_steps_get(path, &step, 1);
+	if ((steps && step.key == NULL) || !yaml_path_steps_next_is_all(path, steps))
+		return 1;
+
+	yaml_path_driver_split_t split;
+	if (yaml_path_driver_sequence_split(input, size, steps ? step.key : NULL, chunks, &split))
+		return 1;
+
+	int res = 1;
+	size_t record_size = yaml_path_record_write(path, NULL, 0);
+	unsigned char *record = malloc(record_size);
+	size_t prefix_size = steps ? strlen(step.key) + 2 : 0;
+	char *prefix = malloc(prefix_size + 1);
+	yaml_path_driver_chunk_t *chunk = calloc(split.count, sizeof(*chunk));
+	if (record == NULL || prefix == NULL || chunk == NULL)
+		goto cleanup;
+	yaml_path_record_write(path, record, record_size);
+	snprintf(prefix, prefix_size + 1, "%s:\n", steps ? step.key : "");
+
+	size_t prefix_chars = 0;
+	for (size_t i = 0; i < prefix_size; i++)
+		prefix_chars += ((unsigned char)prefix[i] & 0xc0) != 0x80;
+	for (size_t i = 0; i < split.count; i++) {
+		chunk[i].input = input + split.pos[i];
+		chunk[i].size = split.pos[i + 1] - split.pos[i];
+		if (i && steps) {
+			chunk[i].prefix = prefix;
+			chunk[i].prefix_size = prefix_size;
+			chunk[i].index_offset = split.chars[i] - prefix_chars;
+			chunk[i].line_offset = split.lines[i] - 1;
+		} else {
+			chunk[i].index_offset = split.chars[i];
+			chunk[i].line_offset = split.lines[i];
+		}
+		chunk[i].flow = driver->flow;
+		chunk[i].path = yaml_path_create();
+		if (chunk[i].path == NULL || yaml_path_record_read(chunk[i].path, record, record_size))
+			goto cleanup;
+	}
+
+	// The first chunk is parsed (and sent) by the calling thread
+	for (size_t i = 1; i < split.count; i++)
+		chunk[i].started = !pthread_create(&chunk[i].thread, NULL, yaml_path_driver_chunk_run, &chunk[i]);
+	chunk[0].output = driver;
+	yaml_path_driver_chunk_run(&chunk[0]);
+	size_t emitted = chunk[0].emitted;
+	res = chunk[0].output_failed ? -2 : yaml_path_driver_chunk_is_valid(&chunk[0]) ? 0 : 1;
+
+	// Stream and document events and the sequence are taken from the first
+	// and the last chunk, the items from all of them
+	for (size_t i = 1; i < split.count; i++) {
+		if (chunk[i].started)
+			pthread_join(chunk[i].thread, NULL);
+		else if (!res)
+			yaml_path_driver_chunk_run(&chunk[i]);
+		if (!res && !yaml_path_driver_chunk_is_valid(&chunk[i]))
+			res = 1;
+		size_t last = i + 1 < split.count ? chunk[i].events_count - 3 : chunk[i].events_count;
+		for (size_t k = 3; k < last && !res; k++) {
+			emitted++;
+			if (yaml_path_driver_output(driver, &chunk[i].events[k]))
+				res = -2;
+			// The output has taken the event over
+			memset(&chunk[i].events[k], 0, sizeof(chunk[i].events[k]));
+		}
+	}
+	if (res > 0)
+		driver->output_skip = emitted;
+
+cleanup:
+	if (chunk != NULL) {
+		for (size_t i = 0; i < split.count; i++) {
+			for (size_t k = 0; k < chunk[i].events_count; k++)
+				yaml_event_delete(&chunk[i].events[k]);
+			free(chunk[i].events);
+			yaml_path_destroy(chunk[i].path);
+		}
+	}
+	free(chunk);
+	free(prefix);
+	free(record);
+	return res;
+}
+
+static void
+yaml_path_driver_run_init (yaml_path_driver_t *driver)
+{
+	yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NONE, NULL, 0);
+	driver->prev_event_type = YAML_NO_EVENT;
+	driver->prev_result = YAML_PATH_FILTER_RESULT_OUT;
+	driver->stopped = false;
+
+	driver->depth = 0;
+	driver->events = 0;
+	driver->output_bytes = 0;
+	if (driver->limits.timeout_ms) {
+		clock_gettime(CLOCK_MONOTONIC, &driver->deadline);
+		driver->deadline.tv_sec += driver->limits.timeout_ms / 1000;
+		driver->deadline.tv_nsec += (driver->limits.timeout_ms % 1000) * 1000000;
+		if (driver->deadline.tv_nsec >= 1000000000) {
+			driver->deadline.tv_sec++;
+			driver->deadline.tv_nsec -= 1000000000;
+		}
+	}
+}
+
+// The BOM isn't counted by the marks
+static void
+yaml_path_driver_feed_cursor_move (yaml_path_driver_t *driver, size_t pos)
+{
+	yaml_path_driver_cursor_t *cursor = &driver->feed_cursor;
+	if (!cursor->pos && !cursor->chars && pos >= 3 && !memcmp(driver->feed_buffer, "\xef\xbb\xbf", 3))
+		cursor->pos = 3;
+	yaml_path_driver_cursor_move(cursor, driver->feed_buffer, pos);
+}
+
+// Byte offset of a character index, the cursor follows the matches
+static size_t
+yaml_path_driver_offset (void *data, size_t index)
+{
+	yaml_path_driver_t *driver = data;
+	yaml_path_driver_cursor_t *cursor = &driver->offset_cursor;
+	const unsigned char *input = driver->offset_input;
+	if (!driver->offset_base && !cursor->pos && !cursor->chars && driver->offset_size >= 3 && !memcmp(input, "\xef\xbb\xbf", 3))
+		cursor->pos = 3;
+	if (index < cursor->chars)
+		return SIZE_MAX;
+	while (cursor->pos < driver->offset_size && (cursor->chars < index || (input[cursor->pos] & 0xc0) == 0x80))
+		cursor->chars += (input[cursor->pos++] & 0xc0) != 0x80;
+	return driver->offset_base + cursor->pos;
+}
+
+// Matches get the byte offsets in the input (only UTF-8 input, the cursor
+// counts the characters as the marks)
+static void
+yaml_path_driver_offsets_set (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *input, size_t size)
+{
+	driver->offset_input = input;
+	driver->offset_size = size;
+	if (size >= 2 && ((input[0] == 0xfe && input[1] == 0xff) || (input[0] == 0xff && input[1] == 0xfe)))
+		return;
+	yaml_path_set_offset_handler(path, yaml_path_driver_offset, driver);
+}
+
+static bool
+yaml_path_driver_is_blank (unsigned char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Find the start of the next entry of the root collection in the lines from
+// `*pos` to `end` (`*entry` tells whether the current one started before);
+// entries start at column 0, the first one tells the type of the root,
+// SIZE_MAX is returned if the next one isn't there yet
+static size_t
+yaml_path_driver_entry_next (const unsigned char *input, size_t *pos, bool *entry, size_t end, yaml_event_type_t *root)
+{
+	const unsigned char *line = input + *pos;
+	const unsigned char *input_end = input + end;
+
+	while (line < input_end) {
+		const unsigned char *eol = memchr(line, '\n', input_end - line);
+		eol = eol != NULL ? eol + 1 : input_end;
+		bool item = *line == '-' && (eol - line == 1 || yaml_path_driver_is_blank(line[1]));
+		bool value = *line == ':' && (eol - line == 1 || yaml_path_driver_is_blank(line[1]));
+		if (*line == '%' || *line == '#' || yaml_path_driver_is_blank(*line) || yaml_path_driver_line_is_marker(line, eol, "---")) {
+			// Directives, comments, nested lines and the document start
+		} else if (!*entry) {
+			if (*root == YAML_NO_EVENT)
+				*root = item ? YAML_SEQUENCE_START_EVENT : YAML_MAPPING_START_EVENT;
+			*entry = true;
+		} else if (*root == YAML_SEQUENCE_START_EVENT ? item : !item && !value) {
+			*pos = line - input;
+			*entry = false;
+			return *pos;
+		}
+		line = eol;
+	}
+	*pos = end;
+	return SIZE_MAX;
+}
+
+// An entry parsed on its own is a document with a block collection of the
+// type of the root
+static bool
+yaml_path_driver_entry_is_valid (const yaml_event_t *events, size_t count, yaml_event_type_t root)
+{
+	if (count < 6 || events[0].type != YAML_STREAM_START_EVENT || events[1].type != YAML_DOCUMENT_START_EVENT
+	    || events[2].type != root || events[count - 2].type != YAML_DOCUMENT_END_EVENT || events[count - 1].type != YAML_STREAM_END_EVENT)
+		return false;
+	if (root == YAML_MAPPING_START_EVENT)
+		return events[2].data.mapping_start.style == YAML_BLOCK_MAPPING_STYLE && events[count - 3].type == YAML_MAPPING_END_EVENT;
+	return events[2].data.sequence_start.style == YAML_BLOCK_SEQUENCE_STYLE && events[count - 3].type == YAML_SEQUENCE_END_EVENT;
+}
+
+// Filter an entry of the root collection of the open document, the first one
+// is parsed with the start of the document and the last one with its end;
+// nothing is sent and 1 is returned if the entry isn't valid on its own
+static int
+yaml_path_driver_feed_entry (yaml_path_driver_t *driver, yaml_path_t *path, size_t start, size_t end, bool first, bool last)
+{
+	yaml_path_driver_feed_cursor_move(driver, start);
+	const yaml_path_driver_cursor_t *cursor = &driver->feed_cursor;
+	if (!yaml_parser_initialize(&driver->parser)) {
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for parser", 0);
+		return -2;
+	}
+	yaml_parser_set_input_string(&driver->parser, driver->feed_buffer + cursor->pos, end - cursor->pos);
+
+	size_t count = 0;
+	int res = 0;
+	while (!count || driver->feed_events[count - 1].type != YAML_STREAM_END_EVENT) {
+		yaml_event_t *events = yaml_path_grow(driver->feed_events, &driver->feed_events_alloc, count, sizeof(*events), YAML_PATH_DRIVER_FEED_EVENTS_MIN_ALLOC);
+		if (events == NULL) {
+			yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for events", 0);
+			res = -2;
+			break;
+		}
+		driver->feed_events = events;
+		if (!yaml_parser_parse(&driver->parser, &events[count])) {
+			res = 1;
+			break;
+		}
+		yaml_path_driver_mark_move(&events[count].start_mark, cursor);
+		yaml_path_driver_mark_move(&events[count].end_mark, cursor);
+		count++;
+	}
+	if (!res && !yaml_path_driver_entry_is_valid(driver->feed_events, count, driver->feed_open_root))
+		res = 1;
+
+	// Stream events, and the ends of the root and of the document unless
+	// it's the last entry, are dropped
+	size_t from = first ? 1 : 3;
+	size_t to = last ? count - 1 : count - 3;
+	for (size_t i = 0; i < count; i++) {
+		if (!res && i >= from && i < to) {
+			driver->feed_open_events++;
+			if (yaml_path_driver_event(driver, path, &driver->parser, &driver->feed_events[i]))
+				res = -2;
+		} else {
+			yaml_event_delete(&driver->feed_events[i]);
+		}
+	}
+	yaml_parser_delete(&driver->parser);
+	return res;
+}
+
+// Parse the input from `start` (from the start of the open document) to
+// `end`, the events sent for the open document are skipped
+static int
+yaml_path_driver_feed_rest (yaml_path_driver_t *driver, yaml_path_t *path, size_t start, size_t end)
+{
+	yaml_path_driver_cursor_t cursor;
+	size_t skip = 0;
+	if (driver->feed_open) {
+		cursor = driver->feed_open_cursor;
+		skip = driver->feed_open_events + 1;
+	} else {
+		yaml_path_driver_feed_cursor_move(driver, start);
+		cursor = driver->feed_cursor;
+	}
+	driver->feed_open = false;
+	driver->feed_open_failed = false;
+	driver->feed_entry_line = SIZE_MAX;
+
+	if (!yaml_parser_initialize(&driver->parser)) {
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for parser", 0);
+		return -2;
+	}
+	yaml_parser_set_input_string(&driver->parser, driver->feed_buffer + cursor.pos, end - cursor.pos);
+	int res = yaml_path_driver_part_events(driver, path, &cursor, skip);
+	yaml_parser_delete(&driver->parser);
+	return res;
+}
+
+// Filter the entries of the root collection of the current document which
+// are followed by the next one
+static int
+yaml_path_driver_feed_entries (yaml_path_driver_t *driver, yaml_path_t *path)
+{
+	const yaml_path_driver_scan_t *scan = &driver->feed_scan;
+	if (driver->feed_open_failed || (scan->doc == SIZE_MAX && !scan->content))
+		return 0;
+	yaml_path_documents_seek(path, driver->feed_documents);
+	if (yaml_path_documents_next(path) != driver->feed_documents)
+		return 0;
+
+	size_t end;
+	if (!driver->feed_open) {
+		size_t start = scan->doc != SIZE_MAX ? scan->doc : scan->pos;
+		if (driver->feed_entry_line == SIZE_MAX) {
+			driver->feed_entry_line = start;
+			driver->feed_entry = false;
+			driver->feed_open_root = YAML_NO_EVENT;
+		}
+		end = yaml_path_driver_entry_next(driver->feed_buffer, &driver->feed_entry_line, &driver->feed_entry, scan->line, &driver->feed_open_root);
+		if (end == SIZE_MAX)
+			return 0;
+		yaml_path_driver_feed_cursor_move(driver, start);
+		driver->feed_open_cursor = driver->feed_cursor;
+		driver->feed_open_events = 0;
+		int res = yaml_path_driver_feed_entry(driver, path, start, end, true, false);
+		driver->feed_open_failed = res > 0;
+		driver->feed_open = !res;
+		driver->feed_open_pos = end;
+		if (res)
+			return res < 0 ? -2 : 0;
+	}
+	while ((end = yaml_path_driver_entry_next(driver->feed_buffer, &driver->feed_entry_line, &driver->feed_entry, scan->line, &driver->feed_open_root)) != SIZE_MAX) {
+		int res = yaml_path_driver_feed_entry(driver, path, driver->feed_open_pos, end, false, false);
+		driver->feed_open_failed = res > 0;
+		if (res)
+			return res < 0 ? -2 : 0;
+		driver->feed_open_pos = end;
+	}
+	return 0;
+}
+
+static int
+yaml_path_driver_feed_documents (yaml_path_driver_t *driver, yaml_path_t *path, bool final)
+{
+	size_t start, end;
+	int res;
+	while (!driver->feed_raw
+	       && !(res = yaml_path_driver_document_next(driver->feed_buffer, driver->feed_size, final, &driver->feed_scan, &start, &end))) {
+		yaml_path_documents_seek(path, driver->feed_documents);
+		if (yaml_path_documents_next(path) == driver->feed_documents) {
+			// The last entry of the open document is parsed with its end
+			res = 1;
+			if (driver->feed_open && !driver->feed_open_failed)
+				res = yaml_path_driver_feed_entry(driver, path, driver->feed_open_pos, end, false, true);
+			if (res > 0)
+				res = yaml_path_driver_feed_rest(driver, path, start, end);
+			if (res)
+				return -2;
+		}
+		driver->feed_open = false;
+		driver->feed_open_failed = false;
+		driver->feed_entry_line = SIZE_MAX;
+		driver->feed_documents++;
+	}
+	if (!driver->feed_raw && res < 0)
+		driver->feed_raw = true;
+	if (driver->feed_raw && final) {
+		if (yaml_path_driver_feed_rest(driver, path, driver->feed_scan.pos, driver->feed_size))
+			return -2;
+		yaml_path_driver_scan_init(&driver->feed_scan, driver->feed_size);
+	}
+	if (!driver->feed_raw && !final && yaml_path_driver_feed_entries(driver, path))
+		return -2;
+
+	// Drop processed documents from the buffer
+	size_t pos = driver->feed_scan.pos;
+	if (pos && pos >= driver->feed_size / 2) {
+		yaml_path_driver_feed_cursor_move(driver, pos);
+		if (driver->offset_cursor.pos < pos)
+			driver->offset_cursor = driver->feed_cursor;
+		driver->offset_cursor.pos -= pos;
+		driver->offset_base += pos;
+		memmove(driver->feed_buffer, driver->feed_buffer + pos, driver->feed_size - pos);
+		driver->feed_size -= pos;
+		driver->feed_cursor.pos -= pos;
+		driver->feed_scan.pos -= pos;
+		driver->feed_scan.line -= pos;
+		if (driver->feed_scan.doc != SIZE_MAX)
+			driver->feed_scan.doc -= pos;
+		if (driver->feed_entry_line != SIZE_MAX)
+			driver->feed_entry_line -= pos;
+		if (driver->feed_open) {
+			driver->feed_open_pos -= pos;
+			driver->feed_open_cursor.pos -= pos;
+		}
+	}
+	return 0;
+}
+
+// Synthetic input before the start is moved to the origin, columns are kept
+static void
+yaml_path_driver_origin_move (const yaml_path_driver_t *driver, yaml_mark_t *mark)
+{
+	if (mark->index < driver->origin_start.index) {
+		*mark = driver->origin;
+		return;
+	}
+	mark->index = mark->index - driver->origin_start.index + driver->origin.index;
+	mark->line = mark->line - driver->origin_start.line + driver->origin.line;
+}
+
+static int
+yaml_path_driver_parse_events (yaml_path_driver_t *driver, yaml_path_t *path, yaml_parser_t *parser)
+{
+	// Only the parsers of the caller are set to parts of larger inputs (the
+	// placeholders of the blocks mode are found at their marks in the input)
+	bool origin = driver->origin_set && parser != &driver->parser;
+	yaml_event_t event;
+	yaml_event_type_t event_type;
+	do {
+		if (!yaml_parser_parse(parser, &event)) {
+			yaml_path_driver_input_error_set(driver, parser);
+			if (origin && parser->error != YAML_READER_ERROR && driver->error.type == YAML_PATH_ERROR_INPUT) {
+				yaml_mark_t mark = {driver->error.pos, 0, 0};
+				yaml_path_driver_origin_move(driver, &mark);
+				driver->error.pos = mark.index;
+			}
+			return -2;
+		}
+		event_type = event.type;
+		if (origin) {
+			yaml_path_driver_origin_move(driver, &event.start_mark);
+			yaml_path_driver_origin_move(driver, &event.end_mark);
+		}
+		if (yaml_path_driver_event(driver, path, parser, &event))
+			return -2;
+		if (driver->stopped)
+			return 0;
+		// Stop after the last selected document
+		if (event_type == YAML_DOCUMENT_END_EVENT
+		    && yaml_path_documents_selective(path) && yaml_path_documents_next(path) == SIZE_MAX)
+			return yaml_path_driver_stream_end(driver, path, parser) ? -2 : 0;
+	} while (event_type != YAML_STREAM_END_EVENT);
+
+	return 0;
+}
+
+static int
+yaml_path_driver_parse (yaml_path_driver_t *driver, yaml_path_t *path, yaml_parser_t *parser)
+{
+	yaml_path_driver_run_init(driver);
+	return yaml_path_driver_parse_events(driver, path, parser);
+}
+
+// The events passed before the mismatch are skipped, the rest of the input
+// is filtered as is
+static int
+yaml_path_driver_parse_rest (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *input, size_t size)
+{
+	yaml_parser_delete(&driver->parser);
+	if (!yaml_parser_initialize(&driver->parser)) {
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for parser", 0);
+		return -2;
+	}
+	yaml_parser_set_input_string(&driver->parser, input, size);
+	for (size_t i = 0; i < driver->blocks_events; i++) {
+		yaml_event_t event;
+		if (!yaml_parser_parse(&driver->parser, &event)) {
+			yaml_path_driver_input_error_set(driver, &driver->parser);
+			return -2;
+		}
+		yaml_event_delete(&event);
+	}
+	return yaml_path_driver_parse_events(driver, path, &driver->parser);
+}
+
+static int
+yaml_path_driver_run_blocks (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *input, size_t size)
+{
+	if (yaml_path_blocks_scan(&driver->blocks, input, size, driver->block_min_size)) {
+		yaml_path_blocks_delete(&driver->blocks);
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for block scalars", 0);
+		return -2;
+	}
+	if (!yaml_parser_initialize(&driver->parser)) {
+		yaml_path_blocks_delete(&driver->blocks);
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for parser", 0);
+		return -2;
+	}
+	yaml_path_blocks_set_parser(&driver->blocks, &driver->parser);
+	driver->blocks_active = true;
+	driver->blocks_mismatch = false;
+	driver->blocks_events = 0;
+	int res = yaml_path_driver_parse(driver, path, &driver->parser);
+	if (res && driver->parser.error != YAML_NO_ERROR && yaml_path_blocks_passed(&driver->blocks, &driver->parser.problem_mark)) {
+		driver->blocks_mismatch = true;
+	} else if (res && driver->parser.error != YAML_NO_ERROR) {
+		yaml_path_blocks_mark(&driver->blocks, &driver->parser.problem_mark);
+		yaml_path_driver_input_error_set(driver, &driver->parser);
+	}
+	driver->blocks_active = false;
+	// Placeholders were not parsed as the scanned block scalars
+	if (res && driver->blocks_mismatch)
+		res = yaml_path_driver_parse_rest(driver, path, input, size);
+	yaml_path_driver_output_release(driver);
+	yaml_parser_delete(&driver->parser);
+	yaml_path_blocks_delete(&driver->blocks);
+	return res;
+}
+
+// Nodes are counted by the path, the handler only enables the tracking
+static void
+yaml_path_driver_match_handler (void *data, const yaml_path_match_t *match)
+{
+	(void)data;
+	(void)match;
+}
+
+
+/* Public API -------------------------------------------------------------- */
+
+yaml_path_driver_t*
+yaml_path_driver_create (void)
+{
+	yaml_path_driver_t *driver = malloc(sizeof(*driver));
+	if (driver != NULL)
+		memset(driver, 0, sizeof(*driver));
+	return driver;
+}
+
+void
+yaml_path_driver_destroy (yaml_path_driver_t *driver)
+{
+	if (driver == NULL)
+		return;
+	yaml_path_driver_output_release(driver);
+	free(driver->feed_buffer);
+	free(driver->feed_events);
+	free(driver);
+}
+
+const yaml_path_error_t*
+yaml_path_driver_error_get (yaml_path_driver_t *driver)
+{
+	if (driver == NULL)
+		return NULL;
+	return &driver->error;
+}
+
+void
+yaml_path_driver_set_output_emitter (yaml_path_driver_t *driver, yaml_emitter_t *emitter)
+{
+	if (driver == NULL)
+		return;
+	yaml_path_driver_output_release(driver);
+	driver->emitter = emitter;
+	driver->handler = NULL;
+	driver->handler_data = NULL;
+}
+
+void
+yaml_path_driver_set_output_handler (yaml_path_driver_t *driver, yaml_path_event_handler_t *handler, void *data)
+{
+	if (driver == NULL)
+		return;
+	yaml_path_driver_output_release(driver);
+	driver->emitter = NULL;
+	driver->handler = handler;
+	driver->handler_data = data;
+}
+
+void
+yaml_path_driver_set_flow_style (yaml_path_driver_t *driver, int flow)
+{
+	if (driver == NULL)
+		return;
+	driver->flow = flow;
+}
+
+void
+yaml_path_driver_set_threads (yaml_path_driver_t *driver, size_t threads)
+{
+	if (driver == NULL)
+		return;
+	driver->threads = threads < YAML_PATH_DRIVER_MAX_THREADS ? threads : YAML_PATH_DRIVER_MAX_THREADS;
+}
+
+void
+yaml_path_driver_set_chunk_handler (yaml_path_driver_t *driver, size_t min_size, yaml_path_chunk_handler_t *handler, void *data)
+{
+	if (driver == NULL)
+		return;
+	driver->block_min_size = min_size;
+	driver->chunk_handler = handler;
+	driver->chunk_handler_data = data;
+}
+
+void
+yaml_path_driver_set_limits (yaml_path_driver_t *driver, const yaml_path_limits_t *limits)
+{
+	if (driver == NULL)
+		return;
+	yaml_path_driver_output_release(driver);
+	if (limits != NULL)
+		driver->limits = *limits;
+	else
+		memset(&driver->limits, 0, sizeof(driver->limits));
+	driver->limited = driver->limits.max_depth || driver->limits.max_events || driver->limits.max_scalar_length
+	                  || driver->limits.max_output_bytes || driver->limits.timeout_ms;
+}
+
+void
+yaml_path_driver_set_input_origin (yaml_path_driver_t *driver, const yaml_mark_t *start, const yaml_mark_t *origin)
+{
+	if (driver == NULL)
+		return;
+	driver->origin_set = start != NULL && origin != NULL;
+	if (driver->origin_set) {
+		driver->origin_start = *start;
+		driver->origin = *origin;
+	}
+}
+
+int
+yaml_path_driver_run (yaml_path_driver_t *driver, yaml_path_t *path, yaml_parser_t *parser)
+{
+	if (driver == NULL || path == NULL || parser == NULL)
+		return -1;
+	int res = yaml_path_driver_parse(driver, path, parser);
+	yaml_path_driver_output_release(driver);
+	return res;
+}
+
+int
+yaml_path_driver_count (yaml_path_driver_t *driver, yaml_path_t *path, yaml_parser_t *parser, size_t limit, size_t *count)
+{
+	if (driver == NULL || path == NULL || parser == NULL || count == NULL)
+		return -1;
+
+	// Output is dropped, limits are still applied
+	yaml_emitter_t *emitter = driver->emitter;
+	yaml_path_event_handler_t *handler = driver->handler;
+	void *handler_data = driver->handler_data;
+	yaml_path_match_handler_t *match_handler;
+	void *match_handler_data;
+	yaml_path_match_handler_get(path, &match_handler, &match_handler_data);
+	yaml_path_driver_set_output_handler(driver, NULL, NULL);
+	yaml_path_set_match_handler(path, yaml_path_driver_match_handler, NULL);
+	driver->count_limit = limit;
+
+	int res = yaml_path_driver_parse(driver, path, parser);
+	*count = yaml_path_matches_get(path);
+
+	driver->count_limit = 0;
+	yaml_path_set_match_handler(path, match_handler, match_handler_data);
+	driver->emitter = emitter;
+	driver->handler = handler;
+	driver->handler_data = handler_data;
+	return res;
+}
+
+static int
+yaml_path_driver_string_run (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *input, size_t size)
+{
+	// Unselected documents are skipped first, the blocks mode is applied to
+	// the selected ones
+	if (yaml_path_documents_selective(path)) {
+		yaml_path_driver_run_init(driver);
+		int res = yaml_path_driver_run_documents(driver, path, input, size);
+		if (res <= 0) {
+			yaml_path_driver_output_release(driver);
+			return res;
+		}
+	}
+	// Node handlers get the events with the whole values
+	if (driver->block_min_size && !yaml_path_node_handler_is_set(path))
+		return yaml_path_driver_run_blocks(driver, path, input, size);
+	if (driver->threads > 1) {
+		yaml_path_driver_run_init(driver);
+		int res = yaml_path_driver_run_parallel(driver, path, input, size);
+		if (res <= 0) {
+			yaml_path_driver_output_release(driver);
+			return res;
+		}
+	}
+	if (!yaml_parser_initialize(&driver->parser)) {
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for parser", 0);
+		return -2;
+	}
+	yaml_parser_set_input_string(&driver->parser, input, size);
+	int res = yaml_path_driver_run(driver, path, &driver->parser);
+	yaml_parser_delete(&driver->parser);
+	driver->output_skip = 0;
+	return res;
+}
+
+int
+yaml_path_driver_run_string (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *input, size_t size)
+{
+	if (driver == NULL || path == NULL || input == NULL)
+		return -1;
+	driver->offset_base = 0;
+	memset(&driver->offset_cursor, 0, sizeof(driver->offset_cursor));
+	yaml_path_driver_offsets_set(driver, path, input, size);
+	int res = yaml_path_driver_string_run(driver, path, input, size);
+	yaml_path_set_offset_handler(path, NULL, NULL);
+	return res;
+}
+
+int
+yaml_path_driver_run_fd (yaml_path_driver_t *driver, yaml_path_t *path, int fd)
+{
+	if (driver == NULL || fd < 0)
+		return -1;
+	yaml_path_input_t *input = yaml_path_input_open(fd);
+	if (input == NULL) {
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for input", 0);
+		return -2;
+	}
+	if (!yaml_parser_initialize(&driver->parser)) {
+		yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for parser", 0);
+		yaml_path_input_close(input);
+		return -2;
+	}
+	yaml_path_input_set_parser(input, &driver->parser);
+	int res = yaml_path_driver_run(driver, path, &driver->parser);
+	// The parser knows only that the read failed
+	const yaml_path_error_t *error = yaml_path_input_error_get(input);
+	if (res && driver->error.type == YAML_PATH_ERROR_INPUT && error->type != YAML_PATH_ERROR_NONE)
+		driver->error = *error;
+	yaml_parser_delete(&driver->parser);
+	yaml_path_input_close(input);
+	return res;
+}
+
+int
+yaml_path_driver_feed (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *chunk, size_t size)
+{
+	if (driver == NULL || path == NULL || (chunk == NULL && size))
+		return -1;
+
+	if (!driver->feed_started) {
+		yaml_path_driver_run_init(driver);
+		driver->feed_size = 0;
+		driver->feed_documents = 0;
+		driver->feed_raw = false;
+		driver->feed_open = false;
+		driver->feed_open_failed = false;
+		driver->feed_entry_line = SIZE_MAX;
+		yaml_path_driver_scan_init(&driver->feed_scan, 0);
+		memset(&driver->feed_cursor, 0, sizeof(driver->feed_cursor));
+		driver->offset_base = 0;
+		memset(&driver->offset_cursor, 0, sizeof(driver->offset_cursor));
+		driver->feed_started = true;
+
+		yaml_event_t event;
+		yaml_stream_start_event_initialize(&event, YAML_UTF8_ENCODING);
+		if (yaml_path_driver_event(driver, path, &driver->parser, &event)) {
+			yaml_path_driver_output_release(driver);
+			return -2;
+		}
+	}
+
+	if (driver->feed_size + size > driver->feed_alloc) {
+		size_t alloc = driver->feed_alloc ? driver->feed_alloc : 4096;
+		while (alloc < driver->feed_size + size)
+			alloc *= 2;
+		unsigned char *buffer = realloc(driver->feed_buffer, alloc);
+		if (buffer == NULL) {
+			yaml_path_driver_error_set(driver, YAML_PATH_ERROR_NOMEM, "Not enough memory for input", 0);
+			yaml_path_driver_output_release(driver);
+			return -2;
+		}
+		driver->feed_buffer = buffer;
+		driver->feed_alloc = alloc;
+	}
+	if (size)
+		memcpy(driver->feed_buffer + driver->feed_size, chunk, size);
+	driver->feed_size += size;
+
+	yaml_path_driver_offsets_set(driver, path, driver->feed_buffer, driver->feed_size);
+	int res = yaml_path_driver_feed_documents(driver, path, false);
+	yaml_path_set_offset_handler(path, NULL, NULL);
+	yaml_path_driver_output_release(driver);
+	return res;
+}
+
+int
+yaml_path_driver_feed_end (yaml_path_driver_t *driver, yaml_path_t *path)
+{
+	if (driver == NULL || path == NULL)
+		return -1;
+
+	int res = yaml_path_driver_feed(driver, path, NULL, 0);
+	yaml_path_driver_offsets_set(driver, path, driver->feed_buffer, driver->feed_size);
+	if (!res)
+		res = yaml_path_driver_feed_documents(driver, path, true);
+	if (!res)
+		res = yaml_path_driver_stream_end(driver, path, &driver->parser) ? -2 : 0;
+	yaml_path_set_offset_handler(path, NULL, NULL);
+	yaml_path_driver_output_release(driver);
+	driver->feed_started = false;
+	return res;
+}
+
+int
+yaml_path_driver_feed_restart (yaml_path_driver_t *driver, yaml_path_t *path)
+{
+	if (driver == NULL || path == NULL)
+		return -1;
+	if (!driver->feed_started)
+		return 0;
+
+	yaml_path_driver_offsets_set(driver, path, driver->feed_buffer, driver->feed_size);
+	int res = yaml_path_driver_feed_documents(driver, path, true);
+	yaml_path_set_offset_handler(path, NULL, NULL);
+	yaml_path_driver_output_release(driver);
+	driver->feed_size = 0;
+	driver->feed_documents = 0;
+	driver->feed_raw = false;
+	driver->feed_open = false;
+	driver->feed_open_failed = false;
+	driver->feed_entry_line = SIZE_MAX;
+	yaml_path_driver_scan_init(&driver->feed_scan, 0);
+	memset(&driver->feed_cursor, 0, sizeof(driver->feed_cursor));
+	driver->offset_base = 0;
+	memset(&driver->offset_cursor, 0, sizeof(driver->offset_cursor));
+	return res;
+}
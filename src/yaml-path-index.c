@@ -0,0 +1,654 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+
+#include <yaml.h>
+
+#include "yaml-path.h"
+#include "yaml-path-private.h"
+
+
+#define YAML_PATH_INDEX_MAGIC          "YPINDEX"
+#define YAML_PATH_INDEX_VERSION        2
+#define YAML_PATH_INDEX_BYTE_ORDER     0x01020304
+#define YAML_PATH_INDEX_MAX_STEPS      64
+#define YAML_PATH_INDEX_NONE           UINT32_MAX
+#define YAML_PATH_INDEX_MIN_ALLOC      64
+
+// Content hash is calculated from the evenly distributed blocks of the file,
+// so the validation of the index doesn't need to read the whole file
+#define YAML_PATH_INDEX_HASH_BLOCK     4096
+#define YAML_PATH_INDEX_HASH_BLOCKS    64
+
+
+typedef enum yaml_path_index_flag {
+	YAML_PATH_INDEX_FLAG_CHILDREN  = 1 << 0, // Children of the node are indexed
+	YAML_PATH_INDEX_FLAG_AMBIGUOUS = 1 << 1, // Duplicate key in the parent map
+	YAML_PATH_INDEX_FLAG_OPAQUE    = 1 << 2, // Node can't be parsed on its own
+} yaml_path_index_flag_t;
+
+typedef enum yaml_path_index_doc_flag {
+	YAML_PATH_INDEX_DOC_EXPLICIT_START = 1 << 0,
+	YAML_PATH_INDEX_DOC_EXPLICIT_END   = 1 << 1,
+} yaml_path_index_doc_flag_t;
+
+typedef struct yaml_path_index_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t depth;
+	uint32_t doc_flags;
+	uint64_t file_size;
+	int64_t file_mtime;
+	uint64_t file_hash;
+	uint64_t entries_count;
+	uint64_t strings_size;
+} yaml_path_index_header_t;
+
+typedef struct yaml_path_index_entry {
+	uint64_t start;
+	uint64_t end;
+	uint64_t key; // Offset of the key in the strings table, or sequence index
+	uint64_t index; // Mark of the start (in characters)
+	uint64_t line;
+	uint32_t key_len;
+	uint32_t column;
+	uint32_t first_child;
+	uint32_t children;
+	uint8_t node_type;
+	uint8_t flags;
+	uint8_t reserved[6];
+} yaml_path_index_entry_t;
+
+struct yaml_path_index {
+	const unsigned char *file;
+	size_t file_size;
+	void *map;
+	size_t map_size;
+
+	const yaml_path_index_header_t *header;
+	const yaml_path_index_entry_t *entries;
+	const char *strings;
+
+	// Parser input state: prefix, padding, body, suffix
+	int input_stage;
+	const char *prefix;
+	size_t padding;
+	const unsigned char *body;
+	const unsigned char *body_end;
+	const char *suffix;
+
+	// Mark of the body start in the parser input and in the file
+	yaml_mark_t start;
+	yaml_mark_t origin;
+};
+
+
+typedef struct yaml_path_index_cursor {
+	size_t index;
+	uint64_t offset;
+} yaml_path_index_cursor_t;
+
+typedef struct yaml_path_index_frame {
+	uint32_t entry;
+	bool mapping;
+	size_t counter;
+	bool key_valid;
+	uint64_t key;
+	uint32_t key_len;
+} yaml_path_index_frame_t;
+
+typedef struct yaml_path_index_node {
+	yaml_path_index_entry_t entry;
+	uint32_t parent;
+} yaml_path_index_node_t;
+
+typedef struct yaml_path_index_builder {
+	const unsigned char *data;
+	size_t size;
+	yaml_path_index_cursor_t cursor;
+
+	yaml_path_index_node_t *nodes;
+	size_t nodes_count;
+	size_t nodes_alloc;
+
+	char *strings;
+	size_t strings_size;
+	size_t strings_alloc;
+
+	yaml_path_index_frame_t *frames;
+	size_t frames_count;
+	size_t frames_alloc;
+} yaml_path_index_builder_t;
+
+typedef struct yaml_path_index_sort_key {
+	const char *key;
+	uint32_t key_len;
+	uint32_t node;
+} yaml_path_index_sort_key_t;
+
+
+static uint64_t
+yaml_path_index_hash (const unsigned char *data, size_t size)
+{
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	size_t step = size / YAML_PATH_INDEX_HASH_BLOCKS;
+	if (step < YAML_PATH_INDEX_HASH_BLOCK)
+		step = YAML_PATH_INDEX_HASH_BLOCK;
+	for (size_t pos = 0; pos < size; pos += step) {
+		size_t end = pos + YAML_PATH_INDEX_HASH_BLOCK < size ? pos + YAML_PATH_INDEX_HASH_BLOCK : size;
+		for (size_t i = pos; i < end; i++) {
+			hash ^= data[i];
+			hash *= 0x100000001b3ULL;
+		}
+	}
+	for (size_t i = size > YAML_PATH_INDEX_HASH_BLOCK ? size - YAML_PATH_INDEX_HASH_BLOCK : 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static size_t
+yaml_path_index_bom_len (const unsigned char *data, size_t size)
+{
+	// Byte order mark is not counted by the parser marks
+	return size >= 3 && !memcmp(data, "\xef\xbb\xbf", 3) ? 3 : 0;
+}
+
+static uint64_t
+yaml_path_index_cursor_offset (yaml_path_index_cursor_t *cursor, const unsigned char *data, size_t size, size_t index)
+{
+	// Marks count characters, the offset is in bytes of the UTF-8 input
+	if (index < cursor->index) {
+		cursor->index = 0;
+		cursor->offset = yaml_path_index_bom_len(data, size);
+	}
+	while (cursor->index < index && cursor->offset < size) {
+		cursor->offset++;
+		while (cursor->offset < size && (data[cursor->offset] & 0xC0) == 0x80)
+			cursor->offset++;
+		cursor->index++;
+	}
+	return cursor->offset;
+}
+
+static int
+yaml_path_index_builder_key_add (yaml_path_index_builder_t *b, yaml_path_index_frame_t *frame, const char *key, size_t len)
+{
+	while (b->strings_size + len + 1 > b->strings_alloc) {
+		size_t new_alloc = b->strings_alloc ? b->strings_alloc * 2 : 4096;
+		char *strings = realloc(b->strings, new_alloc);
+		if (strings == NULL)
+			return -1;
+		b->strings = strings;
+		b->strings_alloc = new_alloc;
+	}
+	memcpy(b->strings + b->strings_size, key, len);
+	b->strings[b->strings_size + len] = '\0';
+	frame->key = b->strings_size;
+	frame->key_len = len;
+	frame->key_valid = true;
+	b->strings_size += len + 1;
+	return 0;
+}
+
+static int
+yaml_path_index_builder_event (yaml_path_index_builder_t *b, const yaml_event_t *event, size_t depth)
+{
+	yaml_path_index_frame_t *parent = b->frames_count ? &b->frames[b->frames_count - 1] : NULL;
+	uint32_t node = YAML_PATH_INDEX_NONE;
+
+	switch (event->type) {
+	case YAML_MAPPING_START_EVENT:
+	case YAML_SEQUENCE_START_EVENT:
+	case YAML_SCALAR_EVENT:
+	case YAML_ALIAS_EVENT: {
+			bool is_key = parent != NULL && parent->mapping && parent->counter % 2 == 0;
+			if (parent != NULL)
+				parent->counter++;
+			if (is_key) {
+				parent->key_valid = false;
+				if (event->type == YAML_SCALAR_EVENT
+				    && yaml_path_index_builder_key_add(b, parent, (const char *)event->data.scalar.value, event->data.scalar.length))
+					return -1;
+			} else if (b->frames_count <= depth
+			           && (parent == NULL || (parent->entry != YAML_PATH_INDEX_NONE && (!parent->mapping || parent->key_valid)))) {
+				void *nodes = yaml_path_grow(b->nodes, &b->nodes_alloc, b->nodes_count, sizeof(*b->nodes), YAML_PATH_INDEX_MIN_ALLOC);
+				if (nodes == NULL)
+					return -1;
+				b->nodes = nodes;
+				node = b->nodes_count++;
+				yaml_path_index_node_t *n = &b->nodes[node];
+				memset(n, 0, sizeof(*n));
+				n->parent = parent != NULL ? parent->entry : YAML_PATH_INDEX_NONE;
+				if (parent != NULL && parent->mapping) {
+					n->entry.key = parent->key;
+					n->entry.key_len = parent->key_len;
+				} else if (parent != NULL) {
+					n->entry.key = parent->counter - 1;
+				}
+				n->entry.start = yaml_path_index_cursor_offset(&b->cursor, b->data, b->size, event->start_mark.index);
+				n->entry.index = event->start_mark.index;
+				n->entry.line = event->start_mark.line;
+				n->entry.column = event->start_mark.column;
+				n->entry.first_child = YAML_PATH_INDEX_NONE;
+				switch (event->type) {
+				case YAML_MAPPING_START_EVENT:
+					n->entry.node_type = YAML_MAPPING_NODE;
+					break;
+				case YAML_SEQUENCE_START_EVENT:
+					n->entry.node_type = YAML_SEQUENCE_NODE;
+					break;
+				default:
+					n->entry.node_type = YAML_SCALAR_NODE;
+					n->entry.end = yaml_path_index_cursor_offset(&b->cursor, b->data, b->size, event->end_mark.index);
+					if (event->type == YAML_SCALAR_EVENT
+					    && (event->data.scalar.style == YAML_LITERAL_SCALAR_STYLE || event->data.scalar.style == YAML_FOLDED_SCALAR_STYLE)) {
+						// Explicit indentation indicator is relative to the parent node
+						for (uint64_t i = n->entry.start; i < n->entry.end && b->data[i] != '\n'; i++) {
+							if (b->data[i] >= '1' && b->data[i] <= '9')
+								n->entry.flags |= YAML_PATH_INDEX_FLAG_OPAQUE;
+						}
+					}
+					break;
+				}
+				if (b->frames_count < depth && n->entry.node_type != YAML_SCALAR_NODE)
+					n->entry.flags |= YAML_PATH_INDEX_FLAG_CHILDREN;
+			}
+			if (event->type == YAML_MAPPING_START_EVENT || event->type == YAML_SEQUENCE_START_EVENT) {
+				void *frames = yaml_path_grow(b->frames, &b->frames_alloc, b->frames_count, sizeof(*b->frames), YAML_PATH_INDEX_MIN_ALLOC);
+				if (frames == NULL)
+					return -1;
+				b->frames = frames;
+				yaml_path_index_frame_t *frame = &b->frames[b->frames_count++];
+				memset(frame, 0, sizeof(*frame));
+				frame->entry = node;
+				frame->mapping = event->type == YAML_MAPPING_START_EVENT;
+			}
+		}
+		break;
+	case YAML_MAPPING_END_EVENT:
+	case YAML_SEQUENCE_END_EVENT:
+		assert(parent != NULL);
+		if (parent->entry != YAML_PATH_INDEX_NONE)
+			b->nodes[parent->entry].entry.end = yaml_path_index_cursor_offset(&b->cursor, b->data, b->size, event->end_mark.index);
+		b->frames_count--;
+		break;
+	default:
+		break;
+	}
+	return 0;
+}
+
+static int
+yaml_path_index_sort_key_cmp (const void *a, const void *b)
+{
+	const yaml_path_index_sort_key_t *ka = a;
+	const yaml_path_index_sort_key_t *kb = b;
+	int res = memcmp(ka->key, kb->key, ka->key_len < kb->key_len ? ka->key_len : kb->key_len);
+	if (res == 0)
+		res = ka->key_len < kb->key_len ? -1 : ka->key_len > kb->key_len;
+	return res;
+}
+
+static int
+yaml_path_index_builder_write (yaml_path_index_builder_t *b, yaml_path_index_header_t *header, const char *index_name)
+{
+	int res = -1;
+	size_t n = b->nodes_count;
+	size_t *child_start = calloc(n + 1, sizeof(*child_start));
+	yaml_path_index_sort_key_t *children = malloc((n ? n : 1) * sizeof(*children));
+	uint32_t *order = malloc((n ? n : 1) * sizeof(*order));
+	yaml_path_index_entry_t *entries = malloc((n ? n : 1) * sizeof(*entries));
+	FILE *f = NULL;
+
+	if (child_start == NULL || children == NULL || order == NULL || entries == NULL)
+		goto cleanup;
+
+	// Group children by parents (parents always precede their children)
+	for (size_t i = 1; i < n; i++)
+		child_start[b->nodes[i].parent + 1]++;
+	for (size_t i = 1; i <= n; i++)
+		child_start[i] += child_start[i - 1];
+	for (size_t i = 1; i < n; i++) {
+		size_t pos = child_start[b->nodes[i].parent]++;
+		children[pos].key = b->nodes[i].entry.key_len ? b->strings + b->nodes[i].entry.key : "";
+		children[pos].key_len = b->nodes[i].entry.key_len;
+		children[pos].node = i;
+	}
+	for (size_t i = n; i > 0; i--)
+		child_start[i] = child_start[i - 1];
+	child_start[0] = 0;
+
+	// Breadth-first layout keeps children of every node next to each other
+	size_t head = 0, tail = 1;
+	order[0] = 0;
+	while (head < tail) {
+		uint32_t node = order[head];
+		yaml_path_index_entry_t *e = &entries[head];
+		*e = b->nodes[node].entry;
+		size_t first = child_start[node], count = child_start[node + 1] - first;
+		if (e->node_type == YAML_MAPPING_NODE && count > 1) {
+			qsort(children + first, count, sizeof(*children), yaml_path_index_sort_key_cmp);
+			for (size_t i = first + 1; i < first + count; i++) {
+				if (!yaml_path_index_sort_key_cmp(&children[i - 1], &children[i])) {
+					b->nodes[children[i - 1].node].entry.flags |= YAML_PATH_INDEX_FLAG_AMBIGUOUS;
+					b->nodes[children[i].node].entry.flags |= YAML_PATH_INDEX_FLAG_AMBIGUOUS;
+				}
+			}
+		}
+		e->first_child = tail;
+		e->children = count;
+		for (size_t i = first; i < first + count; i++)
+			order[tail++] = children[i].node;
+		head++;
+	}
+
+	header->entries_count = n;
+	header->strings_size = b->strings_size;
+
+	size_t tmp_len = strlen(index_name) + 5;
+	char *tmp_name = malloc(tmp_len);
+	if (tmp_name == NULL)
+		goto cleanup;
+	snprintf(tmp_name, tmp_len, "%s.tmp", index_name);
+	f = fopen(tmp_name, "wb");
+	if (f != NULL
+	    && fwrite(header, sizeof(*header), 1, f) == 1
+	    && fwrite(entries, sizeof(*entries), n, f) == n
+	    && fwrite(b->strings, 1, b->strings_size, f) == b->strings_size
+	    && !fclose(f)) {
+		f = NULL;
+		if (!rename(tmp_name, index_name))
+			res = 0;
+	}
+	if (res)
+		unlink(tmp_name);
+	free(tmp_name);
+
+cleanup:
+	if (f != NULL)
+		fclose(f);
+	free(child_start);
+	free(children);
+	free(order);
+	free(entries);
+	return res;
+}
+
+static const unsigned char*
+yaml_path_index_map_file (const char *file_name, size_t *size, struct stat *st)
+{
+	int fd = open(file_name, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	void *data = NULL;
+	if (!fstat(fd, st) && st->st_size > 0) {
+		data = mmap(NULL, st->st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED)
+			data = NULL;
+		*size = st->st_size;
+	}
+	close(fd);
+	return data;
+}
+
+static int
+yaml_path_index_read_handler (void *data, unsigned char *buffer, size_t size, size_t *size_read)
+{
+	yaml_path_index_t *index = data;
+	*size_read = 0;
+	while (*size_read < size && index->input_stage < 4) {
+		size_t len = 0;
+		switch (index->input_stage) {
+		case 0:
+			len = strlen(index->prefix);
+			len = len < size - *size_read ? len : size - *size_read;
+			memcpy(buffer + *size_read, index->prefix, len);
+			index->prefix += len;
+			break;
+		case 1:
+			len = index->padding < size - *size_read ? index->padding : size - *size_read;
+			memset(buffer + *size_read, ' ', len);
+			index->padding -= len;
+			break;
+		case 2:
+			len = (size_t)(index->body_end - index->body);
+			len = len < size - *size_read ? len : size - *size_read;
+			memcpy(buffer + *size_read, index->body, len);
+			index->body += len;
+			break;
+		case 3:
+			len = strlen(index->suffix);
+			len = len < size - *size_read ? len : size - *size_read;
+			memcpy(buffer + *size_read, index->suffix, len);
+			index->suffix += len;
+			break;
+		}
+		*size_read += len;
+		if (*size_read < size)
+			index->input_stage++;
+	}
+	return 1;
+}
+
+static const yaml_path_index_entry_t*
+yaml_path_index_child_get (yaml_path_index_t *index, const yaml_path_index_entry_t *entry, const yaml_path_step_t *step)
+{
+	if (!(entry->flags & YAML_PATH_INDEX_FLAG_CHILDREN))
+		return NULL;
+	if (step->key == NULL) {
+		if (entry->node_type != YAML_SEQUENCE_NODE || step->index >= entry->children)
+			return NULL;
+		return &index->entries[entry->first_child + step->index];
+	}
+	if (entry->node_type != YAML_MAPPING_NODE)
+		return NULL;
+	yaml_path_index_sort_key_t key = {step->key, strlen(step->key), 0};
+	size_t lo = entry->first_child, hi = entry->first_child + entry->children;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		yaml_path_index_sort_key_t mid_key = {index->strings + index->entries[mid].key, index->entries[mid].key_len, 0};
+		int cmp = yaml_path_index_sort_key_cmp(&key, &mid_key);
+		if (cmp == 0)
+			return &index->entries[mid];
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return NULL;
+}
+
+
+/* Public API -------------------------------------------------------------- */
+
+int
+yaml_path_index_build (const char *file_name, const char *index_name, size_t depth)
+{
+	if (file_name == NULL || index_name == NULL)
+		return -1;
+
+	struct stat st;
+	yaml_path_index_builder_t b;
+	memset(&b, 0, sizeof(b));
+	b.data = yaml_path_index_map_file(file_name, &b.size, &st);
+	if (b.data == NULL)
+		return -1;
+	b.cursor.offset = yaml_path_index_bom_len(b.data, b.size);
+
+	yaml_path_index_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, YAML_PATH_INDEX_MAGIC, sizeof(header.magic));
+	header.version = YAML_PATH_INDEX_VERSION;
+	header.byte_order = YAML_PATH_INDEX_BYTE_ORDER;
+	header.depth = depth;
+	header.file_size = b.size;
+	header.file_mtime = st.st_mtime;
+	header.file_hash = yaml_path_index_hash(b.data, b.size);
+
+	int res = 0;
+	size_t documents = 0;
+	yaml_parser_t parser;
+	yaml_event_t event;
+	yaml_event_type_t event_type;
+
+	yaml_parser_initialize(&parser);
+	yaml_parser_set_input_string(&parser, b.data, b.size);
+	do {
+		if (!yaml_parser_parse(&parser, &event)) {
+			res = -1;
+			break;
+		}
+		event_type = event.type;
+		if (event_type == YAML_STREAM_START_EVENT && event.data.stream_start.encoding != YAML_UTF8_ENCODING) {
+			res = -1;
+		} else if (event_type == YAML_DOCUMENT_START_EVENT) {
+			// Directives would be lost for the indexed parts of the document
+			if (++documents > 1
+			    || event.data.document_start.version_directive != NULL
+			    || event.data.document_start.tag_directives.start != event.data.document_start.tag_directives.end)
+				res = -1;
+			if (!event.data.document_start.implicit)
+				header.doc_flags |= YAML_PATH_INDEX_DOC_EXPLICIT_START;
+		} else if (event_type == YAML_DOCUMENT_END_EVENT) {
+			if (!event.data.document_end.implicit)
+				header.doc_flags |= YAML_PATH_INDEX_DOC_EXPLICIT_END;
+		} else {
+			res = yaml_path_index_builder_event(&b, &event, depth);
+		}
+		yaml_event_delete(&event);
+	} while (event_type != YAML_STREAM_END_EVENT && !res);
+	yaml_parser_delete(&parser);
+
+	if (!res && b.nodes_count)
+		res = yaml_path_index_builder_write(&b, &header, index_name);
+	else
+		res = -1;
+
+	free(b.nodes);
+	free(b.strings);
+	free(b.frames);
+	munmap((void *)b.data, b.size);
+	return res;
+}
+
+yaml_path_index_t*
+yaml_path_index_open (const char *file_name, const char *index_name)
+{
+	if (file_name == NULL || index_name == NULL)
+		return NULL;
+
+	yaml_path_index_t *index = malloc(sizeof(*index));
+	if (index == NULL)
+		return NULL;
+	memset(index, 0, sizeof(*index));
+
+	struct stat st, index_st;
+	index->file = yaml_path_index_map_file(file_name, &index->file_size, &st);
+	if (index->file == NULL)
+		goto error;
+	index->map = (void *)yaml_path_index_map_file(index_name, &index->map_size, &index_st);
+	if (index->map == NULL || index->map_size < sizeof(*index->header))
+		goto error;
+
+	index->header = index->map;
+	if (memcmp(index->header->magic, YAML_PATH_INDEX_MAGIC, sizeof(index->header->magic))
+	    || index->header->version != YAML_PATH_INDEX_VERSION
+	    || index->header->byte_order != YAML_PATH_INDEX_BYTE_ORDER
+	    || index->header->file_size != index->file_size
+	    || index->header->file_mtime != (int64_t)st.st_mtime
+	    || index->header->entries_count == 0
+	    || index->header->entries_count > (index->map_size - sizeof(*index->header)) / sizeof(*index->entries)
+	    || sizeof(*index->header) + index->header->entries_count * sizeof(*index->entries) + index->header->strings_size != index->map_size
+	    || index->header->file_hash != yaml_path_index_hash(index->file, index->file_size))
+		goto error;
+
+	index->entries = (const yaml_path_index_entry_t *)(index->header + 1);
+	index->strings = (const char *)(index->entries + index->header->entries_count);
+	return index;
+
+error:
+	yaml_path_index_close(index);
+	return NULL;
+}
+
+void
+yaml_path_index_close (yaml_path_index_t *index)
+{
+	if (index == NULL)
+		return;
+	if (index->file != NULL)
+		munmap((void *)index->file, index->file_size);
+	if (index->map != NULL)
+		munmap(index->map, index->map_size);
+	free(index);
+}
+
+int
+yaml_path_index_seek (yaml_path_index_t *index, yaml_path_t *path, yaml_parser_t *parser)
+{
+	if (index == NULL || path == NULL || parser == NULL)
+		return -1;
+
+	yaml_path_step_t steps[YAML_PATH_INDEX_MAX_STEPS];
+	size_t steps_count = yaml_path_steps_get(path, steps, YAML_PATH_INDEX_MAX_STEPS);
+	size_t used = 0;
+
+	const yaml_path_index_entry_t *entry = &index->entries[0];
+	while (used < steps_count) {
+		const yaml_path_index_entry_t *child = yaml_path_index_child_get(index, entry, &steps[used]);
+		if (child == NULL || child->flags & (YAML_PATH_INDEX_FLAG_AMBIGUOUS | YAML_PATH_INDEX_FLAG_OPAQUE))
+			break;
+		entry = child;
+		used++;
+	}
+
+	index->input_stage = 0;
+	memset(&index->start, 0, sizeof(index->start));
+	memset(&index->origin, 0, sizeof(index->origin));
+	if (used == 0) {
+		index->prefix = "";
+		index->padding = 0;
+		index->body = index->file;
+		index->body_end = index->file + index->file_size;
+		index->suffix = "";
+	} else {
+		// Padding keeps the original column of the first line of the node
+		index->prefix = index->header->doc_flags & YAML_PATH_INDEX_DOC_EXPLICIT_START ? "---\n" : "";
+		index->padding = entry->column;
+		index->body = index->file + entry->start;
+		index->body_end = index->file + entry->end;
+		index->suffix = index->header->doc_flags & YAML_PATH_INDEX_DOC_EXPLICIT_END ? "\n...\n" : "\n";
+		index->start.index = strlen(index->prefix) + entry->column;
+		index->start.line = *index->prefix != '\0';
+		index->start.column = entry->column;
+		index->origin.index = entry->index;
+		index->origin.line = entry->line;
+		index->origin.column = entry->column;
+	}
+	yaml_path_steps_skip(path, used);
+	yaml_parser_set_input(parser, yaml_path_index_read_handler, index);
+
+	return 0;
+}
+
+void
+yaml_path_index_origin_get (const yaml_path_index_t *index, yaml_mark_t *start, yaml_mark_t *origin)
+{
+	if (index == NULL)
+		return;
+	if (start != NULL)
+		*start = index->start;
+	if (origin != NULL)
+		*origin = index->origin;
+}
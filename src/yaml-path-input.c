@@ -0,0 +1,370 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <yaml.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "yaml-path.h"
+#include "yaml-path-private.h"
+
+
+// The reader thread runs ahead of the parser by at most this many buffers
+#define YAML_PATH_INPUT_BUFFERS        4
+#define YAML_PATH_INPUT_BUFFER_SIZE    (128 * 1024)
+#define YAML_PATH_INPUT_READ_SIZE      (64 * 1024)
+#define YAML_PATH_INPUT_MAGIC_SIZE     4
+
+
+struct yaml_path_input {
+	int fd;
+	yaml_path_compression_t compression;
+
+	// Bytes read to detect the compression, they are passed on first
+	unsigned char head[YAML_PATH_INPUT_MAGIC_SIZE];
+	size_t head_size;
+	size_t head_pos;
+	size_t offset; // Bytes read from the descriptor so far
+
+	// Buffers read (and decompressed) by the thread for the parser
+	yaml_path_ring_t ring;
+	const unsigned char *buffer;
+	size_t buffer_size;
+	size_t buffer_pos;
+	pthread_t thread;
+	bool started;
+
+	// Set by the thread before the ring ends
+	yaml_path_error_t error;
+};
+
+
+static void
+yaml_path_input_error_set (yaml_path_input_t *input, const char *message)
+{
+	if (input->error.type == YAML_PATH_ERROR_NONE) {
+		input->error.type = YAML_PATH_ERROR_INPUT;
+		input->error.message = message;
+		input->error.pos = input->offset;
+	}
+}
+
+static ssize_t
+yaml_path_input_read (yaml_path_input_t *input, unsigned char *buffer, size_t size)
+{
+	ssize_t len;
+	do {
+		len = read(input->fd, buffer, size);
+	} while (len < 0 && errno == EINTR);
+	if (len > 0)
+		input->offset += len;
+	return len;
+}
+
+// The stream starts with the head, then it's read from the descriptor
+static ssize_t
+yaml_path_input_read_stream (yaml_path_input_t *input, unsigned char *buffer, size_t size)
+{
+	if (input->head_pos < input->head_size) {
+		size_t len = input->head_size - input->head_pos;
+		if (len > size)
+			len = size;
+		memcpy(buffer, input->head + input->head_pos, len);
+		input->head_pos += len;
+		return len;
+	}
+	ssize_t len = yaml_path_input_read(input, buffer, size);
+	if (len < 0)
+		yaml_path_input_error_set(input, "Unable to read the input");
+	return len;
+}
+
+static void
+yaml_path_input_plain (yaml_path_input_t *input)
+{
+	unsigned char *buffer;
+	while ((buffer = yaml_path_ring_produce_get(&input->ring)) != NULL) {
+		ssize_t len = yaml_path_input_read_stream(input, buffer, YAML_PATH_INPUT_BUFFER_SIZE);
+		if (len <= 0)
+			break;
+		yaml_path_ring_produce_put(&input->ring, len);
+	}
+}
+
+#ifdef HAVE_ZLIB
+static void
+yaml_path_input_gzip (yaml_path_input_t *input, unsigned char *in)
+{
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+	// Automatic gzip/zlib header detection
+	if (inflateInit2(&z, 15 + 32) != Z_OK) {
+		yaml_path_input_error_set(input, "Not enough memory for decompression");
+		return;
+	}
+
+	bool member_end = false;
+	bool end = false;
+	while (!end) {
+		unsigned char *buffer = yaml_path_ring_produce_get(&input->ring);
+		if (buffer == NULL)
+			break;
+		z.next_out = buffer;
+		z.avail_out = YAML_PATH_INPUT_BUFFER_SIZE;
+		while (z.avail_out && !end) {
+			if (!z.avail_in) {
+				ssize_t len = yaml_path_input_read_stream(input, in, YAML_PATH_INPUT_READ_SIZE);
+				if (len < 0)
+					goto cleanup;
+				if (len == 0) {
+					if (!member_end)
+						yaml_path_input_error_set(input, "Truncated gzip stream");
+					end = true;
+					break;
+				}
+				z.next_in = in;
+				z.avail_in = len;
+			}
+			int res = inflate(&z, Z_NO_FLUSH);
+			if (res == Z_STREAM_END) {
+				// Concatenated members form one stream (as with zcat)
+				member_end = true;
+				inflateReset(&z);
+			} else if (res == Z_OK || res == Z_BUF_ERROR) {
+				member_end = false;
+			} else {
+				yaml_path_input_error_set(input, res == Z_MEM_ERROR ? "Not enough memory for decompression" : "Corrupted gzip stream");
+				goto cleanup;
+			}
+		}
+		yaml_path_ring_produce_put(&input->ring, YAML_PATH_INPUT_BUFFER_SIZE - z.avail_out);
+	}
+
+cleanup:
+	inflateEnd(&z);
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static void
+yaml_path_input_zstd (yaml_path_input_t *input, unsigned char *in)
+{
+	ZSTD_DStream *stream = ZSTD_createDStream();
+	if (stream == NULL || ZSTD_isError(ZSTD_initDStream(stream))) {
+		yaml_path_input_error_set(input, "Not enough memory for decompression");
+		ZSTD_freeDStream(stream);
+		return;
+	}
+
+	ZSTD_inBuffer zin = {in, 0, 0};
+	size_t hint = 1; // 0 after a complete frame
+	bool end = false;
+	while (!end) {
+		unsigned char *buffer = yaml_path_ring_produce_get(&input->ring);
+		if (buffer == NULL)
+			break;
+		ZSTD_outBuffer zout = {buffer, YAML_PATH_INPUT_BUFFER_SIZE, 0};
+		while (zout.pos < zout.size && !end) {
+			if (zin.pos == zin.size) {
+				ssize_t len = yaml_path_input_read_stream(input, in, YAML_PATH_INPUT_READ_SIZE);
+				if (len < 0)
+					goto cleanup;
+				if (len == 0) {
+					if (hint)
+						yaml_path_input_error_set(input, "Truncated zstd stream");
+					end = true;
+					break;
+				}
+				zin.size = len;
+				zin.pos = 0;
+			}
+			hint = ZSTD_decompressStream(stream, &zout, &zin);
+			if (ZSTD_isError(hint)) {
+				yaml_path_input_error_set(input, "Corrupted zstd stream");
+				goto cleanup;
+			}
+		}
+		yaml_path_ring_produce_put(&input->ring, zout.pos);
+	}
+
+cleanup:
+	ZSTD_freeDStream(stream);
+}
+#endif
+
+static void*
+yaml_path_input_thread (void *data)
+{
+	yaml_path_input_t *input = data;
+	unsigned char *in = NULL;
+	if (input->compression == YAML_PATH_COMPRESSION_NONE) {
+		yaml_path_input_plain(input);
+	} else if ((in = malloc(YAML_PATH_INPUT_READ_SIZE)) == NULL) {
+		yaml_path_input_error_set(input, "Not enough memory for decompression");
+	} else {
+		switch (input->compression) {
+#ifdef HAVE_ZLIB
+		case YAML_PATH_COMPRESSION_GZIP:
+			yaml_path_input_gzip(input, in);
+			break;
+#endif
+#ifdef HAVE_ZSTD
+		case YAML_PATH_COMPRESSION_ZSTD:
+			yaml_path_input_zstd(input, in);
+			break;
+#endif
+		default:
+			yaml_path_input_error_set(input, "Compression of the input is not supported");
+			break;
+		}
+	}
+	free(in);
+	yaml_path_ring_end(&input->ring);
+	return NULL;
+}
+
+static int
+yaml_path_input_start (yaml_path_input_t *input)
+{
+	if (yaml_path_ring_init(&input->ring, YAML_PATH_INPUT_BUFFERS, YAML_PATH_INPUT_BUFFER_SIZE))
+		return -1;
+	if (pthread_create(&input->thread, NULL, yaml_path_input_thread, input)) {
+		yaml_path_ring_destroy(&input->ring);
+		return -1;
+	}
+	input->started = true;
+	return 0;
+}
+
+static int
+yaml_path_input_read_handler (void *data, unsigned char *buffer, size_t size, size_t *size_read)
+{
+	yaml_path_input_t *input = data;
+	*size_read = 0;
+
+	if (!input->started) {
+		if (input->error.type != YAML_PATH_ERROR_NONE)
+			return 0;
+		ssize_t len = yaml_path_input_read_stream(input, buffer, size);
+		if (len < 0)
+			return 0;
+		*size_read = len;
+		return 1;
+	}
+
+	if (input->buffer == NULL) {
+		input->buffer = yaml_path_ring_consume_get(&input->ring, &input->buffer_size);
+		input->buffer_pos = 0;
+		// Errors are reported after the data read before them
+		if (input->buffer == NULL)
+			return input->error.type == YAML_PATH_ERROR_NONE;
+	}
+	size_t len = input->buffer_size - input->buffer_pos;
+	if (len > size)
+		len = size;
+	memcpy(buffer, input->buffer + input->buffer_pos, len);
+	input->buffer_pos += len;
+	*size_read = len;
+	if (input->buffer_pos == input->buffer_size) {
+		yaml_path_ring_consume_put(&input->ring);
+		input->buffer = NULL;
+	}
+	return 1;
+}
+
+
+/* Public API -------------------------------------------------------------- */
+
+yaml_path_input_t*
+yaml_path_input_open (int fd)
+{
+	if (fd < 0)
+		return NULL;
+
+	yaml_path_input_t *input = malloc(sizeof(*input));
+	if (input == NULL)
+		return NULL;
+	memset(input, 0, sizeof(*input));
+	input->fd = fd;
+
+	while (input->head_size < sizeof(input->head)) {
+		ssize_t len = yaml_path_input_read(input, input->head + input->head_size, sizeof(input->head) - input->head_size);
+		if (len < 0) {
+			yaml_path_input_error_set(input, "Unable to read the input");
+			return input;
+		}
+		if (len == 0)
+			break;
+		input->head_size += len;
+	}
+
+	static const unsigned char gzip_magic[] = {0x1f, 0x8b};
+	static const unsigned char zstd_magic[] = {0x28, 0xb5, 0x2f, 0xfd};
+	if (input->head_size >= sizeof(gzip_magic) && !memcmp(input->head, gzip_magic, sizeof(gzip_magic)))
+		input->compression = YAML_PATH_COMPRESSION_GZIP;
+	else if (input->head_size >= sizeof(zstd_magic) && !memcmp(input->head, zstd_magic, sizeof(zstd_magic)))
+		input->compression = YAML_PATH_COMPRESSION_ZSTD;
+	if (input->compression != YAML_PATH_COMPRESSION_NONE && yaml_path_input_start(input)) {
+		free(input);
+		return NULL;
+	}
+	return input;
+}
+
+void
+yaml_path_input_close (yaml_path_input_t *input)
+{
+	if (input == NULL)
+		return;
+	if (input->started) {
+		yaml_path_ring_stop(&input->ring);
+		pthread_join(input->thread, NULL);
+		yaml_path_ring_destroy(&input->ring);
+	}
+	free(input);
+}
+
+int
+yaml_path_input_set_readahead (yaml_path_input_t *input)
+{
+	if (input == NULL)
+		return -1;
+	if (input->started)
+		return 0;
+	if (input->head_pos || input->offset > input->head_size)
+		return -1;
+	return yaml_path_input_start(input) ? -2 : 0;
+}
+
+yaml_path_compression_t
+yaml_path_input_compression_get (yaml_path_input_t *input)
+{
+	if (input == NULL)
+		return YAML_PATH_COMPRESSION_NONE;
+	return input->compression;
+}
+
+const yaml_path_error_t*
+yaml_path_input_error_get (yaml_path_input_t *input)
+{
+	if (input == NULL)
+		return NULL;
+	return &input->error;
+}
+
+int
+yaml_path_input_set_parser (yaml_path_input_t *input, yaml_parser_t *parser)
+{
+	if (input == NULL || parser == NULL)
+		return -1;
+	yaml_parser_set_input(parser, yaml_path_input_read_handler, input);
+	return 0;
+}
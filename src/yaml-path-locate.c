@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "yaml-path.h"
+#include "yaml-path-private.h"
+
+
+#define YAML_PATH_LOCATE_FRAMES_MIN_ALLOC    16
+
+
+// Open collection
+typedef struct yaml_path_locate_frame {
+	bool mapping;
+	size_t children; // Completed keys and values, or items
+	char *key;       // Key of the value being parsed, NULL for complex keys
+} yaml_path_locate_frame_t;
+
+// Locations are sorted by the index or by the line and column (both follow
+// the order of the input), each order is passed with its own cursor
+typedef struct yaml_path_locate {
+	yaml_path_locate_frame_t *frames;
+	size_t frames_count;
+	size_t frames_alloc;
+	size_t document;
+
+	yaml_path_location_t **by_index;
+	size_t by_index_count;
+	size_t by_index_pos;
+	yaml_path_location_t **by_line;
+	size_t by_line_count;
+	size_t by_line_pos;
+} yaml_path_locate_t;
+
+
+static int
+yaml_path_locate_cmp_index (const void *a, const void *b)
+{
+	const yaml_path_location_t *la = *(yaml_path_location_t * const *)a;
+	const yaml_path_location_t *lb = *(yaml_path_location_t * const *)b;
+	return (la->index > lb->index) - (la->index < lb->index);
+}
+
+static int
+yaml_path_locate_cmp_line (const void *a, const void *b)
+{
+	const yaml_path_location_t *la = *(yaml_path_location_t * const *)a;
+	const yaml_path_location_t *lb = *(yaml_path_location_t * const *)b;
+	if (la->line != lb->line)
+		return la->line > lb->line ? 1 : -1;
+	return (la->column > lb->column) - (la->column < lb->column);
+}
+
+static bool
+yaml_path_locate_before (const yaml_path_location_t *location, const yaml_mark_t *mark)
+{
+	if (location->by_line)
+		return location->line < mark->line || (location->line == mark->line && location->column < mark->column);
+	return location->index < mark->index;
+}
+
+// The location is before the mark on the same line
+static bool
+yaml_path_locate_same_line (const yaml_path_location_t *location, const yaml_mark_t *mark)
+{
+	if (location->by_line)
+		return location->line == mark->line;
+	return location->index >= mark->index - mark->column;
+}
+
+#define yaml_path_locate_print(...)                                       \
+do {                                                                      \
+	size_t pos = len < location->path_size ? len : location->path_size;   \
+	len += snprintf(location->path + pos, location->path_size - pos, __VA_ARGS__); \
+} while (0)
+
+// Path of the innermost open collection, or of its child starting with the
+// event (the key is the segment of a value)
+static void
+yaml_path_locate_path (yaml_path_locate_t *locate, yaml_path_location_t *location, const yaml_event_t *event)
+{
+	size_t len = 0;
+	if (locate->document)
+		yaml_path_locate_print("#%zu", locate->document);
+	for (size_t i = 0; i < locate->frames_count; i++) {
+		yaml_path_locate_frame_t *frame = &locate->frames[i];
+		bool last = i + 1 == locate->frames_count;
+		if (last && event == NULL)
+			break;
+		if (!frame->mapping) {
+			yaml_path_locate_print("[%zu]", frame->children);
+			continue;
+		}
+		const char *key = frame->key;
+		if (!(frame->children % 2))
+			key = last && event->type == YAML_SCALAR_EVENT ? (const char *)event->data.scalar.value : NULL;
+		// Complex keys can't be expressed
+		if (key == NULL)
+			break;
+		size_t pos = len < location->path_size ? len : location->path_size;
+		len += yaml_path_key_snprint(key, location->path + pos, location->path_size - pos);
+	}
+	if (!len)
+		yaml_path_locate_print("$");
+	location->path_length = len;
+}
+
+// Set the paths of the locations before the mark, the ones on the same line
+// as the node starting with the event belong to it
+static void
+yaml_path_locate_resolve (yaml_path_locate_t *locate, const yaml_mark_t *mark, const yaml_event_t *event, const yaml_mark_t *start_mark)
+{
+	for (; locate->by_index_pos < locate->by_index_count; locate->by_index_pos++) {
+		yaml_path_location_t *location = locate->by_index[locate->by_index_pos];
+		if (!yaml_path_locate_before(location, mark))
+			break;
+		bool child = event != NULL && (start_mark == NULL || yaml_path_locate_same_line(location, start_mark));
+		yaml_path_locate_path(locate, location, child ? event : NULL);
+	}
+	for (; locate->by_line_pos < locate->by_line_count; locate->by_line_pos++) {
+		yaml_path_location_t *location = locate->by_line[locate->by_line_pos];
+		if (!yaml_path_locate_before(location, mark))
+			break;
+		bool child = event != NULL && (start_mark == NULL || yaml_path_locate_same_line(location, start_mark));
+		yaml_path_locate_path(locate, location, child ? event : NULL);
+	}
+}
+
+// The child of the innermost collection is complete
+static int
+yaml_path_locate_child_done (yaml_path_locate_t *locate, const yaml_event_t *event)
+{
+	if (!locate->frames_count)
+		return 0;
+	yaml_path_locate_frame_t *frame = &locate->frames[locate->frames_count - 1];
+	if (frame->mapping && !(frame->children % 2)) {
+		free(frame->key);
+		frame->key = NULL;
+		if (event->type == YAML_SCALAR_EVENT && (frame->key = strdup((const char *)event->data.scalar.value)) == NULL)
+			return -1;
+	}
+	frame->children++;
+	return 0;
+}
+
+static int
+yaml_path_locate_frame_push (yaml_path_locate_t *locate, bool mapping)
+{
+	yaml_path_locate_frame_t *frames = yaml_path_grow(locate->frames, &locate->frames_alloc, locate->frames_count, sizeof(*frames), YAML_PATH_LOCATE_FRAMES_MIN_ALLOC);
+	if (frames == NULL)
+		return -1;
+	locate->frames = frames;
+	yaml_path_locate_frame_t *frame = &locate->frames[locate->frames_count++];
+	frame->mapping = mapping;
+	frame->children = 0;
+	frame->key = NULL;
+	return 0;
+}
+
+static int
+yaml_path_locate_event (yaml_path_locate_t *locate, const yaml_event_t *event)
+{
+	switch (event->type) {
+	case YAML_SCALAR_EVENT:
+	case YAML_ALIAS_EVENT:
+		yaml_path_locate_resolve(locate, &event->start_mark, event, &event->start_mark);
+		yaml_path_locate_resolve(locate, &event->end_mark, event, NULL);
+		return yaml_path_locate_child_done(locate, event);
+	case YAML_SEQUENCE_START_EVENT:
+	case YAML_MAPPING_START_EVENT:
+		yaml_path_locate_resolve(locate, &event->start_mark, event, &event->start_mark);
+		return yaml_path_locate_frame_push(locate, event->type == YAML_MAPPING_START_EVENT);
+	case YAML_SEQUENCE_END_EVENT:
+	case YAML_MAPPING_END_EVENT:
+		if (event->start_mark.index == event->end_mark.index) {
+			// Block collections end at the next token, the rest of its
+			// line belongs to the node following them
+			yaml_mark_t mark = event->start_mark;
+			mark.index -= mark.column;
+			mark.column = 0;
+			yaml_path_locate_resolve(locate, &mark, NULL, NULL);
+		} else {
+			yaml_path_locate_resolve(locate, &event->end_mark, NULL, NULL);
+		}
+		if (locate->frames_count) {
+			free(locate->frames[--locate->frames_count].key);
+			return yaml_path_locate_child_done(locate, event);
+		}
+		return 0;
+	case YAML_DOCUMENT_END_EVENT:
+		yaml_path_locate_resolve(locate, &event->end_mark, NULL, NULL);
+		locate->document++;
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+
+/* Public API -------------------------------------------------------------- */
+
+int
+yaml_path_locate (yaml_parser_t *parser, yaml_path_location_t *locations, size_t count)
+{
+	if (parser == NULL || (locations == NULL && count))
+		return -1;
+	for (size_t i = 0; i < count; i++) {
+		if (locations[i].path == NULL || !locations[i].path_size)
+			return -1;
+	}
+
+	yaml_path_locate_t locate;
+	memset(&locate, 0, sizeof(locate));
+	if (count && (locate.by_index = malloc(count * 2 * sizeof(*locate.by_index))) == NULL)
+		return -2;
+	locate.by_line = locate.by_index + count;
+	for (size_t i = 0; i < count; i++) {
+		locations[i].path[0] = '\0';
+		locations[i].path_length = 0;
+		if (locations[i].by_line)
+			locate.by_line[locate.by_line_count++] = &locations[i];
+		else
+			locate.by_index[locate.by_index_count++] = &locations[i];
+	}
+	qsort(locate.by_index, locate.by_index_count, sizeof(*locate.by_index), yaml_path_locate_cmp_index);
+	qsort(locate.by_line, locate.by_line_count, sizeof(*locate.by_line), yaml_path_locate_cmp_line);
+
+	int res = 0;
+	while (locate.by_index_pos < locate.by_index_count || locate.by_line_pos < locate.by_line_count) {
+		yaml_event_t event;
+		if (!yaml_parser_parse(parser, &event)) {
+			res = -2;
+			break;
+		}
+		bool end = event.type == YAML_STREAM_END_EVENT;
+		if (yaml_path_locate_event(&locate, &event))
+			res = -2;
+		yaml_event_delete(&event);
+		if (end || res)
+			break;
+	}
+
+	while (locate.frames_count)
+		free(locate.frames[--locate.frames_count].key);
+	free(locate.frames);
+	free(locate.by_index);
+	return res;
+}
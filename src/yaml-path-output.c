@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <yaml.h>
+
+#include "yaml-path.h"
+#include "yaml-path-private.h"
+
+
+// Data is written in buffers of this size, the producer waits once all
+// of them are full
+#define YAML_PATH_OUTPUT_BUFFERS       4
+#define YAML_PATH_OUTPUT_BUFFER_SIZE   (256 * 1024)
+
+
+struct yaml_path_output {
+	int fd;
+
+	yaml_path_ring_t ring;
+	unsigned char *buffer; // Buffer being filled
+	size_t buffer_used;
+	pthread_t thread;
+	bool flushed;
+
+	// Set by the thread before it stops the ring
+	yaml_path_error_t error;
+	int error_errno;
+	size_t offset; // Bytes written so far
+};
+
+
+static void*
+yaml_path_output_thread (void *data)
+{
+	yaml_path_output_t *output = data;
+	const unsigned char *buffer;
+	size_t size;
+	while ((buffer = yaml_path_ring_consume_get(&output->ring, &size)) != NULL) {
+		size_t written = 0;
+		while (written < size) {
+			ssize_t len = write(output->fd, buffer + written, size - written);
+			if (len < 0 && errno == EINTR)
+				continue;
+			if (len <= 0) {
+				output->error.type = YAML_PATH_ERROR_OUTPUT;
+				output->error.message = "Unable to write the output";
+				output->error.pos = output->offset;
+				output->error_errno = len < 0 ? errno : EIO;
+				// The producer gets no more buffers
+				yaml_path_ring_stop(&output->ring);
+				return NULL;
+			}
+			written += len;
+			output->offset += len;
+		}
+		yaml_path_ring_consume_put(&output->ring);
+	}
+	return NULL;
+}
+
+static int
+yaml_path_output_write_handler (void *data, unsigned char *buffer, size_t size)
+{
+	return !yaml_path_output_write(data, buffer, size);
+}
+
+
+/* Public API -------------------------------------------------------------- */
+
+yaml_path_output_t*
+yaml_path_output_open (int fd)
+{
+	if (fd < 0)
+		return NULL;
+
+	yaml_path_output_t *output = malloc(sizeof(*output));
+	if (output == NULL)
+		return NULL;
+	memset(output, 0, sizeof(*output));
+	output->fd = fd;
+
+	if (yaml_path_ring_init(&output->ring, YAML_PATH_OUTPUT_BUFFERS, YAML_PATH_OUTPUT_BUFFER_SIZE)) {
+		free(output);
+		return NULL;
+	}
+	if (pthread_create(&output->thread, NULL, yaml_path_output_thread, output)) {
+		yaml_path_ring_destroy(&output->ring);
+		free(output);
+		return NULL;
+	}
+	return output;
+}
+
+int
+yaml_path_output_write (yaml_path_output_t *output, const unsigned char *data, size_t size)
+{
+	if (output == NULL || (data == NULL && size))
+		return -1;
+	if (output->flushed)
+		return -2;
+
+	while (size) {
+		if (output->buffer == NULL) {
+			output->buffer = yaml_path_ring_produce_get(&output->ring);
+			output->buffer_used = 0;
+			if (output->buffer == NULL)
+				return -2;
+		}
+		size_t len = YAML_PATH_OUTPUT_BUFFER_SIZE - output->buffer_used;
+		if (len > size)
+			len = size;
+		memcpy(output->buffer + output->buffer_used, data, len);
+		output->buffer_used += len;
+		data += len;
+		size -= len;
+		if (output->buffer_used == YAML_PATH_OUTPUT_BUFFER_SIZE) {
+			yaml_path_ring_produce_put(&output->ring, output->buffer_used);
+			output->buffer = NULL;
+		}
+	}
+	return 0;
+}
+
+int
+yaml_path_output_set_emitter (yaml_path_output_t *output, yaml_emitter_t *emitter)
+{
+	if (output == NULL || emitter == NULL)
+		return -1;
+	yaml_emitter_set_output(emitter, yaml_path_output_write_handler, output);
+	return 0;
+}
+
+int
+yaml_path_output_flush (yaml_path_output_t *output)
+{
+	if (output == NULL)
+		return -1;
+	if (!output->flushed) {
+		if (output->buffer != NULL)
+			yaml_path_ring_produce_put(&output->ring, output->buffer_used);
+		output->buffer = NULL;
+		yaml_path_ring_end(&output->ring);
+		pthread_join(output->thread, NULL);
+		output->flushed = true;
+	}
+	if (output->error.type != YAML_PATH_ERROR_NONE) {
+		errno = output->error_errno;
+		return -2;
+	}
+	return 0;
+}
+
+void
+yaml_path_output_close (yaml_path_output_t *output)
+{
+	if (output == NULL)
+		return;
+	yaml_path_output_flush(output);
+	yaml_path_ring_destroy(&output->ring);
+	free(output);
+}
+
+const yaml_path_error_t*
+yaml_path_output_error_get (yaml_path_output_t *output)
+{
+	if (output == NULL)
+		return NULL;
+	return &output->error;
+}
@@ -0,0 +1,67 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "yaml-path.h"
+
+
+// Only the keys of the first segments are looked for in longer paths
+#define YAML_PATH_PREFILTER_MAX_KEYS    64
+
+
+// Keys are looked for as they are, so the ones that could be written in a
+// different way (quoted, or folded over lines) can't be used
+static bool
+yaml_path_prefilter_key_usable (const char *key)
+{
+	if (!*key)
+		return false;
+	for (const unsigned char *c = (const unsigned char *)key; *c; c++)
+		if (*c <= ' ' || *c == '\'' || *c == '"' || *c == '\\' || *c == 0x7f)
+			return false;
+	// Unicode line breaks (NEL, LS, PS)
+	return strstr(key, "\xc2\x85") == NULL && strstr(key, "\xe2\x80\xa8") == NULL && strstr(key, "\xe2\x80\xa9") == NULL;
+}
+
+// Characters of double-quoted scalars might be escaped (\x41, \u0041, \/),
+// or the scalars might continue on the next line after an escaped break
+static bool
+yaml_path_prefilter_has_escapes (const unsigned char *input, size_t size)
+{
+	const unsigned char *end = input + size;
+	const unsigned char *c = input;
+	while ((c = memchr(c, '\\', end - c)) != NULL && c + 1 < end) {
+		if (c[1] && strchr("xuUNLP_/\r\n", c[1]) != NULL)
+			return true;
+		c += c[1] == '\\' ? 2 : 1;
+	}
+	return false;
+}
+
+
+/* Public API -------------------------------------------------------------- */
+
+int
+yaml_path_prefilter (yaml_path_t *path, const unsigned char *input, size_t size)
+{
+	if (path == NULL || (input == NULL && size))
+		return -1;
+
+	// Input in UTF-16 (recognized by libyaml by its BOM)
+	if (size >= 2 && ((input[0] == 0xff && input[1] == 0xfe) || (input[0] == 0xfe && input[1] == 0xff)))
+		return 1;
+
+	const char *keys[YAML_PATH_PREFILTER_MAX_KEYS];
+	size_t count = yaml_path_required_keys_get(path, keys, YAML_PATH_PREFILTER_MAX_KEYS);
+	if (count > YAML_PATH_PREFILTER_MAX_KEYS)
+		count = YAML_PATH_PREFILTER_MAX_KEYS;
+
+	// Keys of the deeper segments are less common, so they go first
+	for (size_t i = count; i-- > 0;) {
+		if (!yaml_path_prefilter_key_usable(keys[i]))
+			continue;
+		// The vectorized memmem() of the C library does the scanning
+		if (size == 0 || memmem(input, size, keys[i], strlen(keys[i])) == NULL)
+			return yaml_path_prefilter_has_escapes(input, size) ? 1 : 0;
+	}
+	return 1;
+}
@@ -0,0 +1,244 @@
+#ifndef YAML_PATH_PRIVATE_H
+#define YAML_PATH_PRIVATE_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "yaml-path.h"
+
+
+// A leading segment of the path addressing exactly one node
+typedef struct yaml_path_step {
+	const char *key; // NULL for sequence indices
+	size_t index;
+} yaml_path_step_t;
+
+// Buffers passed from one thread (producer) to another (consumer) in order,
+// the producer waits while all of them are in use
+typedef struct yaml_path_ring {
+	unsigned char *data;
+	size_t *sizes;
+	size_t count;
+	size_t buffer_size;
+	size_t head; // First buffer filled by the producer
+	size_t used;
+	bool end;    // No more buffers are produced
+	bool stop;   // No more buffers are consumed
+
+	pthread_mutex_t lock;
+	pthread_cond_t filled;
+	pthread_cond_t drained;
+} yaml_path_ring_t;
+
+// Large block scalar whose body is replaced by a placeholder line in the
+// parser input
+typedef struct yaml_path_block {
+	size_t start; // Body in the input (the lines following the header)
+	size_t end;
+	size_t chars; // Characters before the body (as counted by the marks)
+	size_t indent;
+	size_t increment; // Explicit indentation indicator
+	int chomping;     // -1 strip, 0 clip, 1 keep
+	bool folded;
+	size_t placeholder; // Size of the placeholder line
+} yaml_path_block_t;
+
+typedef struct yaml_path_blocks {
+	const unsigned char *input;
+	size_t size;
+	yaml_path_block_t *items;
+	size_t count;
+	size_t alloc;
+
+	// Read handler state
+	size_t pos;
+	size_t read; // Placeholders passed to the parser
+	char *placeholder;
+	size_t placeholder_size;
+	size_t placeholder_pos;
+	size_t placeholder_alloc;
+
+	// Placeholders found in the events, marks are moved by the differences
+	size_t seen;
+	size_t chars;
+	size_t lines;
+	size_t placeholder_chars;
+
+	char *chunk;
+} yaml_path_blocks_t;
+
+typedef enum yaml_path_scalar_type {
+	YAML_PATH_SCALAR_NULL,
+	YAML_PATH_SCALAR_BOOL,
+	YAML_PATH_SCALAR_INT,
+	YAML_PATH_SCALAR_FLOAT,
+	YAML_PATH_SCALAR_STR,
+} yaml_path_scalar_type_t;
+
+typedef struct yaml_path_scalar {
+	yaml_path_scalar_type_t type;
+	bool b;
+	int64_t i;
+	double d;
+} yaml_path_scalar_t;
+
+// Decoded pieces of a block scalar (NUL-terminated), it should return 1 on
+// success and 0 on failure
+typedef int yaml_path_blocks_handler_t (void *data, const char *chunk, size_t size, bool last);
+
+
+// Make room for one more item of the array, doubling it from `min_alloc`
+// items; the array is returned (NULL if memory runs out, the old one is kept)
+void*
+yaml_path_grow (void *array, size_t *alloc, size_t count, size_t item_size, size_t min_alloc);
+
+// Allocate from the blocks of an arena, which are freed at once
+void*
+yaml_path_arena_alloc (yaml_path_arena_block_t **blocks, size_t size, size_t align);
+
+// Free the blocks, the latest (largest) one is kept empty if `keep` is set
+void
+yaml_path_arena_free (yaml_path_arena_block_t **blocks, bool keep);
+
+// Key segment of a path (as printed by yaml_path_snprint())
+size_t
+yaml_path_key_snprint (const char *key, char *s, size_t max_len);
+
+// Get leading key/index segments following the document root
+size_t
+yaml_path_steps_get (yaml_path_t *path, yaml_path_step_t *steps, size_t max_count);
+
+// Treat root nodes of input documents as the nodes addressed by the first
+// `count` steps (used when the parser input starts inside a document), only
+// in the next stream filtered by the path
+void
+yaml_path_steps_skip (yaml_path_t *path, size_t count);
+
+// Whether the section following the leading `count` steps selects all items
+// of a sequence ([:])
+bool
+yaml_path_steps_next_is_all (yaml_path_t *path, size_t count);
+
+// Whether a match or value handler is set
+bool
+yaml_path_handlers_set (yaml_path_t *path);
+
+// Whether the path selects only some documents of the stream
+bool
+yaml_path_documents_selective (yaml_path_t *path);
+
+// Index of the next selected document that has not been filtered yet,
+// SIZE_MAX if there is none
+size_t
+yaml_path_documents_next (yaml_path_t *path);
+
+// Set the index of the next document passed to the filter (used when
+// documents are skipped without parsing)
+void
+yaml_path_documents_seek (yaml_path_t *path, size_t index);
+
+bool
+yaml_path_node_handler_is_set (yaml_path_t *path);
+
+void
+yaml_path_match_handler_get (yaml_path_t *path, yaml_path_match_handler_t **handler, void **data);
+
+// Byte offset of a character index of the input, indices come in order
+typedef size_t yaml_path_offset_handler_t (void *data, size_t index);
+
+// The handler gives the byte offsets of the matches (they are SIZE_MAX
+// without it)
+void
+yaml_path_set_offset_handler (yaml_path_t *path, yaml_path_offset_handler_t *handler, void *data);
+
+void
+yaml_path_value_handler_get (yaml_path_t *path, yaml_path_value_handler_t **handler, void **data);
+
+// Number of matched nodes found since the match handler was set (nodes are
+// counted once they start)
+size_t
+yaml_path_matches_get (yaml_path_t *path);
+
+// Serialize the compiled path into a position-independent record, the size
+// of the record is returned (nothing is written if it doesn't fit)
+size_t
+yaml_path_record_write (yaml_path_t *path, unsigned char *buffer, size_t size);
+
+// Restore the compiled path from the record (8-byte aligned) without parsing
+int
+yaml_path_record_read (yaml_path_t *path, const unsigned char *record, size_t size);
+
+int
+yaml_path_ring_init (yaml_path_ring_t *ring, size_t count, size_t buffer_size);
+
+void
+yaml_path_ring_destroy (yaml_path_ring_t *ring);
+
+// Free buffer for the producer, NULL once the ring is stopped
+unsigned char*
+yaml_path_ring_produce_get (yaml_path_ring_t *ring);
+
+// Pass `size` bytes of the buffer to the consumer (empty buffers are kept)
+void
+yaml_path_ring_produce_put (yaml_path_ring_t *ring, size_t size);
+
+void
+yaml_path_ring_end (yaml_path_ring_t *ring);
+
+// Next filled buffer for the consumer, NULL once the ring has ended and all
+// the buffers are consumed
+const unsigned char*
+yaml_path_ring_consume_get (yaml_path_ring_t *ring, size_t *size);
+
+// Return the buffer to the producer
+void
+yaml_path_ring_consume_put (yaml_path_ring_t *ring);
+
+void
+yaml_path_ring_stop (yaml_path_ring_t *ring);
+
+// Resolve the scalar with the YAML core schema (explicit tags of the schema
+// are respected, quoted scalars without them and the ones with the
+// non-specific tag `!` are strings)
+void
+yaml_path_scalar_resolve (const yaml_path_value_t *value, yaml_path_scalar_t *scalar);
+
+// Find block scalars of at least `min_size` bytes in the raw input (only
+// the bodies following a header line of a common layout are found)
+int
+yaml_path_blocks_scan (yaml_path_blocks_t *blocks, const unsigned char *input, size_t size, size_t min_size);
+
+void
+yaml_path_blocks_delete (yaml_path_blocks_t *blocks);
+
+// The parser reads the input with the bodies replaced by placeholders
+void
+yaml_path_blocks_set_parser (yaml_path_blocks_t *blocks, yaml_parser_t *parser);
+
+// Move the mark of the parser input to the original input
+void
+yaml_path_blocks_mark (yaml_path_blocks_t *blocks, yaml_mark_t *mark);
+
+// Whether the mark of the parser input is behind the body of the next
+// placeholder that wasn't found in the events
+bool
+yaml_path_blocks_passed (yaml_path_blocks_t *blocks, const yaml_mark_t *mark);
+
+// Fix the marks of the event, `idx` is set to the index of the scalar if it
+// is a placeholder (SIZE_MAX otherwise); -1 is returned if the event passes
+// the next placeholder without being its scalar (the input was parsed
+// differently than scanned, the events before are the same as without the
+// placeholders)
+int
+yaml_path_blocks_event (yaml_path_blocks_t *blocks, yaml_event_t *event, size_t *idx);
+
+// Whether all the placeholders were found in the events
+bool
+yaml_path_blocks_done (yaml_path_blocks_t *blocks);
+
+// Decode the value of the scalar from the input in pieces, -2 is returned
+// if the handler fails
+int
+yaml_path_blocks_decode (yaml_path_blocks_t *blocks, size_t idx, yaml_path_blocks_handler_t *handler, void *data);
+
+#endif//YAML_PATH_PRIVATE_H
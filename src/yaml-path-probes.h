@@ -0,0 +1,20 @@
+#ifndef YAML_PATH_PROBES_H
+#define YAML_PATH_PROBES_H
+
+// Static tracepoints (USDT) of the `yaml_path` provider, they are built
+// with the ENABLE_USDT CMake option only (it defines YAML_PATH_USDT); a
+// probe nobody is attached to is a single nop instruction, arguments are
+// read by the tracer
+#ifdef YAML_PATH_USDT
+#include <sys/sdt.h>
+
+#define YAML_PATH_PROBE1(name, a)       DTRACE_PROBE1(yaml_path, name, a)
+#define YAML_PATH_PROBE2(name, a, b)    DTRACE_PROBE2(yaml_path, name, a, b)
+#define YAML_PATH_PROBE3(name, a, b, c) DTRACE_PROBE3(yaml_path, name, a, b, c)
+#else
+#define YAML_PATH_PROBE1(name, a)       do {} while (0)
+#define YAML_PATH_PROBE2(name, a, b)    do {} while (0)
+#define YAML_PATH_PROBE3(name, a, b, c) do {} while (0)
+#endif
+
+#endif//YAML_PATH_PROBES_H
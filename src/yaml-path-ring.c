@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "yaml-path-private.h"
+
+
+int
+yaml_path_ring_init (yaml_path_ring_t *ring, size_t count, size_t buffer_size)
+{
+	assert(ring != NULL && count > 0);
+	memset(ring, 0, sizeof(*ring));
+	ring->data = malloc(count * buffer_size);
+	ring->sizes = malloc(count * sizeof(*ring->sizes));
+	if (ring->data == NULL || ring->sizes == NULL) {
+		free(ring->data);
+		free(ring->sizes);
+		return -1;
+	}
+	ring->count = count;
+	ring->buffer_size = buffer_size;
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_cond_init(&ring->filled, NULL);
+	pthread_cond_init(&ring->drained, NULL);
+	return 0;
+}
+
+void
+yaml_path_ring_destroy (yaml_path_ring_t *ring)
+{
+	if (ring == NULL || ring->data == NULL)
+		return;
+	pthread_cond_destroy(&ring->drained);
+	pthread_cond_destroy(&ring->filled);
+	pthread_mutex_destroy(&ring->lock);
+	free(ring->data);
+	free(ring->sizes);
+	memset(ring, 0, sizeof(*ring));
+}
+
+unsigned char*
+yaml_path_ring_produce_get (yaml_path_ring_t *ring)
+{
+	pthread_mutex_lock(&ring->lock);
+	while (ring->used == ring->count && !ring->stop)
+		pthread_cond_wait(&ring->drained, &ring->lock);
+	unsigned char *buffer = NULL;
+	if (!ring->stop)
+		buffer = ring->data + (ring->head + ring->used) % ring->count * ring->buffer_size;
+	pthread_mutex_unlock(&ring->lock);
+	return buffer;
+}
+
+void
+yaml_path_ring_produce_put (yaml_path_ring_t *ring, size_t size)
+{
+	assert(size <= ring->buffer_size);
+	if (!size)
+		return;
+	pthread_mutex_lock(&ring->lock);
+	ring->sizes[(ring->head + ring->used) % ring->count] = size;
+	ring->used++;
+	pthread_cond_signal(&ring->filled);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+void
+yaml_path_ring_end (yaml_path_ring_t *ring)
+{
+	pthread_mutex_lock(&ring->lock);
+	ring->end = true;
+	pthread_cond_signal(&ring->filled);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+const unsigned char*
+yaml_path_ring_consume_get (yaml_path_ring_t *ring, size_t *size)
+{
+	pthread_mutex_lock(&ring->lock);
+	while (!ring->used && !ring->end)
+		pthread_cond_wait(&ring->filled, &ring->lock);
+	const unsigned char *buffer = NULL;
+	if (ring->used) {
+		buffer = ring->data + ring->head * ring->buffer_size;
+		*size = ring->sizes[ring->head];
+	}
+	pthread_mutex_unlock(&ring->lock);
+	return buffer;
+}
+
+void
+yaml_path_ring_consume_put (yaml_path_ring_t *ring)
+{
+	pthread_mutex_lock(&ring->lock);
+	assert(ring->used);
+	ring->head = (ring->head + 1) % ring->count;
+	ring->used--;
+	pthread_cond_signal(&ring->drained);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+void
+yaml_path_ring_stop (yaml_path_ring_t *ring)
+{
+	pthread_mutex_lock(&ring->lock);
+	ring->stop = true;
+	pthread_cond_signal(&ring->drained);
+	pthread_mutex_unlock(&ring->lock);
+}
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "yaml-path.h"
+#include "yaml-path-private.h"
+
+
+// Other keys of a mapping are merged together
+#define YAML_PATH_SHAPE_MAX_KEYS            256
+#define YAML_PATH_SHAPE_FRAMES_MIN_ALLOC    16
+
+
+struct yaml_path_shape_frame {
+	yaml_path_shape_node_t *node; // NULL below the described levels
+	bool mapping;
+	size_t children; // Keys and values, or items completed so far
+	yaml_path_shape_node_t *value; // Place of the value of the last key
+};
+
+
+static yaml_path_shape_node_t*
+yaml_path_shape_node_create (const char *key)
+{
+	yaml_path_shape_node_t *node = calloc(1, sizeof(*node));
+	if (node != NULL && key != NULL && (node->key = strdup(key)) == NULL) {
+		free(node);
+		return NULL;
+	}
+	return node;
+}
+
+static void
+yaml_path_shape_node_destroy (yaml_path_shape_node_t *node)
+{
+	if (node == NULL)
+		return;
+	while (node->keys != NULL) {
+		yaml_path_shape_node_t *child = node->keys;
+		node->keys = child->next;
+		yaml_path_shape_node_destroy(child);
+	}
+	yaml_path_shape_node_destroy(node->other);
+	yaml_path_shape_node_destroy(node->item);
+	free((void *)node->key);
+	free(node);
+}
+
+// Mappings of the same place tend to have their keys in the same order, so
+// the key following the previous one is tried first
+static yaml_path_shape_node_t*
+yaml_path_shape_key_get (yaml_path_shape_node_t *node, yaml_path_shape_node_t *prev, const char *key)
+{
+	if (prev != NULL && prev->next != NULL && !strcmp(prev->next->key, key))
+		return prev->next;
+	for (yaml_path_shape_node_t *child = node->keys; child != NULL; child = child->next) {
+		if (!strcmp(child->key, key))
+			return child;
+	}
+	if (node->keys_count >= YAML_PATH_SHAPE_MAX_KEYS) {
+		if (node->other == NULL)
+			node->other = yaml_path_shape_node_create(NULL);
+		return node->other;
+	}
+
+	yaml_path_shape_node_t *child = yaml_path_shape_node_create(key);
+	if (child == NULL)
+		return NULL;
+	if (node->keys_last != NULL)
+		node->keys_last->next = child;
+	else
+		node->keys = child;
+	node->keys_last = child;
+	node->keys_count++;
+	return child;
+}
+
+// Place of the node starting with the event, NULL if it isn't described
+// (keys, or nodes below the described levels); -1 is returned if there's
+// not enough memory
+static int
+yaml_path_shape_node_get (yaml_path_shape_t *shape, const yaml_event_t *event, size_t depth, yaml_path_shape_node_t **node)
+{
+	*node = NULL;
+	if (depth == 1) {
+		if (shape->root == NULL)
+			shape->root = yaml_path_shape_node_create(NULL);
+		*node = shape->root;
+		return *node != NULL ? 0 : -1;
+	}
+
+	yaml_path_shape_frame_t *parent = &shape->frames[depth - 2];
+	if (parent->node == NULL || (shape->max_depth && depth > shape->max_depth))
+		return 0;
+	if (!parent->mapping) {
+		if (parent->node->item == NULL)
+			parent->node->item = yaml_path_shape_node_create(NULL);
+		*node = parent->node->item;
+		return *node != NULL ? 0 : -1;
+	}
+	if (parent->children % 2) {
+		*node = parent->value;
+		return 0;
+	}
+
+	// Values of complex keys are merged with the other ones
+	if (event->type == YAML_SCALAR_EVENT) {
+		parent->value = yaml_path_shape_key_get(parent->node, parent->value, (const char *)event->data.scalar.value);
+	} else {
+		if (parent->node->other == NULL)
+			parent->node->other = yaml_path_shape_node_create(NULL);
+		parent->value = parent->node->other;
+	}
+	return parent->value != NULL ? 0 : -1;
+}
+
+static int
+yaml_path_shape_frame_push (yaml_path_shape_t *shape, yaml_path_shape_node_t *node, bool mapping)
+{
+	yaml_path_shape_frame_t *frames = yaml_path_grow(shape->frames, &shape->frames_alloc, shape->frames_count, sizeof(*frames), YAML_PATH_SHAPE_FRAMES_MIN_ALLOC);
+	if (frames == NULL)
+		return -1;
+	shape->frames = frames;
+	yaml_path_shape_frame_t *frame = &shape->frames[shape->frames_count++];
+	frame->node = node;
+	frame->mapping = mapping;
+	frame->children = 0;
+	frame->value = NULL;
+	return 0;
+}
+
+static int
+yaml_path_shape_emit_scalar (yaml_emitter_t *emitter, const char *value)
+{
+	yaml_event_t event;
+	if (!yaml_scalar_event_initialize(&event, NULL, NULL, (yaml_char_t *)value, strlen(value), 1, 1, YAML_ANY_SCALAR_STYLE))
+		return -2;
+	return yaml_emitter_emit(emitter, &event) ? 0 : -2;
+}
+
+static int
+yaml_path_shape_emit_count (yaml_emitter_t *emitter, const char *name, size_t count)
+{
+	if (!count)
+		return 0;
+	char value[32];
+	snprintf(value, sizeof(value), "%zu", count);
+	if (yaml_path_shape_emit_scalar(emitter, name))
+		return -2;
+	return yaml_path_shape_emit_scalar(emitter, value);
+}
+
+static int
+yaml_path_shape_emit_node (yaml_emitter_t *emitter, const yaml_path_shape_node_t *node, int flow)
+{
+	yaml_event_t event;
+	yaml_mapping_style_t style = flow ? YAML_FLOW_MAPPING_STYLE : YAML_ANY_MAPPING_STYLE;
+	if (!yaml_mapping_start_event_initialize(&event, NULL, NULL, 1, style) || !yaml_emitter_emit(emitter, &event))
+		return -2;
+	if (yaml_path_shape_emit_count(emitter, "mapping", node->mappings)
+	    || yaml_path_shape_emit_count(emitter, "pairs", node->pairs)
+	    || yaml_path_shape_emit_count(emitter, "sequence", node->sequences)
+	    || yaml_path_shape_emit_count(emitter, "items", node->items)
+	    || yaml_path_shape_emit_count(emitter, "scalar", node->scalars)
+	    || yaml_path_shape_emit_count(emitter, "alias", node->aliases))
+		return -2;
+
+	if (node->keys != NULL) {
+		if (yaml_path_shape_emit_scalar(emitter, "keys"))
+			return -2;
+		if (!yaml_mapping_start_event_initialize(&event, NULL, NULL, 1, style) || !yaml_emitter_emit(emitter, &event))
+			return -2;
+		for (const yaml_path_shape_node_t *child = node->keys; child != NULL; child = child->next) {
+			if (yaml_path_shape_emit_scalar(emitter, child->key) || yaml_path_shape_emit_node(emitter, child, flow))
+				return -2;
+		}
+		if (!yaml_mapping_end_event_initialize(&event) || !yaml_emitter_emit(emitter, &event))
+			return -2;
+	}
+	if (node->other != NULL && (yaml_path_shape_emit_scalar(emitter, "other") || yaml_path_shape_emit_node(emitter, node->other, flow)))
+		return -2;
+	if (node->item != NULL && (yaml_path_shape_emit_scalar(emitter, "item") || yaml_path_shape_emit_node(emitter, node->item, flow)))
+		return -2;
+
+	if (!yaml_mapping_end_event_initialize(&event) || !yaml_emitter_emit(emitter, &event))
+		return -2;
+	return 0;
+}
+
+
+/* Public API -------------------------------------------------------------- */
+
+void
+yaml_path_shape_init (yaml_path_shape_t *shape, size_t max_depth)
+{
+	if (shape == NULL)
+		return;
+	memset(shape, 0, sizeof(*shape));
+	shape->max_depth = max_depth;
+}
+
+void
+yaml_path_shape_delete (yaml_path_shape_t *shape)
+{
+	if (shape == NULL)
+		return;
+	yaml_path_shape_node_destroy(shape->root);
+	free(shape->frames);
+	yaml_path_shape_init(shape, shape->max_depth);
+}
+
+void
+yaml_path_shape_node_handler (void *data, const yaml_event_t *event, size_t depth)
+{
+	yaml_path_shape_t *shape = data;
+	if (shape == NULL || event == NULL || !depth)
+		return;
+
+	bool end = event->type == YAML_MAPPING_END_EVENT || event->type == YAML_SEQUENCE_END_EVENT;
+	if (depth == 1 && !end)
+		shape->frames_count = 0;
+	if (end) {
+		// Skipped after an error
+		if (depth != shape->frames_count)
+			return;
+		yaml_path_shape_frame_t *frame = &shape->frames[--shape->frames_count];
+		if (frame->node != NULL) {
+			if (frame->mapping)
+				frame->node->pairs += frame->children / 2;
+			else
+				frame->node->items += frame->children;
+		}
+	} else {
+		if (depth != shape->frames_count + 1)
+			return;
+		yaml_path_shape_node_t *node;
+		if (yaml_path_shape_node_get(shape, event, depth, &node))
+			goto error;
+		switch (event->type) {
+		case YAML_MAPPING_START_EVENT:
+		case YAML_SEQUENCE_START_EVENT: {
+				bool mapping = event->type == YAML_MAPPING_START_EVENT;
+				if (node != NULL) {
+					if (mapping)
+						node->mappings++;
+					else
+						node->sequences++;
+				}
+				if (yaml_path_shape_frame_push(shape, node, mapping))
+					goto error;
+			}
+			return;
+		case YAML_SCALAR_EVENT:
+			if (node != NULL)
+				node->scalars++;
+			break;
+		case YAML_ALIAS_EVENT:
+			if (node != NULL)
+				node->aliases++;
+			break;
+		default:
+			return;
+		}
+	}
+
+	// The node is complete
+	if (depth > 1)
+		shape->frames[depth - 2].children++;
+	return;
+
+error:
+	shape->error = 1;
+	shape->frames_count = 0;
+}
+
+int
+yaml_path_shape_emit (yaml_path_shape_t *shape, yaml_emitter_t *emitter, int flow)
+{
+	if (shape == NULL || emitter == NULL)
+		return -1;
+
+	yaml_path_shape_node_t empty;
+	memset(&empty, 0, sizeof(empty));
+	yaml_event_t event;
+	if (!yaml_stream_start_event_initialize(&event, YAML_UTF8_ENCODING) || !yaml_emitter_emit(emitter, &event))
+		return -2;
+	if (!yaml_document_start_event_initialize(&event, NULL, NULL, NULL, 1) || !yaml_emitter_emit(emitter, &event))
+		return -2;
+	if (yaml_path_shape_emit_node(emitter, shape->root != NULL ? shape->root : &empty, flow))
+		return -2;
+	if (!yaml_document_end_event_initialize(&event, 1) || !yaml_emitter_emit(emitter, &event))
+		return -2;
+	if (!yaml_stream_end_event_initialize(&event) || !yaml_emitter_emit(emitter, &event))
+		return -2;
+	return 0;
+}
@@ -0,0 +1,330 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "yaml-path.h"
+#include "yaml-path-private.h"
+
+
+#define YAML_PATH_COLUMN_MIN_ALLOC     256
+#define YAML_PATH_VALUES_MIN_ALLOC     16
+
+
+static char*
+yaml_path_values_alloc (yaml_path_values_t *values, size_t size)
+{
+	assert(values != NULL);
+	if (values->buffer != NULL && values->buffer_size - values->buffer_used >= size) {
+		char *ptr = values->buffer + values->buffer_used;
+		values->buffer_used += size;
+		return ptr;
+	}
+	return yaml_path_arena_alloc(&values->blocks, size, 1);
+}
+
+static const char*
+yaml_path_values_copy (yaml_path_values_t *values, const char *s, size_t len)
+{
+	char *copy = yaml_path_values_alloc(values, len + 1);
+	if (copy != NULL) {
+		memcpy(copy, s, len);
+		copy[len] = '\0';
+	}
+	return copy;
+}
+
+static bool
+yaml_path_scalar_is (const char *s, size_t len, const char * const *words)
+{
+	for (; *words != NULL; words++) {
+		if (strlen(*words) == len && !memcmp(s, *words, len))
+			return true;
+	}
+	return false;
+}
+
+static bool
+yaml_path_scalar_int (const char *s, size_t len, int64_t *i)
+{
+	unsigned base = 10;
+	bool negative = false;
+	if (len > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'o')) {
+		// Hexadecimal and octal integers have no sign
+		base = s[1] == 'x' ? 16 : 8;
+		s += 2;
+		len -= 2;
+	} else if (len && (s[0] == '-' || s[0] == '+')) {
+		negative = s[0] == '-';
+		s++;
+		len--;
+	}
+	if (!len)
+		return false;
+
+	uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+	uint64_t n = 0;
+	for (size_t k = 0; k < len; k++) {
+		unsigned digit;
+		if (s[k] >= '0' && s[k] <= '9')
+			digit = s[k] - '0';
+		else if (base == 16 && s[k] >= 'a' && s[k] <= 'f')
+			digit = s[k] - 'a' + 10;
+		else if (base == 16 && s[k] >= 'A' && s[k] <= 'F')
+			digit = s[k] - 'A' + 10;
+		else
+			return false;
+		if (digit >= base || n > (limit - digit) / base)
+			return false;
+		n = n * base + digit;
+	}
+	*i = negative ? (int64_t)(0 - n) : (int64_t)n;
+	return true;
+}
+
+static bool
+yaml_path_scalar_float (const char *s, size_t len, double *d)
+{
+	static const char * const inf[] = {".inf", ".Inf", ".INF", NULL};
+	static const char * const nan[] = {".nan", ".NaN", ".NAN", NULL};
+	const char *p = s, *end = s + len;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	if (yaml_path_scalar_is(p, end - p, inf)) {
+		*d = negative ? -HUGE_VAL : HUGE_VAL;
+		return true;
+	}
+	if (p == s && yaml_path_scalar_is(p, end - p, nan)) {
+		*d = NAN;
+		return true;
+	}
+
+	// [-+]?(\.[0-9]+|[0-9]+(\.[0-9]*)?)([eE][-+]?[0-9]+)?
+	size_t digits = 0;
+	while (p < end && *p >= '0' && *p <= '9')
+		p++, digits++;
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && *p >= '0' && *p <= '9')
+			p++, digits++;
+	}
+	if (!digits)
+		return false;
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		if (p < end && (*p == '-' || *p == '+'))
+			p++;
+		if (p == end)
+			return false;
+		while (p < end && *p >= '0' && *p <= '9')
+			p++;
+	}
+	if (p != end)
+		return false;
+	// Values are NUL-terminated
+	*d = strtod(s, NULL);
+	return true;
+}
+
+static int
+yaml_path_column_grow (yaml_path_column_t *column)
+{
+	size_t alloc = column->alloc ? column->alloc * 2 : YAML_PATH_COLUMN_MIN_ALLOC;
+	size_t bytes = (alloc + 7) / 8, old_bytes = (column->alloc + 7) / 8;
+
+	uint8_t *validity = realloc(column->validity, bytes);
+	if (validity == NULL)
+		return -1;
+	memset(validity + old_bytes, 0, bytes - old_bytes);
+	column->validity = validity;
+
+	if (column->type == YAML_PATH_COLUMN_BOOL) {
+		uint8_t *bools = realloc(column->data.bools, bytes);
+		if (bools == NULL)
+			return -1;
+		memset(bools + old_bytes, 0, bytes - old_bytes);
+		column->data.bools = bools;
+	} else {
+		// Both int64_t and double are 8 bytes
+		void *data = realloc(column->data.ints, alloc * sizeof(int64_t));
+		if (data == NULL)
+			return -1;
+		column->data.ints = data;
+	}
+	column->alloc = alloc;
+	return 0;
+}
+
+
+/* Private API ------------------------------------------------------------- */
+
+void
+yaml_path_scalar_resolve (const yaml_path_value_t *value, yaml_path_scalar_t *scalar)
+{
+	static const char * const nulls[] = {"", "~", "null", "Null", "NULL", NULL};
+	static const char * const trues[] = {"true", "True", "TRUE", NULL};
+	static const char * const falses[] = {"false", "False", "FALSE", NULL};
+	const char *s = value->value;
+	size_t len = value->length;
+	const char *tag = value->tag;
+
+	// The non-specific tag (`! 5`) makes any scalar a string
+	scalar->type = YAML_PATH_SCALAR_STR;
+	if ((tag == NULL && value->style != YAML_PLAIN_SCALAR_STYLE) || (tag != NULL && !strcmp(tag, "!")))
+		return;
+
+	if ((tag == NULL || !strcmp(tag, YAML_NULL_TAG)) && yaml_path_scalar_is(s, len, nulls)) {
+		scalar->type = YAML_PATH_SCALAR_NULL;
+	} else if (tag == NULL || !strcmp(tag, YAML_BOOL_TAG)) {
+		if (yaml_path_scalar_is(s, len, trues) || yaml_path_scalar_is(s, len, falses)) {
+			scalar->type = YAML_PATH_SCALAR_BOOL;
+			scalar->b = yaml_path_scalar_is(s, len, trues);
+			return;
+		}
+	}
+	if (scalar->type != YAML_PATH_SCALAR_STR)
+		return;
+	if ((tag == NULL || !strcmp(tag, YAML_INT_TAG) || !strcmp(tag, YAML_FLOAT_TAG)) && yaml_path_scalar_int(s, len, &scalar->i)) {
+		scalar->type = YAML_PATH_SCALAR_INT;
+		scalar->d = (double)scalar->i;
+	} else if ((tag == NULL || !strcmp(tag, YAML_FLOAT_TAG)) && yaml_path_scalar_float(s, len, &scalar->d)) {
+		scalar->type = YAML_PATH_SCALAR_FLOAT;
+	}
+}
+
+
+/* Public API -------------------------------------------------------------- */
+
+void
+yaml_path_values_init (yaml_path_values_t *values, char *buffer, size_t size)
+{
+	if (values == NULL)
+		return;
+	memset(values, 0, sizeof(*values));
+	if (buffer != NULL) {
+		values->buffer = buffer;
+		values->buffer_size = size;
+	}
+}
+
+void
+yaml_path_values_clear (yaml_path_values_t *values)
+{
+	if (values == NULL)
+		return;
+	values->count = 0;
+	values->error = 0;
+	values->buffer_used = 0;
+
+	yaml_path_arena_free(&values->blocks, true);
+}
+
+void
+yaml_path_values_delete (yaml_path_values_t *values)
+{
+	if (values == NULL)
+		return;
+	yaml_path_arena_free(&values->blocks, false);
+	free(values->items);
+	memset(values, 0, sizeof(*values));
+}
+
+void
+yaml_path_values_handler (void *data, const yaml_path_value_t *value)
+{
+	yaml_path_values_t *values = data;
+	if (values == NULL || value == NULL || values->error)
+		return;
+
+	yaml_path_value_t *items = yaml_path_grow(values->items, &values->items_alloc, values->count, sizeof(*items), YAML_PATH_VALUES_MIN_ALLOC);
+	if (items == NULL) {
+		values->error = 1;
+		return;
+	}
+	values->items = items;
+
+	yaml_path_value_t *item = &values->items[values->count];
+	*item = *value;
+	item->value = yaml_path_values_copy(values, value->value, value->length);
+	if (value->tag != NULL)
+		item->tag = yaml_path_values_copy(values, value->tag, strlen(value->tag));
+	if (item->value == NULL || (value->tag != NULL && item->tag == NULL)) {
+		values->error = 1;
+		return;
+	}
+	values->count++;
+}
+
+void
+yaml_path_column_init (yaml_path_column_t *column, yaml_path_column_type_t type)
+{
+	if (column == NULL)
+		return;
+	memset(column, 0, sizeof(*column));
+	column->type = type;
+}
+
+void
+yaml_path_column_clear (yaml_path_column_t *column)
+{
+	if (column == NULL)
+		return;
+	size_t bytes = (column->alloc + 7) / 8;
+	if (column->validity != NULL)
+		memset(column->validity, 0, bytes);
+	if (column->type == YAML_PATH_COLUMN_BOOL && column->data.bools != NULL)
+		memset(column->data.bools, 0, bytes);
+	column->count = 0;
+	column->valid_count = 0;
+	column->error = 0;
+}
+
+void
+yaml_path_column_delete (yaml_path_column_t *column)
+{
+	if (column == NULL)
+		return;
+	free(column->data.ints);
+	free(column->validity);
+	memset(column, 0, sizeof(*column));
+}
+
+void
+yaml_path_column_handler (void *data, const yaml_path_value_t *value)
+{
+	yaml_path_column_t *column = data;
+	if (column == NULL || value == NULL || column->error)
+		return;
+	if (column->count == column->alloc && yaml_path_column_grow(column)) {
+		column->error = 1;
+		return;
+	}
+
+	yaml_path_scalar_t scalar;
+	yaml_path_scalar_resolve(value, &scalar);
+
+	size_t idx = column->count++;
+	bool valid = false;
+	switch (column->type) {
+	case YAML_PATH_COLUMN_INT64:
+		valid = scalar.type == YAML_PATH_SCALAR_INT;
+		column->data.ints[idx] = valid ? scalar.i : 0;
+		break;
+	case YAML_PATH_COLUMN_DOUBLE:
+		valid = scalar.type == YAML_PATH_SCALAR_INT || scalar.type == YAML_PATH_SCALAR_FLOAT;
+		column->data.doubles[idx] = valid ? scalar.d : 0.0;
+		break;
+	case YAML_PATH_COLUMN_BOOL:
+		valid = scalar.type == YAML_PATH_SCALAR_BOOL;
+		if (valid && scalar.b)
+			column->data.bools[idx / 8] |= 1 << idx % 8;
+		break;
+	}
+	if (valid) {
+		column->validity[idx / 8] |= 1 << idx % 8;
+		column->valid_count++;
+	}
+}
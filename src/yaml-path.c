@@ -1,15 +1,22 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <ctype.h>
 #include <string.h>
 #include <sys/queue.h>
+#include <regex.h>
 #include <assert.h>
 
 #include <yaml.h>
 
 #include "yaml-path.h"
+#include "yaml-path-private.h"
+#include "yaml-path-probes.h"
 
 
 #define YAML_PATH_MAX_SECTION_ITEMS    256
+#define YAML_PATH_ARENA_BLOCK_SIZE     4096
 
 #define _STR(x) #x
 #define STR(x) _STR(x)
@@ -22,8 +29,21 @@ typedef enum yaml_path_section_type {
 	YAML_PATH_SECTION_SET,
 	YAML_PATH_SECTION_KEY,
 	YAML_PATH_SECTION_SELECTION,
+	YAML_PATH_SECTION_REGEX,
 } yaml_path_section_type_t;
 
+typedef enum yaml_path_documents_type {
+	YAML_PATH_DOCUMENTS_ALL,
+	YAML_PATH_DOCUMENTS_SET,
+	YAML_PATH_DOCUMENTS_SLICE,
+} yaml_path_documents_type_t;
+
+typedef enum yaml_path_plan_type {
+	YAML_PATH_PLAN_GENERIC,
+	YAML_PATH_PLAN_KEYS,  // Key chain ($.a.b.c)
+	YAML_PATH_PLAN_STEPS, // Keys, indices and sets ($.a[:].b[0])
+} yaml_path_plan_type_t;
+
 typedef struct yaml_path_selection_key_raw {
 	const char *start;
 	size_t len;
@@ -37,6 +57,18 @@ typedef struct yaml_path_key {
 
 typedef TAILQ_HEAD(path_key_list, yaml_path_key) path_key_list_t;
 
+// Keys are checked against the literal prefix and suffix of an anchored
+// pattern first, the regular expression is not run if they are all of it
+typedef struct yaml_path_regex {
+	char *pattern;
+	regex_t re;
+	char *literals; // Prefix followed by the suffix
+	size_t prefix_len;
+	size_t suffix_len;
+	bool exact;   // The key equals the prefix
+	bool literal; // Nothing else to check
+} yaml_path_regex_t;
+
 
 typedef struct yaml_path_section {
 	yaml_path_section_type_t type;
@@ -47,6 +79,7 @@ typedef struct yaml_path_section {
 		size_t *set;
 		const char *key;
 		path_key_list_t selection;
+		yaml_path_regex_t *regex;
 	} data;
 	TAILQ_ENTRY(yaml_path_section) entries;
 
@@ -59,11 +92,90 @@ typedef struct yaml_path_section {
 typedef TAILQ_HEAD(path_section_list, yaml_path_section) path_section_list_t;
 
 
+// Serialized path, offsets are relative to the start of the record and
+// aligned to 8 bytes; strings are NUL-terminated, sets start with the count
+typedef struct yaml_path_record_header {
+	uint32_t sections_count;
+	uint32_t documents_type;
+	uint64_t documents_start;
+	uint64_t documents_end;
+	uint64_t documents_set;
+} yaml_path_record_header_t;
+
+typedef struct yaml_path_record_section {
+	uint32_t type;
+	uint32_t count; // Number of keys of the selection
+	uint64_t value; // Index, or offset of the key, anchor, set or keys
+} yaml_path_record_section_t;
+
+typedef struct yaml_path_record_writer {
+	unsigned char *buffer;
+	size_t size;
+	size_t len;
+} yaml_path_record_writer_t;
+
+
+typedef struct yaml_path_documents {
+	yaml_path_documents_type_t type;
+	size_t *set;
+	size_t start;
+	size_t end; // SIZE_MAX for open slices
+} yaml_path_documents_t;
+
+
+// Path segment checked by the planned matcher
+typedef struct yaml_path_plan_step {
+	yaml_path_section_type_t type;
+	const char *key;
+	size_t key_len;
+	size_t index;
+	const size_t *set;
+} yaml_path_plan_step_t;
+
+// Open container addressed by the path
+typedef struct yaml_path_plan_node {
+	bool mapping;
+	bool key_matched;
+	size_t counter;
+} yaml_path_plan_node_t;
+
+// Paths of keys, indices and sets following the document root are matched
+// by a single pass over the open containers instead of the generic engine
+typedef struct yaml_path_plan {
+	yaml_path_plan_type_t type;
+	yaml_path_plan_step_t *steps;
+	yaml_path_plan_node_t *nodes;
+	size_t target; // Depth of the addressed nodes (number of steps)
+	size_t depth;
+	size_t matched; // Number of open containers on the path
+} yaml_path_plan_t;
+
+
 struct yaml_path {
 	path_section_list_t sections_list;
 	size_t sections_count;
+	yaml_path_documents_t documents;
+	size_t document_index;
+	bool document_selected;
 	size_t current_level;
 	size_t start_level;
+	size_t skip_levels;
+	size_t skip_next; // Set by a seek for the next stream
+	yaml_path_plan_t plan;
+	bool generic; // No plan is built
+	size_t passthrough; // Nesting level inside of a matched container
+
+	yaml_path_match_handler_t *match_handler;
+	void *match_handler_data;
+	yaml_path_value_handler_t *value_handler;
+	void *value_handler_data;
+	yaml_path_node_handler_t *node_handler;
+	void *node_handler_data;
+	yaml_path_match_t match;
+	size_t match_depth;
+	size_t matches;
+	yaml_path_offset_handler_t *offset_handler;
+	void *offset_handler_data;
 
 	yaml_path_error_t error;
 };
@@ -171,6 +283,206 @@ yaml_path_selection_keys_remove (path_key_list_t *selection)
 	}
 }
 
+// End of the bracket expression starting at `i`
+static size_t
+yaml_path_regex_bracket_end (const char *p, size_t i)
+{
+	i++;
+	if (p[i] == '^')
+		i++;
+	if (p[i] == ']')
+		i++;
+	while (p[i] != '\0' && p[i] != ']') {
+		if (p[i] == '[' && (p[i+1] == ':' || p[i+1] == '.' || p[i+1] == '=')) {
+			// Character class, collating symbol or equivalence class
+			char delim = p[i+1];
+			i += 2;
+			while (p[i] != '\0' && !(p[i] == delim && p[i+1] == ']'))
+				i++;
+			if (p[i] != '\0')
+				i += 2;
+		} else {
+			i++;
+		}
+	}
+	return p[i] == '\0' ? i : i + 1;
+}
+
+// Split the (compiled) pattern into atoms, the literal ones are kept and the
+// others are marked by '\0' (keys never contain it); quantifiers also make
+// the preceding atom non-literal
+static void
+yaml_path_regex_literals (yaml_path_regex_t *regex)
+{
+	const char *p = regex->pattern;
+	char *chars = regex->literals;
+	size_t count = 0;
+	bool start = *p == '^';
+	bool end = false;
+	size_t i = start ? 1 : 0;
+	while (p[i] != '\0') {
+		char c = p[i];
+		if (c == '\\' && p[i+1] != '\0') {
+			// Escaped letters and digits are classes or back-references
+			chars[count++] = isalnum((unsigned char)p[i+1]) || p[i+1] & 0x80 ? '\0' : p[i+1];
+			i += 2;
+		} else if (c == '[') {
+			i = yaml_path_regex_bracket_end(p, i);
+			chars[count++] = '\0';
+		} else if (c == '(') {
+			size_t depth = 0;
+			while (p[i] != '\0') {
+				if (p[i] == '[') {
+					i = yaml_path_regex_bracket_end(p, i);
+					continue;
+				}
+				if (p[i] == '\\' && p[i+1] != '\0')
+					i++;
+				else if (p[i] == '(')
+					depth++;
+				else if (p[i] == ')' && !--depth) {
+					i++;
+					break;
+				}
+				i++;
+			}
+			chars[count++] = '\0';
+		} else if (c == '|') {
+			// Alternatives share no literals
+			return;
+		} else if (c == '*' || c == '+' || c == '?' || c == '{') {
+			if (count)
+				chars[count-1] = '\0';
+			if (c == '{')
+				while (p[i+1] != '\0' && p[i] != '}')
+					i++;
+			chars[count++] = '\0';
+			i++;
+		} else if (c == '$' && p[i+1] == '\0') {
+			end = true;
+			i++;
+		} else {
+			// Multibyte characters are not split
+			chars[count++] = strchr(".^$)", c) || c & 0x80 ? '\0' : c;
+			i++;
+		}
+	}
+
+	size_t prefix = 0;
+	size_t suffix = 0;
+	if (start)
+		while (prefix < count && chars[prefix])
+			prefix++;
+	if (end)
+		while (suffix < count && chars[count - suffix - 1])
+			suffix++;
+	if (prefix == count) {
+		// Without both anchors the literals are only a prefix (or nothing)
+		regex->exact = start && end;
+		regex->literal = true;
+		suffix = 0;
+	} else if (suffix == count) {
+		regex->literal = true;
+	}
+	memmove(chars + prefix, chars + count - suffix, suffix);
+	regex->prefix_len = prefix;
+	regex->suffix_len = suffix;
+}
+
+static void
+yaml_path_regex_destroy (yaml_path_regex_t *regex)
+{
+	if (regex == NULL)
+		return;
+	regfree(&regex->re);
+	free(regex->pattern);
+	free(regex->literals);
+	free(regex);
+}
+
+// Compile the pattern (POSIX extended regular expression), -1 is returned
+// if it's invalid and -2 if there's not enough memory
+static int
+yaml_path_regex_create (yaml_path_regex_t **regex, const char *pattern, size_t len)
+{
+	yaml_path_regex_t *re = calloc(1, sizeof(*re));
+	if (re == NULL)
+		return -2;
+	re->pattern = strndup(pattern, len);
+	re->literals = malloc(len + 1);
+	int res = re->pattern == NULL || re->literals == NULL ? REG_ESPACE : regcomp(&re->re, re->pattern, REG_EXTENDED | REG_NOSUB);
+	if (res) {
+		free(re->pattern);
+		free(re->literals);
+		free(re);
+		return res == REG_ESPACE ? -2 : -1;
+	}
+	yaml_path_regex_literals(re);
+	*regex = re;
+	return 0;
+}
+
+static bool
+yaml_path_regex_match (const yaml_path_regex_t *regex, const char *key)
+{
+	size_t len = strlen(key);
+	if (len < regex->prefix_len + regex->suffix_len
+	    || (regex->exact && len != regex->prefix_len)
+	    || memcmp(key, regex->literals, regex->prefix_len)
+	    || memcmp(key + len - regex->suffix_len, regex->literals + regex->prefix_len, regex->suffix_len))
+		return false;
+	return regex->literal || !regexec(&regex->re, key, 0, NULL, 0);
+}
+
+static bool
+yaml_path_documents_has (const yaml_path_documents_t *documents, size_t idx)
+{
+	assert(documents != NULL);
+	switch (documents->type) {
+	case YAML_PATH_DOCUMENTS_SET:
+		return yaml_path_set_has_index(documents->set, idx);
+	case YAML_PATH_DOCUMENTS_SLICE:
+		return idx >= documents->start && idx < documents->end;
+	default:
+		break;
+	}
+	return true;
+}
+
+static size_t
+yaml_path_documents_snprint (const yaml_path_documents_t *documents, char *s, size_t max_len)
+{
+	assert(documents != NULL);
+	size_t len = 0;
+	switch (documents->type) {
+	case YAML_PATH_DOCUMENTS_SET:
+		if (documents->set[0] == 1) {
+			len = snprintf(s, max_len, "#%zu", documents->set[1]);
+		} else {
+			len = snprintf(s, max_len, "#");
+			len += yaml_path_set_snprint(documents->set, s + (len < max_len ? len : max_len), max_len - (len < max_len ? len : max_len));
+		}
+		break;
+	case YAML_PATH_DOCUMENTS_SLICE:
+		if (documents->end == SIZE_MAX)
+			len = snprintf(s, max_len, "#[%zu:]", documents->start);
+		else
+			len = snprintf(s, max_len, "#[%zu:%zu]", documents->start, documents->end);
+		break;
+	default:
+		break;
+	}
+	return len;
+}
+
+static void
+yaml_path_documents_remove (yaml_path_t *path)
+{
+	assert(path != NULL);
+	free(path->documents.set);
+	memset(&path->documents, 0, sizeof(path->documents));
+}
+
 static void
 yaml_path_sections_remove (yaml_path_t *path)
 {
@@ -192,6 +504,9 @@ yaml_path_sections_remove (yaml_path_t *path)
 		case YAML_PATH_SECTION_SELECTION:
 			yaml_path_selection_keys_remove(&el->data.selection);
 			break;
+		case YAML_PATH_SECTION_REGEX:
+			yaml_path_regex_destroy(el->data.regex);
+			break;
 		default:
 			break;
 		}
@@ -228,16 +543,8 @@ yaml_path_section_snprint (yaml_path_section_t *section, char *s, size_t max_len
 	case YAML_PATH_SECTION_ROOT:
 		len = snprintf(s, max_len, "$");
 		break;
-	case YAML_PATH_SECTION_KEY: {
-			char quote = '\0';
-			if (strpbrk(section->data.key, "[]().$&*"))
-				quote = strchr(section->data.key, '\'') ? '"' : '\'';
-			if (quote) {
-				len = snprintf(s, max_len, "[%c%s%c]", quote, section->data.key, quote);
-			} else {
-				len = snprintf(s, max_len, ".%s", section->data.key);
-			}
-		}
+	case YAML_PATH_SECTION_KEY:
+		len = yaml_path_key_snprint(section->data.key, s, max_len);
 		break;
 	case YAML_PATH_SECTION_ANCHOR:
 		len = snprintf(s, max_len, "&%s", section->data.anchor);
@@ -251,6 +558,11 @@ yaml_path_section_snprint (yaml_path_section_t *section, char *s, size_t max_len
 	case YAML_PATH_SECTION_SELECTION:
 		len = yaml_path_selection_snprint(&section->data.selection, s, max_len);
 		break;
+	case YAML_PATH_SECTION_REGEX: {
+			char quote = strchr(section->data.regex->pattern, '\'') ? '"' : '\'';
+			len = snprintf(s, max_len, "[~%c%s%c]", quote, section->data.regex->pattern, quote);
+		}
+		break;
 	default:
 		len = snprintf(s, max_len, "<?>");
 		break;
@@ -279,6 +591,94 @@ do {                                                                  \
 	goto error;                                                       \
 } while (0)
 
+static yaml_path_error_type_t
+yaml_path_documents_parse (yaml_path_documents_t *documents, char *sp, char **spe, const char **message)
+{
+	size_t indices[YAML_PATH_MAX_SECTION_ITEMS+1] = {0};
+	*spe = sp + 1;
+	if (**spe != '[') {
+		if (!isdigit((unsigned char)**spe)) {
+			*message = "Document selector is invalid (missing index)";
+			return YAML_PATH_ERROR_PARSE;
+		}
+		indices[++indices[0]] = strtoul(*spe, spe, 10);
+	} else {
+		(*spe)++;
+		while (**spe == ' ' || **spe == '\t')
+			(*spe)++;
+		if (**spe == '-') {
+			*message = "Document selector is invalid (negative number)";
+			return YAML_PATH_ERROR_PARSE;
+		}
+		size_t start = 0;
+		if (isdigit((unsigned char)**spe)) {
+			start = strtoul(*spe, spe, 10);
+		} else if (**spe != ':') {
+			*message = "Document selector is invalid (invalid character)";
+			return YAML_PATH_ERROR_PARSE;
+		}
+		while (**spe == ' ' || **spe == '\t')
+			(*spe)++;
+		if (**spe == ':') {
+			// Slice (end is not included)
+			(*spe)++;
+			while (**spe == ' ' || **spe == '\t')
+				(*spe)++;
+			documents->start = start;
+			documents->end = SIZE_MAX;
+			if (isdigit((unsigned char)**spe))
+				documents->end = strtoul(*spe, spe, 10);
+			while (**spe == ' ' || **spe == '\t')
+				(*spe)++;
+			if (**spe != ']') {
+				*message = "Document slice is invalid (missing ']')";
+				return YAML_PATH_ERROR_PARSE;
+			}
+			(*spe)++;
+			if (**spe != '\0' && !strchr(".[$&", **spe)) {
+				*message = "Document selector is invalid (invalid character)";
+				return YAML_PATH_ERROR_PARSE;
+			}
+			documents->type = YAML_PATH_DOCUMENTS_SLICE;
+			return YAML_PATH_ERROR_NONE;
+		}
+		indices[++indices[0]] = start;
+		while (**spe == ',') {
+			if (indices[0] >= YAML_PATH_MAX_SECTION_ITEMS) {
+				*message = "Document set has reached the limit of indices: "STR(YAML_PATH_MAX_SECTION_ITEMS);
+				return YAML_PATH_ERROR_SECTION;
+			}
+			(*spe)++;
+			while (**spe == ' ' || **spe == '\t')
+				(*spe)++;
+			if (!isdigit((unsigned char)**spe)) {
+				*message = "Document set is invalid (invalid character)";
+				return YAML_PATH_ERROR_PARSE;
+			}
+			indices[++indices[0]] = strtoul(*spe, spe, 10);
+			while (**spe == ' ' || **spe == '\t')
+				(*spe)++;
+		}
+		if (**spe != ']') {
+			*message = "Document set is invalid (missing ']')";
+			return YAML_PATH_ERROR_PARSE;
+		}
+		(*spe)++;
+	}
+	if (**spe != '\0' && !strchr(".[$&", **spe)) {
+		*message = "Document selector is invalid (invalid character)";
+		return YAML_PATH_ERROR_PARSE;
+	}
+	documents->set = malloc(sizeof(*indices) * (indices[0] + 1));
+	if (documents->set == NULL) {
+		*message = "Unable to allocate memory (documents)";
+		return YAML_PATH_ERROR_NOMEM;
+	}
+	memcpy(documents->set, indices, sizeof(*indices) * (indices[0] + 1));
+	documents->type = YAML_PATH_DOCUMENTS_SET;
+	return YAML_PATH_ERROR_NONE;
+}
+
 static void
 yaml_path_parse_impl (yaml_path_t *path, char *s_path) {
 	char *sp = s_path;
@@ -331,6 +731,30 @@ yaml_path_parse_impl (yaml_path_t *path, char *s_path) {
 					if (sec == NULL)
 						return_with_error(YAML_PATH_ERROR_NOMEM, "Unable to allocate memory (section)", sp - s_path);
 					sp = spe+1;
+				} else if (*spe == '~') {
+					// Regular expression on keys
+					spe++;
+					if (*spe != '\'' && *spe != '"')
+						return_with_error(YAML_PATH_ERROR_PARSE, "Segment regular expression is invalid (missing quotation mark)", spe - s_path);
+					char quote = *spe;
+					sp = spe++;
+					while (*spe != quote && *spe != '\0')
+						spe++;
+					if (*spe == '\0')
+						return_with_error(YAML_PATH_ERROR_PARSE, "Segment regular expression is invalid (unexpected end of string, missing closing quotation mark)", sp - s_path);
+					if (spe == sp+1)
+						return_with_error(YAML_PATH_ERROR_PARSE, "Segment regular expression is missing", sp - s_path);
+					if (*(spe+1) != ']')
+						return_with_error(YAML_PATH_ERROR_PARSE, "Segment regular expression is invalid (missing ']')", spe+1 - s_path);
+					yaml_path_section_t *sec = yaml_path_section_create(path, YAML_PATH_SECTION_REGEX);
+					if (sec == NULL)
+						return_with_error(YAML_PATH_ERROR_NOMEM, "Unable to allocate memory (section)", sp - s_path);
+					int res = yaml_path_regex_create(&sec->data.regex, sp + 1, spe-sp - 1);
+					if (res == -2)
+						return_with_error(YAML_PATH_ERROR_NOMEM, "Unable to allocate memory (regular expression)", sp - s_path);
+					if (res)
+						return_with_error(YAML_PATH_ERROR_PARSE, "Segment regular expression is invalid", sp - s_path);
+					sp = spe+1;
 				} else if (*spe == '\'' || *spe == '"') {
 					// Key(s)
 					size_t keys_count = 0;
@@ -464,6 +888,17 @@ yaml_path_parse_impl (yaml_path_t *path, char *s_path) {
 			}
 			sp = spe - 1;
 			break;
+		case '#':
+			if (path->sections_count == 0 && path->documents.type == YAML_PATH_DOCUMENTS_ALL) {
+				const char *message = NULL;
+				yaml_path_error_type_t error_type = yaml_path_documents_parse(&path->documents, sp, &spe, &message);
+				if (error_type != YAML_PATH_ERROR_NONE)
+					return_with_error(error_type, message, spe - s_path);
+			} else {
+				return_with_error(YAML_PATH_ERROR_SECTION, "Document selector is only allowed at the beginning of the path", sp - s_path);
+			}
+			sp = spe - 1;
+			break;
 		case '$':
 			if (path->sections_count == 0) {
 				yaml_path_section_t *sec = yaml_path_section_create(path, YAML_PATH_SECTION_ROOT);
@@ -495,6 +930,12 @@ yaml_path_parse_impl (yaml_path_t *path, char *s_path) {
 		sp++;
 	}
 
+	if (path->sections_count == 0 && path->documents.type != YAML_PATH_DOCUMENTS_ALL) {
+		// Whole selected documents
+		if (yaml_path_section_create(path, YAML_PATH_SECTION_ROOT) == NULL)
+			return_with_error(YAML_PATH_ERROR_NOMEM, "Unable to allocate memory (section)", sp - s_path);
+	}
+
 	if (path->sections_count == 0)
 		return_with_error(YAML_PATH_ERROR_SECTION, "Invalid, empty or meaningless path", 0);
 
@@ -502,6 +943,7 @@ yaml_path_parse_impl (yaml_path_t *path, char *s_path) {
 
 error:
 	yaml_path_sections_remove(path);
+	yaml_path_documents_remove(path);
 	if (path->error.type == YAML_PATH_ERROR_NONE)
 		yaml_path_error_set(path, YAML_PATH_ERROR_PARSE, "Unable to parse the path string", 0);
 }
@@ -561,7 +1003,7 @@ yaml_path_section_is_mandatory_container (yaml_path_section_t *sec)
 {
 	assert(sec != NULL);
 	bool res = false;
-	if ((sec->type == YAML_PATH_SECTION_SELECTION && sec->node_type == YAML_MAPPING_NODE)
+	if (((sec->type == YAML_PATH_SECTION_SELECTION || sec->type == YAML_PATH_SECTION_REGEX) && sec->node_type == YAML_MAPPING_NODE)
 	    ||
 	    (sec->type == YAML_PATH_SECTION_SET && sec->node_type == YAML_SEQUENCE_NODE))
 		res = true;
@@ -597,6 +1039,696 @@ yaml_path_is_valid (yaml_path_t *path)
 	return valid;
 }
 
+static bool
+yaml_path_event_is_node_start (const yaml_event_t *event)
+{
+	assert(event != NULL);
+	switch (event->type) {
+	case YAML_MAPPING_START_EVENT:
+	case YAML_SEQUENCE_START_EVENT:
+	case YAML_ALIAS_EVENT:
+	case YAML_SCALAR_EVENT:
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+static size_t
+yaml_path_match_offset (yaml_path_t *path, const yaml_mark_t *mark)
+{
+	if (path->offset_handler == NULL)
+		return SIZE_MAX;
+	return path->offset_handler(path->offset_handler_data, mark->index);
+}
+
+static void
+yaml_path_match_track (yaml_path_t *path, const yaml_event_t *event, bool matched)
+{
+	assert(path != NULL);
+	assert(event != NULL);
+	switch (event->type) {
+	case YAML_DOCUMENT_START_EVENT:
+		path->match_depth = 0;
+		break;
+	case YAML_MAPPING_START_EVENT:
+	case YAML_SEQUENCE_START_EVENT:
+		if (path->match_depth) {
+			// Children are counted in `size` until the node ends
+			if (path->match_depth == 1)
+				path->match.size++;
+			path->match_depth++;
+		} else if (matched) {
+			path->match.node_type = event->type == YAML_MAPPING_START_EVENT ? YAML_MAPPING_NODE : YAML_SEQUENCE_NODE;
+			path->match.start_mark = event->start_mark;
+			path->match.start_offset = yaml_path_match_offset(path, &event->start_mark);
+			path->match.size = 0;
+			path->match_depth = 1;
+			path->matches++;
+		}
+		if (path->node_handler != NULL && path->match_depth)
+			path->node_handler(path->node_handler_data, event, path->match_depth);
+		break;
+	case YAML_MAPPING_END_EVENT:
+	case YAML_SEQUENCE_END_EVENT:
+		if (path->node_handler != NULL && path->match_depth)
+			path->node_handler(path->node_handler_data, event, path->match_depth);
+		if (path->match_depth && !--path->match_depth) {
+			path->match.end_mark = event->end_mark;
+			path->match.end_offset = yaml_path_match_offset(path, &event->end_mark);
+			if (path->match.node_type == YAML_MAPPING_NODE)
+				path->match.size = (path->match.size + 1) / 2;
+			if (path->match_handler != NULL)
+				path->match_handler(path->match_handler_data, &path->match);
+		}
+		break;
+	case YAML_ALIAS_EVENT:
+	case YAML_SCALAR_EVENT:
+		if (path->match_depth) {
+			if (path->match_depth == 1)
+				path->match.size++;
+			if (path->node_handler != NULL)
+				path->node_handler(path->node_handler_data, event, path->match_depth + 1);
+		} else if (matched) {
+			// Aliases are reported as scalars, they are not resolved
+			path->match.node_type = YAML_SCALAR_NODE;
+			path->match.start_mark = event->start_mark;
+			path->match.end_mark = event->end_mark;
+			path->match.start_offset = yaml_path_match_offset(path, &event->start_mark);
+			path->match.end_offset = yaml_path_match_offset(path, &event->end_mark);
+			path->match.size = 0;
+			path->matches++;
+			if (path->node_handler != NULL)
+				path->node_handler(path->node_handler_data, event, 1);
+			if (path->match_handler != NULL)
+				path->match_handler(path->match_handler_data, &path->match);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+yaml_path_value_report (yaml_path_t *path, const yaml_event_t *event)
+{
+	assert(path != NULL);
+	assert(event != NULL);
+	yaml_path_value_t value = {
+		.value = (const char *)event->data.scalar.value,
+		.length = event->data.scalar.length,
+		.style = event->data.scalar.style,
+		.tag = (const char *)event->data.scalar.tag,
+		.start_mark = event->start_mark,
+	};
+	path->value_handler(path->value_handler_data, &value);
+}
+
+static uint64_t
+yaml_path_record_put (yaml_path_record_writer_t *w, const void *data, size_t len)
+{
+	size_t pos = (w->len + 7) & ~(size_t)7;
+	if (w->buffer != NULL && pos + len <= w->size) {
+		memset(w->buffer + w->len, 0, pos - w->len);
+		memcpy(w->buffer + pos, data, len);
+	}
+	w->len = pos + len;
+	return pos;
+}
+
+static uint64_t
+yaml_path_record_put_set (yaml_path_record_writer_t *w, const size_t *set)
+{
+	uint64_t pos = yaml_path_record_put(w, &(uint64_t){set[0]}, sizeof(uint64_t));
+	for (size_t i = 1; i <= set[0]; i++)
+		yaml_path_record_put(w, &(uint64_t){set[i]}, sizeof(uint64_t));
+	return pos;
+}
+
+// Check the string at the offset of the record, NULL if it's out of bounds
+static const char*
+yaml_path_record_string (const unsigned char *record, size_t size, uint64_t offset)
+{
+	if (offset >= size || memchr(record + offset, '\0', size - offset) == NULL)
+		return NULL;
+	return (const char *)record + offset;
+}
+
+static size_t*
+yaml_path_record_set (const unsigned char *record, size_t size, uint64_t offset)
+{
+	if (offset % 8 || offset >= size || size - offset < sizeof(uint64_t))
+		return NULL;
+	const uint64_t *data = (const uint64_t *)(record + offset);
+	if (data[0] > YAML_PATH_MAX_SECTION_ITEMS || (size - offset) / sizeof(uint64_t) < data[0] + 1)
+		return NULL;
+	size_t *set = malloc(sizeof(*set) * (data[0] + 1));
+	if (set != NULL) {
+		for (size_t i = 0; i <= data[0]; i++)
+			set[i] = data[i];
+	}
+	return set;
+}
+
+static void
+yaml_path_plan_remove (yaml_path_t *path)
+{
+	assert(path != NULL);
+	free(path->plan.steps);
+	free(path->plan.nodes);
+	memset(&path->plan, 0, sizeof(path->plan));
+}
+
+// Pick the matcher for the parsed path, the generic engine is used for
+// anchors and key selections (and if there's no memory for the plan)
+static void
+yaml_path_plan_build (yaml_path_t *path)
+{
+	assert(path != NULL);
+	yaml_path_plan_remove(path);
+
+	yaml_path_section_t *el = yaml_path_section_get_first(path);
+	if (path->generic || el == NULL || el->type != YAML_PATH_SECTION_ROOT)
+		return;
+	yaml_path_plan_type_t plan_type = YAML_PATH_PLAN_KEYS;
+	for (el = TAILQ_NEXT(el, entries); el != NULL; el = TAILQ_NEXT(el, entries)) {
+		if (el->type == YAML_PATH_SECTION_INDEX || el->type == YAML_PATH_SECTION_SET)
+			plan_type = YAML_PATH_PLAN_STEPS;
+		else if (el->type != YAML_PATH_SECTION_KEY)
+			return;
+	}
+
+	size_t target = path->sections_count - 1;
+	yaml_path_plan_step_t *steps = calloc(target + 1, sizeof(*steps));
+	yaml_path_plan_node_t *nodes = calloc(target + 1, sizeof(*nodes));
+	if (steps == NULL || nodes == NULL) {
+		free(steps);
+		free(nodes);
+		return;
+	}
+	yaml_path_plan_step_t *step = steps;
+	for (el = TAILQ_NEXT(yaml_path_section_get_first(path), entries); el != NULL; el = TAILQ_NEXT(el, entries), step++) {
+		step->type = el->type;
+		switch (el->type) {
+		case YAML_PATH_SECTION_KEY:
+			step->key = el->data.key;
+			step->key_len = strlen(el->data.key);
+			break;
+		case YAML_PATH_SECTION_INDEX:
+			step->index = el->data.index;
+			break;
+		case YAML_PATH_SECTION_SET:
+			// Empty set selects all items
+			step->set = yaml_path_set_is_empty(el->data.set) ? NULL : el->data.set;
+			break;
+		default:
+			break;
+		}
+	}
+	path->plan.type = plan_type;
+	path->plan.steps = steps;
+	path->plan.nodes = nodes;
+	path->plan.target = target;
+}
+
+static bool
+yaml_path_plan_step_matches (const yaml_path_plan_step_t *step, yaml_path_plan_node_t *parent, const yaml_event_t *event)
+{
+	size_t pos = parent->counter++;
+	if (step->type == YAML_PATH_SECTION_KEY) {
+		if (!parent->mapping)
+			return false;
+		if (pos % 2)
+			return parent->key_matched;
+		parent->key_matched = event->type == YAML_SCALAR_EVENT
+		                      && event->data.scalar.length == step->key_len
+		                      && (!step->key_len || event->data.scalar.value[0] == (yaml_char_t)step->key[0])
+		                      && !memcmp(event->data.scalar.value, step->key, step->key_len);
+		return false;
+	}
+	if (parent->mapping)
+		return false;
+	if (step->type == YAML_PATH_SECTION_INDEX)
+		return pos == step->index;
+	return step->set == NULL || yaml_path_set_has_index(step->set, pos);
+}
+
+// Sequences holding the items of a set segment are kept in the output
+static bool
+yaml_path_plan_is_mandatory_container (const yaml_path_plan_t *plan, size_t depth, bool mapping)
+{
+	return plan->type == YAML_PATH_PLAN_STEPS && !mapping
+	       && depth < plan->target && plan->steps[depth].type == YAML_PATH_SECTION_SET;
+}
+
+static yaml_path_filter_result_t
+yaml_path_plan_filter_event (yaml_path_t *path, const yaml_event_t *event)
+{
+	assert(path != NULL);
+	assert(event != NULL);
+	yaml_path_plan_t *plan = &path->plan;
+	yaml_path_filter_result_t res = YAML_PATH_FILTER_RESULT_OUT;
+	bool matched = false;
+
+	switch (event->type) {
+	case YAML_DOCUMENT_START_EVENT:
+		// Skipped steps address the document root itself
+		plan->depth = path->skip_levels;
+		plan->matched = path->skip_levels;
+		res = YAML_PATH_FILTER_RESULT_IN;
+		break;
+	case YAML_MAPPING_START_EVENT:
+	case YAML_SEQUENCE_START_EVENT:
+	case YAML_ALIAS_EVENT:
+	case YAML_SCALAR_EVENT: {
+		size_t depth = plan->depth;
+		bool on_path = false;
+		if (plan->matched > plan->target) {
+			// Inside of the addressed node
+			on_path = true;
+			res = YAML_PATH_FILTER_RESULT_IN;
+		} else if (plan->matched == depth) {
+			on_path = depth == path->skip_levels
+			          || yaml_path_plan_step_matches(&plan->steps[depth - 1], &plan->nodes[depth - 1], event);
+			if (on_path)
+				YAML_PATH_PROBE2(section_match, path, depth);
+			else
+				YAML_PATH_PROBE2(section_mismatch, path, depth);
+			if (on_path && depth == plan->target) {
+				matched = true;
+				res = YAML_PATH_FILTER_RESULT_IN;
+				if (event->type == YAML_MAPPING_START_EVENT || event->type == YAML_SEQUENCE_START_EVENT)
+					path->passthrough = 1;
+			} else if (on_path && yaml_path_plan_is_mandatory_container(plan, depth, event->type != YAML_SEQUENCE_START_EVENT)) {
+				res = YAML_PATH_FILTER_RESULT_IN;
+			}
+		}
+		if (event->type == YAML_MAPPING_START_EVENT || event->type == YAML_SEQUENCE_START_EVENT) {
+			if (on_path) {
+				if (depth < plan->target) {
+					plan->nodes[depth].mapping = event->type == YAML_MAPPING_START_EVENT;
+					plan->nodes[depth].key_matched = false;
+					plan->nodes[depth].counter = 0;
+				}
+				plan->matched++;
+			}
+			plan->depth++;
+		}
+		break;
+	}
+	case YAML_MAPPING_END_EVENT:
+	case YAML_SEQUENCE_END_EVENT: {
+		size_t depth = --plan->depth;
+		if (plan->matched > depth) {
+			plan->matched = depth;
+			if (depth >= plan->target || yaml_path_plan_is_mandatory_container(plan, depth, plan->nodes[depth].mapping))
+				res = YAML_PATH_FILTER_RESULT_IN;
+		}
+		break;
+	}
+	default:
+		res = YAML_PATH_FILTER_RESULT_IN;
+		break;
+	}
+
+	if (path->match_handler != NULL || path->node_handler != NULL)
+		yaml_path_match_track(path, event, matched);
+	if (path->value_handler != NULL && matched && event->type == YAML_SCALAR_EVENT)
+		yaml_path_value_report(path, event);
+
+	return res;
+}
+
+
+/* Private API ------------------------------------------------------------- */
+
+size_t
+yaml_path_steps_get (yaml_path_t *path, yaml_path_step_t *steps, size_t max_count)
+{
+	assert(path != NULL);
+	size_t count = 0;
+	yaml_path_section_t *el = yaml_path_section_get_first(path);
+	if (el == NULL || el->type != YAML_PATH_SECTION_ROOT)
+		return 0;
+	for (el = TAILQ_NEXT(el, entries); el != NULL && count < max_count; el = TAILQ_NEXT(el, entries)) {
+		if (el->type == YAML_PATH_SECTION_KEY) {
+			steps[count].key = el->data.key;
+			steps[count].index = 0;
+		} else if (el->type == YAML_PATH_SECTION_INDEX) {
+			steps[count].key = NULL;
+			steps[count].index = el->data.index;
+		} else {
+			break;
+		}
+		count++;
+	}
+	return count;
+}
+
+void
+yaml_path_steps_skip (yaml_path_t *path, size_t count)
+{
+	assert(path != NULL);
+	assert(count < path->sections_count);
+	path->skip_next = count;
+}
+
+bool
+yaml_path_steps_next_is_all (yaml_path_t *path, size_t count)
+{
+	assert(path != NULL);
+	yaml_path_section_t *el = yaml_path_section_get_first(path);
+	if (el == NULL || el->type != YAML_PATH_SECTION_ROOT)
+		return false;
+	el = yaml_path_section_get_at_level(path, count + 2);
+	return el != NULL && el->type == YAML_PATH_SECTION_SET && yaml_path_set_is_empty(el->data.set);
+}
+
+bool
+yaml_path_handlers_set (yaml_path_t *path)
+{
+	assert(path != NULL);
+	return path->match_handler != NULL || path->value_handler != NULL || path->node_handler != NULL;
+}
+
+bool
+yaml_path_node_handler_is_set (yaml_path_t *path)
+{
+	assert(path != NULL);
+	return path->node_handler != NULL;
+}
+
+void
+yaml_path_match_handler_get (yaml_path_t *path, yaml_path_match_handler_t **handler, void **data)
+{
+	assert(path != NULL && handler != NULL && data != NULL);
+	*handler = path->match_handler;
+	*data = path->match_handler_data;
+}
+
+void
+yaml_path_set_offset_handler (yaml_path_t *path, yaml_path_offset_handler_t *handler, void *data)
+{
+	assert(path != NULL);
+	path->offset_handler = handler;
+	path->offset_handler_data = data;
+}
+
+void
+yaml_path_value_handler_get (yaml_path_t *path, yaml_path_value_handler_t **handler, void **data)
+{
+	assert(path != NULL && handler != NULL && data != NULL);
+	*handler = path->value_handler;
+	*data = path->value_handler_data;
+}
+
+bool
+yaml_path_documents_selective (yaml_path_t *path)
+{
+	assert(path != NULL);
+	return path->documents.type != YAML_PATH_DOCUMENTS_ALL;
+}
+
+size_t
+yaml_path_documents_next (yaml_path_t *path)
+{
+	assert(path != NULL);
+	size_t next = SIZE_MAX;
+	switch (path->documents.type) {
+	case YAML_PATH_DOCUMENTS_SET:
+		for (size_t i = 1; i <= path->documents.set[0]; i++) {
+			if (path->documents.set[i] >= path->document_index && path->documents.set[i] < next)
+				next = path->documents.set[i];
+		}
+		break;
+	case YAML_PATH_DOCUMENTS_SLICE:
+		next = path->document_index > path->documents.start ? path->document_index : path->documents.start;
+		if (next >= path->documents.end)
+			next = SIZE_MAX;
+		break;
+	default:
+		next = path->document_index;
+		break;
+	}
+	return next;
+}
+
+void
+yaml_path_documents_seek (yaml_path_t *path, size_t index)
+{
+	assert(path != NULL);
+	path->document_index = index;
+}
+
+size_t
+yaml_path_matches_get (yaml_path_t *path)
+{
+	assert(path != NULL);
+	return path->matches;
+}
+
+size_t
+yaml_path_record_write (yaml_path_t *path, unsigned char *buffer, size_t size)
+{
+	assert(path != NULL);
+	if (path->sections_count == 0)
+		return 0;
+	yaml_path_record_writer_t w = {buffer, size, 0};
+	yaml_path_record_header_t header;
+	memset(&header, 0, sizeof(header));
+	header.sections_count = path->sections_count;
+	header.documents_type = path->documents.type;
+	header.documents_start = path->documents.start;
+	header.documents_end = path->documents.end;
+
+	// Sections are filled in once their data is placed
+	w.len = sizeof(header) + path->sections_count * sizeof(yaml_path_record_section_t);
+	if (path->documents.type == YAML_PATH_DOCUMENTS_SET)
+		header.documents_set = yaml_path_record_put_set(&w, path->documents.set);
+
+	yaml_path_section_t *el;
+	size_t i = 0;
+	TAILQ_FOREACH(el, &path->sections_list, entries) {
+		yaml_path_record_section_t sec = {el->type, 0, 0};
+		switch (el->type) {
+		case YAML_PATH_SECTION_ANCHOR:
+			sec.value = yaml_path_record_put(&w, el->data.anchor, strlen(el->data.anchor) + 1);
+			break;
+		case YAML_PATH_SECTION_KEY:
+			sec.value = yaml_path_record_put(&w, el->data.key, strlen(el->data.key) + 1);
+			break;
+		case YAML_PATH_SECTION_INDEX:
+			sec.value = el->data.index;
+			break;
+		case YAML_PATH_SECTION_SET:
+			sec.value = yaml_path_record_put_set(&w, el->data.set);
+			break;
+		case YAML_PATH_SECTION_SELECTION: {
+				// Keys follow each other without alignment
+				yaml_path_key_t *key;
+				TAILQ_FOREACH(key, &el->data.selection, entries) {
+					size_t len = strlen(key->key) + 1;
+					if (!sec.count++) {
+						sec.value = yaml_path_record_put(&w, key->key, len);
+						continue;
+					}
+					if (buffer != NULL && w.len + len <= size)
+						memcpy(buffer + w.len, key->key, len);
+					w.len += len;
+				}
+			}
+			break;
+		case YAML_PATH_SECTION_REGEX:
+			sec.value = yaml_path_record_put(&w, el->data.regex->pattern, strlen(el->data.regex->pattern) + 1);
+			break;
+		default:
+			break;
+		}
+		if (buffer != NULL && w.len <= size)
+			memcpy(buffer + sizeof(header) + i * sizeof(sec), &sec, sizeof(sec));
+		i++;
+	}
+	if (buffer != NULL && w.len <= size)
+		memcpy(buffer, &header, sizeof(header));
+	return w.len;
+}
+
+int
+yaml_path_record_read (yaml_path_t *path, const unsigned char *record, size_t size)
+{
+	assert(path != NULL);
+	assert(record != NULL);
+
+	yaml_path_sections_remove(path);
+	yaml_path_documents_remove(path);
+	yaml_path_plan_remove(path);
+	yaml_path_error_clear(path);
+	path->skip_levels = 0;
+	path->skip_next = 0;
+	path->passthrough = 0;
+
+	const yaml_path_record_header_t *header = (const yaml_path_record_header_t *)record;
+	if (size < sizeof(*header)
+	    || header->sections_count == 0
+	    || header->sections_count > (size - sizeof(*header)) / sizeof(yaml_path_record_section_t)
+	    || header->documents_type > YAML_PATH_DOCUMENTS_SLICE)
+		return_with_error(YAML_PATH_ERROR_PARSE, "Path record is invalid", 0);
+
+	path->documents.type = header->documents_type;
+	path->documents.start = header->documents_start;
+	path->documents.end = header->documents_end;
+	if (header->documents_type == YAML_PATH_DOCUMENTS_SET) {
+		path->documents.set = yaml_path_record_set(record, size, header->documents_set);
+		if (path->documents.set == NULL)
+			return_with_error(YAML_PATH_ERROR_PARSE, "Path record is invalid (document set)", 0);
+	}
+
+	const yaml_path_record_section_t *sections = (const yaml_path_record_section_t *)(header + 1);
+	for (size_t i = 0; i < header->sections_count; i++) {
+		const yaml_path_record_section_t *rec = &sections[i];
+		bool first = rec->type == YAML_PATH_SECTION_ROOT || rec->type == YAML_PATH_SECTION_ANCHOR;
+		if (rec->type > YAML_PATH_SECTION_REGEX || first != (i == 0))
+			return_with_error(YAML_PATH_ERROR_PARSE, "Path record is invalid (section type)", i);
+		yaml_path_section_t *sec = yaml_path_section_create(path, rec->type);
+		if (sec == NULL)
+			return_with_error(YAML_PATH_ERROR_NOMEM, "Unable to allocate memory (section)", i);
+		const char *str;
+		switch (rec->type) {
+		case YAML_PATH_SECTION_ANCHOR:
+		case YAML_PATH_SECTION_KEY:
+			str = yaml_path_record_string(record, size, rec->value);
+			if (str == NULL || !*str)
+				return_with_error(YAML_PATH_ERROR_PARSE, "Path record is invalid (key)", i);
+			if (rec->type == YAML_PATH_SECTION_KEY)
+				sec->data.key = strdup(str);
+			else
+				sec->data.anchor = strdup(str);
+			if (sec->data.key == NULL)
+				return_with_error(YAML_PATH_ERROR_NOMEM, "Unable to allocate memory (key)", i);
+			break;
+		case YAML_PATH_SECTION_INDEX:
+			sec->data.index = rec->value;
+			break;
+		case YAML_PATH_SECTION_SET:
+			sec->data.set = yaml_path_record_set(record, size, rec->value);
+			if (sec->data.set == NULL)
+				return_with_error(YAML_PATH_ERROR_PARSE, "Path record is invalid (set)", i);
+			break;
+		case YAML_PATH_SECTION_SELECTION: {
+				if (rec->count > YAML_PATH_MAX_SECTION_ITEMS)
+					return_with_error(YAML_PATH_ERROR_PARSE, "Path record is invalid (keys selection)", i);
+				yaml_path_selection_key_raw_t raw_keys[YAML_PATH_MAX_SECTION_ITEMS];
+				uint64_t offset = rec->value;
+				for (size_t k = 0; k < rec->count; k++) {
+					str = yaml_path_record_string(record, size, offset);
+					if (str == NULL || !*str)
+						return_with_error(YAML_PATH_ERROR_PARSE, "Path record is invalid (keys selection)", i);
+					raw_keys[k].start = str;
+					raw_keys[k].len = strlen(str);
+					offset += raw_keys[k].len + 1;
+				}
+				if (yaml_path_selection_keys_add(&sec->data.selection, raw_keys, rec->count) != rec->count)
+					return_with_error(YAML_PATH_ERROR_NOMEM, "Unable to allocate memory (keys selection)", i);
+			}
+			break;
+		case YAML_PATH_SECTION_REGEX: {
+				str = yaml_path_record_string(record, size, rec->value);
+				if (str == NULL || !*str)
+					return_with_error(YAML_PATH_ERROR_PARSE, "Path record is invalid (regular expression)", i);
+				int res = yaml_path_regex_create(&sec->data.regex, str, strlen(str));
+				if (res == -2)
+					return_with_error(YAML_PATH_ERROR_NOMEM, "Unable to allocate memory (regular expression)", i);
+				if (res)
+					return_with_error(YAML_PATH_ERROR_PARSE, "Path record is invalid (regular expression)", i);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	yaml_path_plan_build(path);
+	return 0;
+
+error:
+	yaml_path_sections_remove(path);
+	yaml_path_documents_remove(path);
+	return -2;
+}
+
+void*
+yaml_path_grow (void *array, size_t *alloc, size_t count, size_t item_size, size_t min_alloc)
+{
+	if (count < *alloc)
+		return array;
+	size_t new_alloc = *alloc ? *alloc * 2 : min_alloc;
+	void *new_array = realloc(array, new_alloc * item_size);
+	if (new_array != NULL)
+		*alloc = new_alloc;
+	return new_array;
+}
+
+struct yaml_path_arena_block {
+	yaml_path_arena_block_t *next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+void*
+yaml_path_arena_alloc (yaml_path_arena_block_t **blocks, size_t size, size_t align)
+{
+	// Only the first block has free space, the older ones are full
+	yaml_path_arena_block_t *block = *blocks;
+	size_t used = block != NULL ? (block->used + align - 1) & ~(align - 1) : 0;
+	if (block == NULL || used > block->size || block->size - used < size) {
+		size_t block_size = block != NULL ? block->size * 2 : YAML_PATH_ARENA_BLOCK_SIZE;
+		while (block_size < size)
+			block_size *= 2;
+		block = malloc(sizeof(*block) + block_size);
+		if (block == NULL)
+			return NULL;
+		block->next = *blocks;
+		block->size = block_size;
+		*blocks = block;
+		used = 0;
+	}
+	block->used = used + size;
+	return block->data + used;
+}
+
+void
+yaml_path_arena_free (yaml_path_arena_block_t **blocks, bool keep)
+{
+	yaml_path_arena_block_t *block = *blocks;
+	if (keep && block != NULL) {
+		while (block->next != NULL) {
+			yaml_path_arena_block_t *next = block->next;
+			block->next = next->next;
+			free(next);
+		}
+		block->used = 0;
+		return;
+	}
+	while (*blocks != NULL) {
+		block = *blocks;
+		*blocks = block->next;
+		free(block);
+	}
+}
+
+size_t
+yaml_path_key_snprint (const char *key, char *s, size_t max_len)
+{
+	char quote = '\0';
+	if (strpbrk(key, "[]().$&*"))
+		quote = strchr(key, '\'') ? '"' : '\'';
+	if (quote)
+		return snprintf(s, max_len, "[%c%s%c]", quote, key, quote);
+	return snprintf(s, max_len, ".%s", key);
+}
+
 
 /* Public API -------------------------------------------------------------- */
 
@@ -618,12 +1750,20 @@ yaml_path_parse (yaml_path_t *path, char *s_path)
 		return -1;
 
 	yaml_path_sections_remove(path);
+	yaml_path_documents_remove(path);
+	yaml_path_plan_remove(path);
 	yaml_path_error_clear(path);
+	path->skip_levels = 0;
+	path->skip_next = 0;
+	path->passthrough = 0;
 
 	yaml_path_parse_impl(path, s_path);
+	YAML_PATH_PROBE3(path_compile, s_path, (int)path->error.type, path->sections_count);
 	if (path->error.type != YAML_PATH_ERROR_NONE)
 		return -2;
 
+	yaml_path_plan_build(path);
+
 	return 0;
 }
 
@@ -633,6 +1773,8 @@ yaml_path_destroy (yaml_path_t *path)
 	if (path == NULL)
 		return;
 	yaml_path_sections_remove(path);
+	yaml_path_documents_remove(path);
+	yaml_path_plan_remove(path);
 	free(path);
 }
 
@@ -652,7 +1794,7 @@ yaml_path_snprint (yaml_path_t *path, char *s, size_t max_len)
 	if (path == NULL)
 		return 0;
 
-	size_t len = 0;
+	size_t len = yaml_path_documents_snprint(&path->documents, s, max_len);
 	yaml_path_section_t *el;
 	TAILQ_FOREACH(el, &path->sections_list, entries) {
 		len += yaml_path_section_snprint(el, s + (len < max_len ? len : max_len), max_len - (len < max_len ? len : max_len));
@@ -660,14 +1802,186 @@ yaml_path_snprint (yaml_path_t *path, char *s, size_t max_len)
 	return len;
 }
 
+size_t
+yaml_path_passthrough_get (yaml_path_t *path)
+{
+	if (path == NULL)
+		return 0;
+	return path->passthrough;
+}
+
+size_t
+yaml_path_required_keys_get (yaml_path_t *path, const char **keys, size_t max_count)
+{
+	if (path == NULL)
+		return 0;
+	size_t count = 0;
+	yaml_path_section_t *el;
+	TAILQ_FOREACH(el, &path->sections_list, entries) {
+		if (el->type != YAML_PATH_SECTION_KEY)
+			continue;
+		if (keys != NULL && count < max_count)
+			keys[count] = el->data.key;
+		count++;
+	}
+	return count;
+}
+
+void
+yaml_path_set_match_handler (yaml_path_t *path, yaml_path_match_handler_t *handler, void *data)
+{
+	if (path == NULL)
+		return;
+	path->match_handler = handler;
+	path->match_handler_data = data;
+	path->match_depth = 0;
+	path->matches = 0;
+}
+
+void
+yaml_path_set_value_handler (yaml_path_t *path, yaml_path_value_handler_t *handler, void *data)
+{
+	if (path == NULL)
+		return;
+	path->value_handler = handler;
+	path->value_handler_data = data;
+}
+
+void
+yaml_path_set_node_handler (yaml_path_t *path, yaml_path_node_handler_t *handler, void *data)
+{
+	if (path == NULL)
+		return;
+	path->node_handler = handler;
+	path->node_handler_data = data;
+	path->match_depth = 0;
+}
+
+void
+yaml_path_set_generic (yaml_path_t *path, int generic)
+{
+	if (path == NULL)
+		return;
+	path->generic = generic;
+	yaml_path_plan_build(path);
+}
+
+// Events inside of a matched container are all passed, only the nesting
+// level is tracked; false is returned for the events that need filtering
+static bool
+yaml_path_passthrough_event (yaml_path_t *path, const yaml_event_t *event)
+{
+	assert(path != NULL);
+	assert(event != NULL);
+	switch (event->type) {
+	case YAML_MAPPING_START_EVENT:
+	case YAML_SEQUENCE_START_EVENT:
+		path->passthrough++;
+		break;
+	case YAML_MAPPING_END_EVENT:
+	case YAML_SEQUENCE_END_EVENT:
+		// End of the matched container itself
+		if (!--path->passthrough)
+			return false;
+		break;
+	case YAML_ALIAS_EVENT:
+	case YAML_SCALAR_EVENT:
+		break;
+	default:
+		// Unfinished stream
+		path->passthrough = 0;
+		return false;
+	}
+	if (path->match_handler != NULL || path->node_handler != NULL)
+		yaml_path_match_track(path, event, false);
+	return true;
+}
+
+// Documents are filtered independently, the state left by the previous one
+// (anchored nodes found in it, or an unfinished document after an input
+// error) is dropped
+static void
+yaml_path_document_reset (yaml_path_t *path)
+{
+	assert(path != NULL);
+	path->current_level = 0;
+	path->start_level = 0;
+	yaml_path_section_t *el;
+	TAILQ_FOREACH(el, &path->sections_list, entries) {
+		el->node_type = YAML_NO_NODE;
+		el->counter = 0;
+		el->valid = false;
+		el->next_valid = false;
+	}
+}
+
+// Tracepoints of the filtered containers, `level` is the nesting level after
+// the event
+static void
+yaml_path_filter_probe (yaml_path_t *path, const yaml_event_t *event, size_t level, yaml_path_filter_result_t res)
+{
+	switch (event->type) {
+	case YAML_MAPPING_START_EVENT:
+	case YAML_SEQUENCE_START_EVENT:
+		YAML_PATH_PROBE3(subtree_enter, path, level, (int)res);
+		break;
+	case YAML_MAPPING_END_EVENT:
+	case YAML_SEQUENCE_END_EVENT:
+		YAML_PATH_PROBE3(subtree_exit, path, level, (int)res);
+		break;
+	default:
+		break;
+	}
+}
+
 yaml_path_filter_result_t
 yaml_path_filter_event (yaml_path_t *path, yaml_parser_t *parser, yaml_event_t *event)
 {
 	if (path == NULL || parser == NULL || event == NULL || path->sections_count == 0)
 		return YAML_PATH_FILTER_RESULT_OUT;
 
+	if (path->passthrough && yaml_path_passthrough_event(path, event))
+		return YAML_PATH_FILTER_RESULT_IN;
+
+	if (event->type == YAML_DOCUMENT_START_EVENT)
+		YAML_PATH_PROBE2(document_start, path, event->start_mark.index);
+	else if (event->type == YAML_DOCUMENT_END_EVENT)
+		YAML_PATH_PROBE2(document_end, path, event->end_mark.index);
+
 	int res = YAML_PATH_FILTER_RESULT_OUT;
 
+	if (path->documents.type != YAML_PATH_DOCUMENTS_ALL) {
+		switch (event->type) {
+		case YAML_STREAM_START_EVENT:
+			path->document_index = 0;
+			path->document_selected = false;
+			break;
+		case YAML_DOCUMENT_START_EVENT:
+			path->document_selected = yaml_path_documents_has(&path->documents, path->document_index++);
+			break;
+		default:
+			break;
+		}
+		// Events of the documents that are not selected are left untouched
+		if (!path->document_selected && event->type != YAML_STREAM_START_EVENT && event->type != YAML_STREAM_END_EVENT)
+			return YAML_PATH_FILTER_RESULT_OUT;
+	}
+
+	// Steps skipped by a seek apply only to the stream following it
+	if (event->type == YAML_STREAM_START_EVENT) {
+		path->skip_levels = path->skip_next;
+		path->skip_next = 0;
+	}
+
+	if (path->plan.type != YAML_PATH_PLAN_GENERIC) {
+		res = yaml_path_plan_filter_event(path, event);
+		yaml_path_filter_probe(path, event, path->plan.depth, res);
+		return res;
+	}
+
+	if (event->type == YAML_DOCUMENT_START_EVENT)
+		yaml_path_document_reset(path);
+
 	const char *anchor = yaml_path_filter_event_get_anchor(event);
 
 	if (!path->start_level) {
@@ -710,7 +2024,9 @@ yaml_path_filter_event (yaml_path_t *path, yaml_parser_t *parser, yaml_event_t *
 						current_section->valid = current_section->next_valid;
 						current_section->next_valid = false;
 					} else {
-						current_section->next_valid = !strcmp(current_section->data.key, (const char *)event->data.scalar.value);
+						// Complex keys and aliases are never matched
+						current_section->next_valid = event->type == YAML_SCALAR_EVENT
+						                              && !strcmp(current_section->data.key, (const char *)event->data.scalar.value);
 						current_section->valid = false;
 					}
 				} else if (current_section->type == YAML_PATH_SECTION_SELECTION) {
@@ -719,7 +2035,17 @@ yaml_path_filter_event (yaml_path_t *path, yaml_parser_t *parser, yaml_event_t *
 						current_section->next_valid = false;
 					} else {
 						current_section->next_valid = yaml_path_selection_is_empty(&current_section->data.selection)
-						                              || yaml_path_selection_key_get(&current_section->data.selection, (const char *)event->data.scalar.value) != NULL;
+						                              || (event->type == YAML_SCALAR_EVENT
+						                                  && yaml_path_selection_key_get(&current_section->data.selection, (const char *)event->data.scalar.value) != NULL);
+						current_section->valid = current_section->next_valid;
+					}
+				} else if (current_section->type == YAML_PATH_SECTION_REGEX) {
+					if (current_section->counter % 2) {
+						current_section->valid = current_section->next_valid;
+						current_section->next_valid = false;
+					} else {
+						current_section->next_valid = event->type == YAML_SCALAR_EVENT
+						                              && yaml_path_regex_match(current_section->data.regex, (const char *)event->data.scalar.value);
 						current_section->valid = current_section->next_valid;
 					}
 				} else {
@@ -739,12 +2065,25 @@ yaml_path_filter_event (yaml_path_t *path, yaml_parser_t *parser, yaml_event_t *
 			default:
 				break;
 			}
+			if (current_section->valid)
+				YAML_PATH_PROBE2(section_match, path, current_section->level);
+			else
+				YAML_PATH_PROBE2(section_mismatch, path, current_section->level);
 			current_section->counter++;
 		default:
 			break;
 		}
 	}
 
+	// The event starts a node addressed by the path (keys of the last
+	// section's mapping are not addressed nodes, only their values are)
+	bool matched = (path->match_handler != NULL || path->value_handler != NULL || path->node_handler != NULL)
+	               && current_section != NULL
+	               && yaml_path_event_is_node_start(event)
+	               && yaml_path_section_current_is_last(path)
+	               && !(current_section->node_type == YAML_MAPPING_NODE && current_section->counter % 2)
+	               && yaml_path_is_valid(path);
+
 	switch (event->type) {
 	case YAML_STREAM_START_EVENT:
 	case YAML_STREAM_END_EVENT:
@@ -752,21 +2091,33 @@ yaml_path_filter_event (yaml_path_t *path, yaml_parser_t *parser, yaml_event_t *
 		res = YAML_PATH_FILTER_RESULT_IN;
 		break;
 	case YAML_DOCUMENT_START_EVENT:
-		if (path->start_level == 1)
-			path->current_level++;
+		if (path->start_level == 1) {
+			path->current_level += 1 + path->skip_levels;
+			// Skipped sections address the document root itself
+			yaml_path_section_t *el;
+			TAILQ_FOREACH(el, &path->sections_list, entries) {
+				if (el->level > 1 + path->skip_levels)
+					break;
+				el->valid = true;
+			}
+		}
 		res = YAML_PATH_FILTER_RESULT_IN;
 		break;
 	case YAML_DOCUMENT_END_EVENT:
 		if (path->start_level == 1)
-			path->current_level--;
+			path->current_level -= 1 + path->skip_levels;
 		res = YAML_PATH_FILTER_RESULT_IN;
 		break;
 	case YAML_MAPPING_START_EVENT:
 	case YAML_SEQUENCE_START_EVENT:
 		if (current_section) {
 			if (yaml_path_section_current_is_last(path))
-				if (yaml_path_is_valid(path))
+				if (yaml_path_is_valid(path)) {
 					res = YAML_PATH_FILTER_RESULT_IN;
+					// Addressed container (not a key), everything inside is passed
+					if (!(current_section->node_type == YAML_MAPPING_NODE && current_section->counter % 2))
+						path->passthrough = 1;
+				}
 		} else {
 			if (path->current_level > path->start_level) {
 				if (yaml_path_is_valid(path))
@@ -825,5 +2176,11 @@ yaml_path_filter_event (yaml_path_t *path, yaml_parser_t *parser, yaml_event_t *
 		break;
 	}
 
+	if (path->match_handler != NULL || path->node_handler != NULL)
+		yaml_path_match_track(path, event, matched);
+	if (path->value_handler != NULL && matched && event->type == YAML_SCALAR_EVENT)
+		yaml_path_value_report(path, event);
+
+	yaml_path_filter_probe(path, event, path->current_level, res);
 	return res;
 }
@@ -1,6 +1,8 @@
 #ifndef YAML_PATH_H
 #define YAML_PATH_H
 
+#include <stdint.h>
+
 #include <yaml.h>
 
 
@@ -11,6 +13,13 @@ typedef enum yaml_path_error_type {
 	YAML_PATH_ERROR_NOMEM,
 	YAML_PATH_ERROR_PARSE,
 	YAML_PATH_ERROR_SECTION,
+	YAML_PATH_ERROR_INPUT,
+	YAML_PATH_ERROR_OUTPUT,
+	YAML_PATH_ERROR_LIMIT_DEPTH,
+	YAML_PATH_ERROR_LIMIT_EVENTS,
+	YAML_PATH_ERROR_LIMIT_SCALAR,
+	YAML_PATH_ERROR_LIMIT_OUTPUT,
+	YAML_PATH_ERROR_LIMIT_DEADLINE,
 } yaml_path_error_type_t;
 
 typedef struct yaml_path_error {
@@ -25,6 +34,230 @@ typedef enum yaml_path_filter_result {
 	YAML_PATH_FILTER_RESULT_IN_DANGLING_KEY,
 } yaml_path_filter_result_t;
 
+typedef struct yaml_path_match {
+	yaml_node_type_t node_type;
+	// Marks are taken from the parser events: `index` is the position
+	// in characters (equal to the byte offset for ASCII input), `line`
+	// and `column` are zero-based
+	yaml_mark_t start_mark;
+	yaml_mark_t end_mark;
+	size_t size; // Items of a sequence, pairs of a mapping (0 for scalars)
+	// Byte offsets in the input, found by the driver for the string and the
+	// pushed input (SIZE_MAX for other inputs and without the driver)
+	size_t start_offset;
+	size_t end_offset;
+} yaml_path_match_t;
+
+typedef void yaml_path_match_handler_t (void *data, const yaml_path_match_t *match);
+
+// Scalar matched by the path, strings are taken from the event and they are
+// valid only during the handler call
+typedef struct yaml_path_value {
+	const char *value; // NUL-terminated
+	size_t length;
+	yaml_scalar_style_t style;
+	const char *tag; // NULL for scalars without a tag
+	yaml_mark_t start_mark;
+} yaml_path_value_t;
+
+typedef void yaml_path_value_handler_t (void *data, const yaml_path_value_t *value);
+
+// Piece of a large block scalar matched by the path, `last` is set for the
+// final (possibly empty) one; it should return 1 on success and 0 on failure
+typedef int yaml_path_chunk_handler_t (void *data, const yaml_path_value_t *chunk, int last);
+
+// Event of a node matched by the path, `depth` is 1 for the events of the
+// node itself and it grows for the nested nodes
+typedef void yaml_path_node_handler_t (void *data, const yaml_event_t *event, size_t depth);
+
+typedef struct yaml_path_arena_block yaml_path_arena_block_t;
+
+// Values collected by yaml_path_values_handler(), strings are copied into
+// the caller's buffer and then into the blocks allocated by the library
+typedef struct yaml_path_values {
+	yaml_path_value_t *items;
+	size_t count;
+	int error; // Memory ran out, some values are missing
+
+	size_t items_alloc;
+	char *buffer;
+	size_t buffer_size;
+	size_t buffer_used;
+	yaml_path_arena_block_t *blocks;
+} yaml_path_values_t;
+
+typedef enum yaml_path_column_type {
+	YAML_PATH_COLUMN_INT64,
+	YAML_PATH_COLUMN_DOUBLE,
+	YAML_PATH_COLUMN_BOOL,
+} yaml_path_column_type_t;
+
+// Values of matched scalars resolved with the YAML core schema, the item is
+// valid (its bit in `validity` is set) if the value has the column's type
+// (integers are accepted by double columns as well)
+typedef struct yaml_path_column {
+	yaml_path_column_type_t type;
+	size_t count;
+	size_t valid_count;
+	int error; // Memory ran out, some values are missing
+
+	union {
+		int64_t *ints;
+		double *doubles;
+		uint8_t *bools; // Bitmap
+	} data;
+	uint8_t *validity; // Bitmap
+
+	size_t alloc;
+} yaml_path_column_t;
+
+#define YAML_PATH_DIGEST_SIZE 16
+
+// Digest of a matched node (YAML_PATH_DIGEST_SIZE bytes)
+typedef void yaml_path_digest_handler_t (void *data, const unsigned char *digest);
+
+typedef struct yaml_path_digest_frame yaml_path_digest_frame_t;
+
+// Nodes are hashed (SipHash-2-4, 128 bits) as they are parsed: scalars are
+// resolved with the YAML core schema, anchors and styles are left out and
+// pairs of mappings are optionally taken in any order
+typedef struct yaml_path_digest {
+	int sort_keys;
+	int error; // Memory ran out, the digests of some nodes are missing
+	yaml_path_digest_handler_t *handler;
+	void *handler_data;
+
+	// The node being hashed, followed by its open mappings (sorted keys)
+	yaml_path_digest_frame_t *frames;
+	size_t frames_count;
+	size_t frames_alloc;
+} yaml_path_digest_t;
+
+typedef struct yaml_path_shape_node yaml_path_shape_node_t;
+
+// Nodes found at one place of the matched nodes, the items of sequences
+// and the values of equal keys are merged (scalar values are dropped)
+struct yaml_path_shape_node {
+	const char *key; // NULL for the matched nodes and the items
+	size_t scalars;
+	size_t mappings;
+	size_t sequences;
+	size_t aliases;
+	size_t pairs; // Pairs of the mappings
+	size_t items; // Items of the sequences
+
+	yaml_path_shape_node_t *keys;  // Values of the keys in the order they were found
+	size_t keys_count;
+	yaml_path_shape_node_t *other; // Values of the keys beyond the limit and of complex keys
+	yaml_path_shape_node_t *item;
+	yaml_path_shape_node_t *next;
+	yaml_path_shape_node_t *keys_last;
+};
+
+typedef struct yaml_path_shape_frame yaml_path_shape_frame_t;
+
+// Structure of the matched nodes down to `max_depth` levels (0 for all of
+// them), the matched node is the first level
+typedef struct yaml_path_shape {
+	size_t max_depth;
+	int error; // Memory ran out, some nodes are missing
+	yaml_path_shape_node_t *root;
+
+	yaml_path_shape_frame_t *frames; // Open collections
+	size_t frames_count;
+	size_t frames_alloc;
+} yaml_path_shape_t;
+
+typedef enum yaml_path_dom_node_type {
+	YAML_PATH_DOM_SCALAR,
+	YAML_PATH_DOM_SEQUENCE,
+	YAML_PATH_DOM_MAPPING,
+	YAML_PATH_DOM_ALIAS,
+} yaml_path_dom_node_type_t;
+
+typedef struct yaml_path_dom_node yaml_path_dom_node_t;
+
+// Node of a matched subtree, strings are NUL-terminated and interned (equal
+// short strings share the memory)
+struct yaml_path_dom_node {
+	yaml_path_dom_node_type_t type;
+	yaml_scalar_style_t style;
+	const char *tag;    // NULL for nodes without a tag
+	const char *anchor; // Anchor of the node, or the one the alias refers to
+	const char *value;  // Scalars only
+	size_t length;      // Length of the value, or the number of children
+	yaml_path_dom_node_t *children; // Items, or keys each followed by its value
+};
+
+typedef struct yaml_path_dom_string yaml_path_dom_string_t;
+
+// Matched nodes built from the events, the nodes and the strings are placed
+// in blocks (an arena) freed at once, children of a collection are copied
+// there together once it is complete
+typedef struct yaml_path_dom {
+	yaml_path_dom_node_t *roots; // Matched nodes
+	size_t count;
+	int error; // Memory ran out, some nodes are missing
+
+	// The roots are followed by the pending nodes of the open collections
+	size_t nodes_count;
+	size_t nodes_alloc;
+	size_t *frames; // Positions of the open collections
+	size_t frames_count;
+	size_t frames_alloc;
+
+	yaml_path_arena_block_t *blocks;
+	yaml_path_dom_string_t *strings; // Hash table of the interned strings
+	size_t strings_count;
+	size_t strings_alloc;
+} yaml_path_dom_t;
+
+// Position in the input and the concrete path found there
+typedef struct yaml_path_location {
+	int by_line;  // Position given by `line` and `column` instead of `index`
+	size_t index; // In characters, as in the marks of the events
+	size_t line;  // Zero-based
+	size_t column;
+
+	char *path; // Buffer for the path, it's cut to fit like with snprintf()
+	size_t path_size;
+	size_t path_length; // Length of the whole path, 0 if the position wasn't reached
+} yaml_path_location_t;
+
+typedef struct yaml_path_index yaml_path_index_t;
+
+typedef struct yaml_path_bundle yaml_path_bundle_t;
+
+typedef enum yaml_path_compression {
+	YAML_PATH_COMPRESSION_NONE,
+	YAML_PATH_COMPRESSION_GZIP,
+	YAML_PATH_COMPRESSION_ZSTD,
+} yaml_path_compression_t;
+
+typedef struct yaml_path_input yaml_path_input_t;
+
+typedef struct yaml_path_output yaml_path_output_t;
+
+// Filtered events are passed to the handler, it should return 1 on success
+// and 0 on failure (same as libyaml handlers); the event is deleted afterwards
+typedef int yaml_path_event_handler_t (void *data, yaml_event_t *event);
+
+typedef struct yaml_path_driver yaml_path_driver_t;
+
+// Zero means no limit; the output size is counted in bytes written by the
+// emitter, in bytes of scalar values passed to the output handler, and in
+// bytes of chunks passed to the chunk handler; the
+// clock is checked only every 256 parsed events, so a run stalled inside the
+// parser (on one huge scalar or a slow input) can overrun the timeout without
+// bound
+typedef struct yaml_path_limits {
+	size_t max_depth;
+	size_t max_events;
+	size_t max_scalar_length;
+	size_t max_output_bytes;
+	unsigned long timeout_ms; // Wall-clock time of a run (or of a fed stream)
+} yaml_path_limits_t;
+
 
 yaml_path_t*
 yaml_path_create (void);
@@ -41,8 +274,324 @@ yaml_path_error_get (yaml_path_t *path);
 yaml_path_filter_result_t
 yaml_path_filter_event (yaml_path_t *path, yaml_parser_t *parser, yaml_event_t *event);
 
+// Nesting level inside of the matched container the last filtered event
+// belongs to (0 outside of it); all events are passed until the container
+// ends, so they can be forwarded without checks
+size_t
+yaml_path_passthrough_get (yaml_path_t *path);
+
 size_t
 yaml_path_snprint (yaml_path_t *path, char *s, size_t max_len);
 
+// Keys every matched node is nested under (key segments of the path), the
+// number of them is returned and up to `max_count` of them are set
+size_t
+yaml_path_required_keys_get (yaml_path_t *path, const char **keys, size_t max_count);
+
+// Quick check of the raw input without parsing it: 0 is returned if some of
+// the required keys can't be found in it (nothing would be matched), 1 if
+// the input may have matched nodes and -1 for invalid arguments
+int
+yaml_path_prefilter (yaml_path_t *path, const unsigned char *input, size_t size);
+
+// The handler is called from yaml_path_filter_event() once a node matched
+// by the path is complete (on its scalar/alias event or its closing event)
+void
+yaml_path_set_match_handler (yaml_path_t *path, yaml_path_match_handler_t *handler, void *data);
+
+// The handler is called from yaml_path_filter_event() for every scalar
+// matched by the path (scalars inside of matched collections are skipped,
+// use [:] or .* to get them; aliases are not resolved, so they are skipped)
+void
+yaml_path_set_value_handler (yaml_path_t *path, yaml_path_value_handler_t *handler, void *data);
+
+// The handler is called from yaml_path_filter_event() for every event of the
+// nodes matched by the path
+void
+yaml_path_set_node_handler (yaml_path_t *path, yaml_path_node_handler_t *handler, void *data);
+
+// Paths made of keys, indices and sets are matched by a planned matcher, a
+// non-zero `generic` forces the generic engine for them (to compare the two);
+// it's kept for the paths parsed later, call it before filtering
+void
+yaml_path_set_generic (yaml_path_t *path, int generic);
+
+// The buffer is optional, it is used before any memory is allocated
+void
+yaml_path_values_init (yaml_path_values_t *values, char *buffer, size_t size);
+
+// Drop the values, the memory is kept for the next ones
+void
+yaml_path_values_clear (yaml_path_values_t *values);
+
+void
+yaml_path_values_delete (yaml_path_values_t *values);
+
+// Value handler collecting copies of the values, data is yaml_path_values_t
+void
+yaml_path_values_handler (void *data, const yaml_path_value_t *value);
+
+void
+yaml_path_column_init (yaml_path_column_t *column, yaml_path_column_type_t type);
+
+void
+yaml_path_column_clear (yaml_path_column_t *column);
+
+void
+yaml_path_column_delete (yaml_path_column_t *column);
+
+// Value handler appending the values to the column, data is yaml_path_column_t
+void
+yaml_path_column_handler (void *data, const yaml_path_value_t *value);
+
+void
+yaml_path_digest_init (yaml_path_digest_t *digest, int sort_keys, yaml_path_digest_handler_t *handler, void *data);
+
+void
+yaml_path_digest_delete (yaml_path_digest_t *digest);
+
+// Node handler passing the digest of each matched node to the digest
+// handler, data is yaml_path_digest_t
+void
+yaml_path_digest_node_handler (void *data, const yaml_event_t *event, size_t depth);
+
+void
+yaml_path_shape_init (yaml_path_shape_t *shape, size_t max_depth);
+
+void
+yaml_path_shape_delete (yaml_path_shape_t *shape);
+
+// Node handler merging the matched nodes into the shape, data is
+// yaml_path_shape_t
+void
+yaml_path_shape_node_handler (void *data, const yaml_event_t *event, size_t depth);
+
+// Emit the shape as a YAML stream of one document (empty mapping if nothing
+// was matched), collections are in the flow style if `flow` is set; -2 is
+// returned if the emitter fails
+int
+yaml_path_shape_emit (yaml_path_shape_t *shape, yaml_emitter_t *emitter, int flow);
+
+
+void
+yaml_path_dom_init (yaml_path_dom_t *dom);
+
+// Free the nodes and all the strings
+void
+yaml_path_dom_delete (yaml_path_dom_t *dom);
+
+// Node handler adding the matched nodes to the roots, data is
+// yaml_path_dom_t
+void
+yaml_path_dom_node_handler (void *data, const yaml_event_t *event, size_t depth);
+
+// Value of the scalar key in the mapping (the first one if it's repeated),
+// NULL if there's none
+const yaml_path_dom_node_t*
+yaml_path_dom_mapping_get (const yaml_path_dom_node_t *mapping, const char *key);
+
+
+// Concrete paths (keys and indices, printed as by yaml_path_snprint()) of the
+// innermost nodes at the locations, found in one pass over the events of the
+// parser: a position between nodes belongs to the node starting later on
+// the same line or to the collection around it; parsing stops once all the
+// positions are passed, -2 is returned on parser errors (the locations found
+// before are set) or if memory runs out
+int
+yaml_path_locate (yaml_parser_t *parser, yaml_path_location_t *locations, size_t count);
+
+
+// Build a sidecar index of the YAML file with byte ranges of map values and
+// sequence items down to the given depth (single document files only)
+int
+yaml_path_index_build (const char *file_name, const char *index_name, size_t depth);
+
+// Open the sidecar index, NULL is returned if it is missing or outdated
+yaml_path_index_t*
+yaml_path_index_open (const char *file_name, const char *index_name);
+
+void
+yaml_path_index_close (yaml_path_index_t *index);
+
+// Set the parser input to the smallest indexed part of the file that holds
+// the nodes addressed by the path (or to the whole file), and adjust the path
+// accordingly; the index must outlive the parsing
+//
+// The part is parsed with a synthetic document start and indentation before
+// it, so the marks of the events are positions in the parser input (see
+// yaml_path_index_origin_get)
+int
+yaml_path_index_seek (yaml_path_index_t *index, yaml_path_t *path, yaml_parser_t *parser);
+
+// Start of the part set by the last seek in the parser input and the same
+// position in the file, for yaml_path_driver_set_input_origin
+void
+yaml_path_index_origin_get (const yaml_path_index_t *index, yaml_mark_t *start, yaml_mark_t *origin);
+
+
+// Save compiled paths into a bundle file that can be loaded without parsing
+// (the bundle is tied to the version of the library and the byte order)
+int
+yaml_path_bundle_write (const char *file_name, yaml_path_t **paths, size_t count);
+
+// Map the bundle, paths are not touched until they are requested
+yaml_path_bundle_t*
+yaml_path_bundle_open (const char *file_name);
+
+void
+yaml_path_bundle_close (yaml_path_bundle_t *bundle);
+
+size_t
+yaml_path_bundle_count (yaml_path_bundle_t *bundle);
+
+// Load the path stored at the index of the bundle into the given path object
+// (as yaml_path_parse() does with a path string)
+int
+yaml_path_bundle_get (yaml_path_bundle_t *bundle, size_t index, yaml_path_t *path);
+
+
+// Input read from the file descriptor, gzip and zstd streams are recognized
+// by their magic numbers and decompressed on a thread of their own into a ring
+// of buffers ahead of the parser (zstd only if the library is built with it);
+// NULL is returned if the thread can't be started
+yaml_path_input_t*
+yaml_path_input_open (int fd);
+
+// Stop the decompression, the descriptor is left open
+void
+yaml_path_input_close (yaml_path_input_t *input);
+
+yaml_path_compression_t
+yaml_path_input_compression_get (yaml_path_input_t *input);
+
+// Read and decompression errors, the parser reports them as reader errors
+const yaml_path_error_t*
+yaml_path_input_error_get (yaml_path_input_t *input);
+
+// Set the (decompressed) input to the parser, the input must outlive the parsing
+int
+yaml_path_input_set_parser (yaml_path_input_t *input, yaml_parser_t *parser);
+
+// Read the plain input on a thread ahead of the parser as well (compressed
+// input always is), only before the parser starts reading
+int
+yaml_path_input_set_readahead (yaml_path_input_t *input);
+
+
+// Output written to the file descriptor on a thread of its own, the data is
+// collected into large buffers passed to the thread once they are full (the
+// writer blocks while the thread is behind by all of them)
+yaml_path_output_t*
+yaml_path_output_open (int fd);
+
+// Write the rest of the data and stop the thread, nothing can be written
+// afterwards; on error `errno` is set as by the failed write
+int
+yaml_path_output_flush (yaml_path_output_t *output);
+
+// Flush and free the output, the descriptor is left open
+void
+yaml_path_output_close (yaml_path_output_t *output);
+
+int
+yaml_path_output_write (yaml_path_output_t *output, const unsigned char *data, size_t size);
+
+// Set the output as the write handler of the emitter
+int
+yaml_path_output_set_emitter (yaml_path_output_t *output, yaml_emitter_t *emitter);
+
+const yaml_path_error_t*
+yaml_path_output_error_get (yaml_path_output_t *output);
+
+
+yaml_path_driver_t*
+yaml_path_driver_create (void);
+
+void
+yaml_path_driver_destroy (yaml_path_driver_t *driver);
+
+const yaml_path_error_t*
+yaml_path_driver_error_get (yaml_path_driver_t *driver);
+
+// Filtered events go to the emitter...
+void
+yaml_path_driver_set_output_emitter (yaml_path_driver_t *driver, yaml_emitter_t *emitter);
+
+// ...or to the handler
+void
+yaml_path_driver_set_output_handler (yaml_path_driver_t *driver, yaml_path_event_handler_t *handler, void *data);
+
+// Force the flow style for all filtered collections
+void
+yaml_path_driver_set_flow_style (yaml_path_driver_t *driver, int flow);
+
+// Number of threads yaml_path_driver_run_string() may use for a document
+// with one huge block sequence, the root node or the value of a key of the
+// root mapping, whose items are all addressed (`[:]...`, `.key[:]...`); the
+// items are split by indentation, parsed and filtered in chunks and sent in
+// order as the chunks are done (the first one right away), if it doesn't
+// work out the input is parsed serially and the events sent already are
+// skipped (paths with match or value handlers, limits and document
+// selections are run serially)
+void
+yaml_path_driver_set_threads (yaml_path_driver_t *driver, size_t threads);
+
+// Block scalars with bodies of at least `min_size` bytes in the input of
+// yaml_path_driver_run_string() are not read by the parser: the matched ones
+// go to the handler in chunks instead of the value handler of the path (or
+// to the value handler in one piece if there is no chunk handler), the ones
+// passed to the output are decoded whole and the others are skipped; the
+// scalars are found by a raw scan of the input, which is then parsed
+// serially; 0 turns it off
+void
+yaml_path_driver_set_chunk_handler (yaml_path_driver_t *driver, size_t min_size, yaml_path_chunk_handler_t *handler, void *data);
+
+// Stop runs exceeding the limits with YAML_PATH_ERROR_LIMIT_* errors, the
+// limits are copied; NULL removes them
+void
+yaml_path_driver_set_limits (yaml_path_driver_t *driver, const yaml_path_limits_t *limits);
+
+// The input of the parsers given to yaml_path_driver_run() and
+// yaml_path_driver_count() is a part of a larger input: the marks of the
+// events (and the positions of the parser errors) from `start` on are moved
+// to `origin`, the ones before it are set to `origin`; NULL removes it
+void
+yaml_path_driver_set_input_origin (yaml_path_driver_t *driver, const yaml_mark_t *start, const yaml_mark_t *origin);
+
+// Parse the whole input and pass the filtered events to the output, the
+// values of dangling keys are filled with nulls; on the input error details
+// are available in the parser
+int
+yaml_path_driver_run (yaml_path_driver_t *driver, yaml_path_t *path, yaml_parser_t *parser);
+
+// Count the nodes matched by the path without any output, parsing stops once
+// `limit` nodes are found (0 means no limit, 1 checks whether the path exists)
+int
+yaml_path_driver_count (yaml_path_driver_t *driver, yaml_path_t *path, yaml_parser_t *parser, size_t limit, size_t *count);
+
+int
+yaml_path_driver_run_string (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *input, size_t size);
+
+// Compressed input is recognized (see yaml_path_input_open())
+int
+yaml_path_driver_run_fd (yaml_path_driver_t *driver, yaml_path_t *path, int fd);
+
+// Push a chunk of the input, all complete documents are filtered and sent to
+// the output right away, as well as the complete entries of the root block
+// collection of the current document (an entry is complete once the next one
+// starts at column 0); 0 is returned when more data is needed, the input is
+// copied, so the chunk can be reused
+int
+yaml_path_driver_feed (yaml_path_driver_t *driver, yaml_path_t *path, const unsigned char *chunk, size_t size);
+
+// Filter the rest of the pushed input and finish the stream
+int
+yaml_path_driver_feed_end (yaml_path_driver_t *driver, yaml_path_t *path);
+
+// Filter the rest of the pushed input without finishing the stream, the next
+// pushed chunk starts a new input (documents are counted from its start)
+int
+yaml_path_driver_feed_restart (yaml_path_driver_t *driver, yaml_path_t *path);
+
 #endif//YAML_PATH_H
 
@@ -1,124 +1,544 @@
 #include <stdio.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <errno.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <yaml.h>
 
 #include "yaml-path.h"
+#include "yaml-path-probes.h"
 
 
+#define YAMLP_INDEX_SUFFIX ".ypi"
+#define YAMLP_INDEX_DEPTH  3
+#define YAMLP_RAW_BUFFER_SIZE (256 * 1024)
+#define YAMLP_FOLLOW_READ_SIZE   (64 * 1024)
+#define YAMLP_FOLLOW_INTERVAL_MS 100
+
+// Long options without a short form
+#define YAMLP_OPT_FOLLOW 256
+#define YAMLP_OPT_SHAPE  257
+
+
+// Scalar values are written directly to the output, each one followed by
+// the delimiter
+typedef struct yamlp_raw_output {
+	char delimiter;
+	int error;
+	size_t len;
+	char buffer[YAMLP_RAW_BUFFER_SIZE];
+} yamlp_raw_output_t;
+
+
+// Input file mapped into the memory for parallel parsing (-j) and for block
+// scalars decoded in chunks (-b)
+static const unsigned char *input = NULL;
+static size_t input_size = 0;
+static size_t input_threads = 1;
+static size_t block_size = 0;
+
+// Input read (and decompressed) for the parser
+static yaml_path_input_t *stream = NULL;
+
+// Output written on its own thread (-P)
+static yaml_path_output_t *output = NULL;
+
+// Set by SIGINT/SIGTERM in the follow mode
+static volatile sig_atomic_t follow_stopped = 0;
+
+
+static void
+print_parser_error (yaml_parser_t *parser)
+{
+	switch (parser->error) {
+	case YAML_MEMORY_ERROR:
+		fprintf(stderr, "Memory error: Not enough memory for parsing\n");
+		break;
+	case YAML_READER_ERROR:
+		if (parser->problem_value != -1) {
+			fprintf(stderr, "Reader error: %s: #%X at %ld\n", parser->problem, parser->problem_value, (long)parser->problem_offset);
+		} else {
+			fprintf(stderr, "Reader error: %s at %ld\n", parser->problem, (long)parser->problem_offset);
+		}
+		break;
+	case YAML_SCANNER_ERROR:
+		if (parser->context) {
+			fprintf(stderr, "Scanner error: %s at line %d, column %d\n%s at line %d, column %d\n", parser->context,
+			       (int)parser->context_mark.line+1,(int)parser->context_mark.column+1, parser->problem,
+			       (int)parser->problem_mark.line+1, (int)parser->problem_mark.column+1);
+		} else {
+			fprintf(stderr, "Scanner error: %s at line %d, column %d\n", parser->problem, (int)parser->problem_mark.line+1, (int)parser->problem_mark.column+1);
+		}
+		break;
+	case YAML_PARSER_ERROR:
+		if (parser->context) {
+			fprintf(stderr, "Parser error: %s at line %d, column %d\n%s at line %d, column %d\n", parser->context,
+			       (int)parser->context_mark.line+1, (int)parser->context_mark.column+1, parser->problem,
+			       (int)parser->problem_mark.line+1, (int)parser->problem_mark.column+1);
+		} else {
+			fprintf(stderr, "Parser error: %s at line %d, column %d\n", parser->problem, (int)parser->problem_mark.line+1, (int)parser->problem_mark.column+1);
+		}
+		break;
+	default:
+		fprintf(stderr, "Internal error\n");
+		break;
+	}
+}
+
+static void
+print_emitter_error (yaml_emitter_t *emitter)
+{
+	switch (emitter->error)
+	{
+	case YAML_MEMORY_ERROR:
+		fprintf(stderr, "Memory error: Not enough memory for emitting\n");
+		break;
+	case YAML_WRITER_ERROR:
+		fprintf(stderr, "Writer error: %s\n", emitter->problem);
+		break;
+	case YAML_EMITTER_ERROR:
+		fprintf(stderr, "Emitter error: %s\n", emitter->problem);
+		break;
+	default:
+		fprintf(stderr, "Internal error\n");
+		break;
+	}
+}
+
+// Same as the libyaml file output, with the flush tracepoint
+static int
+write_output (void *data, unsigned char *buffer, size_t size)
+{
+	YAML_PATH_PROBE1(output_flush, size);
+	return fwrite(buffer, 1, size, (FILE *)data) == size;
+}
+
+static int
+print_driver_error (yaml_path_driver_t *driver, yaml_parser_t *parser, yaml_emitter_t *emitter)
+{
+	switch (yaml_path_driver_error_get(driver)->type) {
+	case YAML_PATH_ERROR_INPUT:
+		if (stream != NULL && yaml_path_input_error_get(stream)->type != YAML_PATH_ERROR_NONE)
+			fprintf(stderr, "Input error: %s at %zu\n", yaml_path_input_error_get(stream)->message, yaml_path_input_error_get(stream)->pos);
+		else if (input != NULL || parser == NULL)
+			fprintf(stderr, "Parser error: %s at %zu\n", yaml_path_driver_error_get(driver)->message, yaml_path_driver_error_get(driver)->pos);
+		else
+			print_parser_error(parser);
+		return 1;
+	case YAML_PATH_ERROR_OUTPUT:
+		if (emitter != NULL)
+			print_emitter_error(emitter);
+		else
+			fprintf(stderr, "Writer error: %s\n", strerror(errno));
+		return 2;
+	case YAML_PATH_ERROR_NOMEM:
+		fprintf(stderr, "Memory error: %s\n", yaml_path_driver_error_get(driver)->message);
+		return 1;
+	default:
+		fprintf(stderr, "Internal error\n");
+		return 1;
+	}
+}
+
+static int
+driver_run (yaml_path_driver_t *driver, yaml_path_t *path, yaml_parser_t *parser)
+{
+	if (input == NULL)
+		return yaml_path_driver_run(driver, path, parser);
+	yaml_path_driver_set_threads(driver, input_threads);
+	return yaml_path_driver_run_string(driver, path, input, input_size);
+}
+
 static int
 parse_and_emit (yaml_parser_t *parser, yaml_emitter_t *emitter, yaml_path_t *path, int use_flow_style)
 {
-	yaml_event_t event;
-	yaml_event_type_t event_type, prev_event_type = YAML_NO_EVENT;
-	yaml_path_filter_result_t result, prev_result = YAML_PATH_FILTER_RESULT_OUT;
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	if (driver == NULL) {
+		fprintf(stderr, "Memory error: Not enough memory for filtering\n");
+		return 1;
+	}
+	yaml_path_driver_set_output_emitter(driver, emitter);
+	yaml_path_driver_set_flow_style(driver, use_flow_style);
+	yaml_path_driver_set_chunk_handler(driver, block_size, NULL, NULL);
 
-	do {
-		if (!yaml_parser_parse(parser, &event)) {
-			switch (parser->error) {
-			case YAML_MEMORY_ERROR:
-				fprintf(stderr, "Memory error: Not enough memory for parsing\n");
-				break;
-			case YAML_READER_ERROR:
-				if (parser->problem_value != -1) {
-					fprintf(stderr, "Reader error: %s: #%X at %ld\n", parser->problem, parser->problem_value, (long)parser->problem_offset);
-				} else {
-					fprintf(stderr, "Reader error: %s at %ld\n", parser->problem, (long)parser->problem_offset);
-				}
-				break;
-			case YAML_SCANNER_ERROR:
-				if (parser->context) {
-					fprintf(stderr, "Scanner error: %s at line %d, column %d\n%s at line %d, column %d\n", parser->context,
-					       (int)parser->context_mark.line+1,(int)parser->context_mark.column+1, parser->problem,
-					       (int)parser->problem_mark.line+1, (int)parser->problem_mark.column+1);
-				} else {
-					fprintf(stderr, "Scanner error: %s at line %d, column %d\n", parser->problem, (int)parser->problem_mark.line+1, (int)parser->problem_mark.column+1);
-				}
+	int res = 0;
+	if (driver_run(driver, path, parser)) {
+		res = print_driver_error(driver, parser, emitter);
+	} else if (output != NULL && yaml_path_output_flush(output)) {
+		fprintf(stderr, "Writer error: %s\n", strerror(errno));
+		res = 2;
+	}
+
+	yaml_path_driver_destroy(driver);
+	return res;
+}
+
+static void
+raw_output_flush (yamlp_raw_output_t *out)
+{
+	YAML_PATH_PROBE1(output_flush, out->len);
+	if (out->len && !out->error && fwrite(out->buffer, 1, out->len, stdout) != out->len)
+		out->error = 1;
+	out->len = 0;
+}
+
+static void
+raw_output_value (void *data, const yaml_path_value_t *value)
+{
+	yamlp_raw_output_t *out = data;
+	if (output != NULL) {
+		// Batched by the output
+		if (!out->error && (yaml_path_output_write(output, (const unsigned char *)value->value, value->length)
+		                    || yaml_path_output_write(output, (const unsigned char *)&out->delimiter, 1)))
+			out->error = 1;
+		return;
+	}
+	if (out->len + value->length + 1 > sizeof(out->buffer)) {
+		raw_output_flush(out);
+		if (value->length + 1 > sizeof(out->buffer)) {
+			// Too long for the buffer
+			if (!out->error && (fwrite(value->value, 1, value->length, stdout) != value->length
+			                    || putc(out->delimiter, stdout) == EOF))
+				out->error = 1;
+			return;
+		}
+	}
+	memcpy(out->buffer + out->len, value->value, value->length);
+	out->len += value->length;
+	out->buffer[out->len++] = out->delimiter;
+}
+
+// Large values are written as they are decoded
+static int
+raw_output_chunk (void *data, const yaml_path_value_t *chunk, int last)
+{
+	yamlp_raw_output_t *out = data;
+	if (output != NULL) {
+		if (!out->error && (yaml_path_output_write(output, (const unsigned char *)chunk->value, chunk->length)
+		                    || (last && yaml_path_output_write(output, (const unsigned char *)&out->delimiter, 1))))
+			out->error = 1;
+		return !out->error;
+	}
+	raw_output_flush(out);
+	if (!out->error && (fwrite(chunk->value, 1, chunk->length, stdout) != chunk->length
+	                    || (last && putc(out->delimiter, stdout) == EOF)))
+		out->error = 1;
+	return !out->error;
+}
+
+static int
+parse_and_print (yaml_parser_t *parser, yaml_path_t *path, char delimiter)
+{
+	static yamlp_raw_output_t out;
+	out.delimiter = delimiter;
+	out.error = 0;
+	out.len = 0;
+
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	if (driver == NULL) {
+		fprintf(stderr, "Memory error: Not enough memory for filtering\n");
+		return 1;
+	}
+	yaml_path_driver_set_output_handler(driver, NULL, NULL);
+	yaml_path_driver_set_chunk_handler(driver, block_size, raw_output_chunk, &out);
+	yaml_path_set_value_handler(path, raw_output_value, &out);
+
+	int res = 0;
+	if (driver_run(driver, path, parser))
+		res = print_driver_error(driver, parser, NULL);
+	raw_output_flush(&out);
+	if (!res && (out.error || (output != NULL ? yaml_path_output_flush(output) : fflush(stdout)))) {
+		fprintf(stderr, "Writer error: %s\n", strerror(errno));
+		res = 2;
+	}
+
+	yaml_path_set_value_handler(path, NULL, NULL);
+	yaml_path_driver_destroy(driver);
+	return res;
+}
+
+static int
+parse_and_count (yaml_parser_t *parser, yaml_path_t *path, size_t limit, size_t *count)
+{
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	if (driver == NULL) {
+		fprintf(stderr, "Memory error: Not enough memory for filtering\n");
+		return 1;
+	}
+
+	int res = 0;
+	if (yaml_path_driver_count(driver, path, parser, limit, count))
+		res = print_driver_error(driver, parser, NULL);
+
+	yaml_path_driver_destroy(driver);
+	return res;
+}
+
+static void
+print_match_size (void *data, const yaml_path_match_t *match)
+{
+	(void)data;
+	printf("%zu\n", match->size);
+}
+
+static int
+parse_and_print_sizes (yaml_parser_t *parser, yaml_path_t *path)
+{
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	if (driver == NULL) {
+		fprintf(stderr, "Memory error: Not enough memory for filtering\n");
+		return 1;
+	}
+	yaml_path_driver_set_output_handler(driver, NULL, NULL);
+	yaml_path_set_match_handler(path, print_match_size, NULL);
+
+	int res = 0;
+	if (driver_run(driver, path, parser))
+		res = print_driver_error(driver, parser, NULL);
+	if (!res && fflush(stdout)) {
+		fprintf(stderr, "Writer error: %s\n", strerror(errno));
+		res = 2;
+	}
+
+	yaml_path_set_match_handler(path, NULL, NULL);
+	yaml_path_driver_destroy(driver);
+	return res;
+}
+
+static void
+print_digest (void *data, const unsigned char *digest)
+{
+	(void)data;
+	for (size_t i = 0; i < YAML_PATH_DIGEST_SIZE; i++)
+		printf("%02x", digest[i]);
+	putchar('\n');
+}
+
+static int
+parse_and_print_digests (yaml_parser_t *parser, yaml_path_t *path, int sort_keys)
+{
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	if (driver == NULL) {
+		fprintf(stderr, "Memory error: Not enough memory for filtering\n");
+		return 1;
+	}
+	yaml_path_driver_set_output_handler(driver, NULL, NULL);
+	yaml_path_digest_t digest;
+	yaml_path_digest_init(&digest, sort_keys, print_digest, NULL);
+	yaml_path_set_node_handler(path, yaml_path_digest_node_handler, &digest);
+
+	int res = 0;
+	if (driver_run(driver, path, parser)) {
+		res = print_driver_error(driver, parser, NULL);
+	} else if (digest.error) {
+		fprintf(stderr, "Memory error: Not enough memory for digests\n");
+		res = 1;
+	}
+	if (!res && fflush(stdout)) {
+		fprintf(stderr, "Writer error: %s\n", strerror(errno));
+		res = 2;
+	}
+
+	yaml_path_set_node_handler(path, NULL, NULL);
+	yaml_path_digest_delete(&digest);
+	yaml_path_driver_destroy(driver);
+	return res;
+}
+
+// The shape of the matched nodes is printed once the input is parsed (an
+// empty one if the input is skipped)
+static int
+parse_and_print_shape (yaml_parser_t *parser, yaml_emitter_t *emitter, yaml_path_t *path, int skip, size_t max_depth, int use_flow_style)
+{
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	if (driver == NULL) {
+		fprintf(stderr, "Memory error: Not enough memory for filtering\n");
+		return 1;
+	}
+	yaml_path_driver_set_output_handler(driver, NULL, NULL);
+	yaml_path_shape_t shape;
+	yaml_path_shape_init(&shape, max_depth);
+	yaml_path_set_node_handler(path, yaml_path_shape_node_handler, &shape);
+
+	int res = 0;
+	if (!skip && driver_run(driver, path, parser)) {
+		res = print_driver_error(driver, parser, NULL);
+	} else if (shape.error) {
+		fprintf(stderr, "Memory error: Not enough memory for the shape\n");
+		res = 1;
+	} else if (yaml_path_shape_emit(&shape, emitter, use_flow_style)) {
+		print_emitter_error(emitter);
+		res = 2;
+	}
+
+	yaml_path_set_node_handler(path, NULL, NULL);
+	yaml_path_shape_delete(&shape);
+	yaml_path_driver_destroy(driver);
+	return res;
+}
+
+// Whether the <file> is missing some keys of the path, so that nothing
+// can be matched in it and it doesn't have to be parsed
+static int
+prefilter_file (FILE *file, yaml_path_t *path)
+{
+	if (input != NULL)
+		return !yaml_path_prefilter(path, input, input_size);
+	struct stat st;
+	if (!yaml_path_required_keys_get(path, NULL, 0) || fstat(fileno(file), &st) || !S_ISREG(st.st_mode) || st.st_size <= 0)
+		return 0;
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	if (map == MAP_FAILED)
+		return 0;
+	int res = !yaml_path_prefilter(path, map, st.st_size);
+	munmap(map, st.st_size);
+	return res;
+}
+
+static void
+follow_stop (int sig)
+{
+	(void)sig;
+	follow_stopped = 1;
+}
+
+static int
+follow_flush (yaml_emitter_t *emitter, yamlp_raw_output_t *out)
+{
+	if (out != NULL) {
+		raw_output_flush(out);
+		if (out->error)
+			return -1;
+	} else if (!yaml_emitter_flush(emitter)) {
+		return -1;
+	}
+	return fflush(stdout) ? -1 : 0;
+}
+
+// Filter the documents appended to the file until SIGINT or SIGTERM (or the
+// end of a non-regular file), each document is filtered and written as soon
+// as it's complete (followed by '---', or ended by '...'); truncated files are
+// read again from the start
+static int
+parse_and_follow (int fd, yaml_emitter_t *emitter, yaml_path_t *path, int use_flow_style, int raw, char delimiter)
+{
+	static unsigned char buffer[YAMLP_FOLLOW_READ_SIZE];
+	static yamlp_raw_output_t out;
+	out.delimiter = delimiter;
+	out.error = 0;
+	out.len = 0;
+
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	if (driver == NULL) {
+		fprintf(stderr, "Memory error: Not enough memory for filtering\n");
+		return 1;
+	}
+	if (raw) {
+		yaml_path_driver_set_output_handler(driver, NULL, NULL);
+		yaml_path_set_value_handler(path, raw_output_value, &out);
+	} else {
+		yaml_path_driver_set_output_emitter(driver, emitter);
+		yaml_path_driver_set_flow_style(driver, use_flow_style);
+	}
+
+	// No SA_RESTART, the blocking read is interrupted
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = follow_stop;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	int res = 0;
+	off_t offset = 0;
+	struct stat st;
+	while (!follow_stopped) {
+		ssize_t len = read(fd, buffer, sizeof(buffer));
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0) {
+			fprintf(stderr, "Unable to read the input (%s)\n", strerror(errno));
+			res = 1;
+			break;
+		}
+		if (len > 0) {
+			offset += len;
+			if (yaml_path_driver_feed(driver, path, buffer, len)) {
+				res = print_driver_error(driver, NULL, raw ? NULL : emitter);
 				break;
-			case YAML_PARSER_ERROR:
-				if (parser->context) {
-					fprintf(stderr, "Parser error: %s at line %d, column %d\n%s at line %d, column %d\n", parser->context,
-					       (int)parser->context_mark.line+1, (int)parser->context_mark.column+1, parser->problem,
-					       (int)parser->problem_mark.line+1, (int)parser->problem_mark.column+1);
-				} else {
-					fprintf(stderr, "Parser error: %s at line %d, column %d\n", parser->problem, (int)parser->problem_mark.line+1, (int)parser->problem_mark.column+1);
-				}
+			}
+			if (follow_flush(raw ? NULL : emitter, raw ? &out : NULL))
 				break;
-			default:
-				fprintf(stderr, "Internal error\n");
+			continue;
+		}
+
+		if (fstat(fd, &st) || !S_ISREG(st.st_mode))
+			break;
+		if (st.st_size < offset) {
+			fprintf(stderr, "File truncated, following from the start\n");
+			// The output stream goes on
+			if (yaml_path_driver_feed_restart(driver, path)) {
+				res = print_driver_error(driver, NULL, raw ? NULL : emitter);
 				break;
 			}
-			return 1;
-		} else {
-			event_type = event.type;
-			result = yaml_path_filter_event(path, parser, &event);
-			if (result == YAML_PATH_FILTER_RESULT_OUT) {
-				yaml_event_delete(&event);
-			} else {
-				if (use_flow_style) {
-					switch (event.type) {
-					case YAML_SEQUENCE_START_EVENT:
-						event.data.sequence_start.style = YAML_FLOW_SEQUENCE_STYLE;
-						break;
-					case YAML_MAPPING_START_EVENT:
-						event.data.mapping_start.style = YAML_FLOW_MAPPING_STYLE;
-						break;
-					default:
-						break;
-					}
-				}
-				if ((prev_event_type == YAML_DOCUMENT_START_EVENT && event_type == YAML_DOCUMENT_END_EVENT)
-					|| (prev_result == YAML_PATH_FILTER_RESULT_IN_DANGLING_KEY
-						&& (event_type == YAML_MAPPING_END_EVENT
-							|| event_type == YAML_SEQUENCE_END_EVENT
-							|| result == YAML_PATH_FILTER_RESULT_IN_DANGLING_KEY))) {
-					yaml_event_t null_event= {0};
-					yaml_scalar_event_initialize(&null_event, NULL, (yaml_char_t *)"!!null", (yaml_char_t *)"null", 4, 1, 0, YAML_ANY_SCALAR_STYLE);
-					yaml_emitter_emit(emitter, &null_event);
-				}
-				prev_result = result;
-				prev_event_type = event_type;
-				if (!yaml_emitter_emit(emitter, &event)) {
-					switch (emitter->error)
-					{
-					case YAML_MEMORY_ERROR:
-						fprintf(stderr, "Memory error: Not enough memory for emitting\n");
-						break;
-					case YAML_WRITER_ERROR:
-						fprintf(stderr, "Writer error: %s\n", emitter->problem);
-						break;
-					case YAML_EMITTER_ERROR:
-						fprintf(stderr, "Emitter error: %s\n", emitter->problem);
-						break;
-					default:
-						fprintf(stderr, "Internal error\n");
-						break;
-					}
-					return 2;
-				}
-			}
+			lseek(fd, 0, SEEK_SET);
+			offset = 0;
+			continue;
 		}
-	} while (event_type != YAML_STREAM_END_EVENT);
+		struct timespec interval = {0, YAMLP_FOLLOW_INTERVAL_MS * 1000000L};
+		nanosleep(&interval, NULL);
+	}
 
-	return 0;
-}
+	// The last document is complete now
+	if (!res && yaml_path_driver_feed_end(driver, path))
+		res = print_driver_error(driver, NULL, raw ? NULL : emitter);
+	if (follow_flush(raw ? NULL : emitter, raw ? &out : NULL) && !res) {
+		fprintf(stderr, "Writer error: %s\n", strerror(errno));
+		res = 2;
+	}
 
+	yaml_path_set_value_handler(path, NULL, NULL);
+	yaml_path_driver_destroy(driver);
+	return res;
+}
 
 static void
 help (void)
 {
 	printf("yamlp - filtering utility for YAML documents\n");
 	printf("\n");
-	printf("Usage: yamlp [-F] [-W <width>] [-f <file>] <path>\n");
+	printf("Usage: yamlp [-F | -r | -0 | -e | -c | -d] [-P] [-W <width>] [-f <file> [-i | -j <threads> | -b <size>]] <path>\n");
+	printf("       yamlp [-F] [-W <width>] [-f <file> [-i | -j <threads>]] --shape[=<depth>] <path>\n");
+	printf("       yamlp [-F | -r | -0] [-W <width>] [-f <file>] --follow <path>\n");
 	printf("       yamlp -h\n");
 	printf("\n");
 	printf("The tool will take the input YAML document from <stdin> or a <file> (-f option),\n");
 	printf("and it will then return the portion of the document marked with the given <path>.\n");
+	printf("Compressed input (gzip, or zstd if supported by the library) is recognized.\n");
+	printf("A <file> missing some keys of the <path> is not parsed with -r, -0, -e, -c, -d or --shape.\n");
 	printf("\n");
 	printf("Options:\n");
+	printf("  -b	block scalars of at least <size> bytes in the <file> are not held in\n");
+	printf("    	the memory, raw output (-r, -0) writes them in chunks and the ones\n");
+	printf("    	not matched are skipped;\n");
+	printf("\n");
+	printf("  -c	print the number of the matched nodes instead of them, if repeated\n");
+	printf("    	(-cc), print the size of each matched node (items of a sequence,\n");
+	printf("    	pairs of a mapping, 0 for a scalar);\n");
+	printf("\n");
+	printf("  -d	print a digest of each matched node (128-bit hash of its content with\n");
+	printf("    	the scalars resolved, without styles, anchors or comments), if\n");
+	printf("    	repeated (-dd), the order of mapping keys doesn't matter;\n");
+	printf("\n");
+	printf("  -e	no output, exit with 0 if the path matches any node and with 5\n");
+	printf("    	otherwise, parsing stops at the first matched node;\n");
+	printf("\n");
 	printf("  -f	a filename to get the YAML document from,\n");
 	printf("    	<stdin> will be used if omitted;\n");
 	printf("\n");
@@ -126,26 +546,101 @@ help (void)
 	printf("\n");
 	printf("  -h	help;\n");
 	printf("\n");
-	printf("  -W	line wrap width, no wrapping if omitted.\n");
+	printf("  -i	use a sidecar index of the <file> (<file>"YAMLP_INDEX_SUFFIX"), it is built\n");
+	printf("    	if it is missing or outdated;\n");
+	printf("\n");
+	printf("  -P	pipelined mode, the input is read and the output is written on threads\n");
+	printf("    	of their own, the output is written in large blocks;\n");
+	printf("\n");
+	printf("  -r	raw output, values of the matched scalars one per line (use [:]\n");
+	printf("    	or .* to get the items of a collection);\n");
+	printf("\n");
+	printf("  -0	same as -r, but the values are terminated by NUL characters;\n");
+	printf("\n");
+	printf("  -j	number of threads for parsing of a <file> with one huge sequence\n");
+	printf("    	(items of the root sequence or of a top-level key, [:] or .key[:]);\n");
+	printf("\n");
+	printf("  -W	line wrap width, no wrapping if omitted;\n");
+	printf("\n");
+	printf("  --follow	keep reading the documents appended to the <file> (or <stdin>) until\n");
+	printf("          	interrupted, each one is filtered once it is complete (followed by\n");
+	printf("          	'---' or ended by '...');\n");
+	printf("\n");
+	printf("  --shape	print the structure of the matched nodes down to <depth> levels\n");
+	printf("         	(all of them if omitted) instead of them, the keys found at each\n");
+	printf("         	level with the counts of the node types, items of sequences and\n");
+	printf("         	values of equal keys are merged, scalar values are dropped.\n");
 	printf("\n");
 }
 
 int main(int argc, char *argv[])
 {
 	int flow = 0;
+	int raw = 0;
+	int exists = 0;
+	int count = 0;
+	int digest = 0;
+	char delimiter = '\n';
+	int use_index = 0;
+	int pipelined = 0;
 	char *file_name = NULL;
 	char *path_string = NULL;
 	long wrap = -1;
 
+	int follow = 0;
+	int shape = 0;
+	size_t shape_depth = 0;
+	static const struct option long_options[] = {
+		{"follow", no_argument, NULL, YAMLP_OPT_FOLLOW},
+		{"shape", optional_argument, NULL, YAMLP_OPT_SHAPE},
+		{NULL, 0, NULL, 0},
+	};
+
 	int opt;
-	while ((opt = getopt(argc, argv, ":f:W:vhSF")) != -1) {
+	while ((opt = getopt_long(argc, argv, ":f:W:j:b:vhiSFPr0ecd", long_options, NULL)) != -1) {
 		switch (opt) {
+		case YAMLP_OPT_FOLLOW:
+			follow = 1;
+			break;
+		case YAMLP_OPT_SHAPE:
+			shape = 1;
+			if (optarg != NULL) {
+				shape_depth = strtoul(optarg, NULL, 10);
+				if (!shape_depth) {
+					fprintf(stderr, "Invalid shape depth '%s'\n", optarg);
+					return 1;
+				}
+			}
+			break;
 		case 'h':
 			help();
 			return 0;
 		case 'F':
 			flow = 1;
 			break;
+		case 'i':
+			use_index = 1;
+			break;
+		case 'P':
+			pipelined = 1;
+			break;
+		case 'r':
+			raw = 1;
+			delimiter = '\n';
+			break;
+		case '0':
+			raw = 1;
+			delimiter = '\0';
+			break;
+		case 'e':
+			exists = 1;
+			break;
+		case 'c':
+			count++;
+			break;
+		case 'd':
+			digest++;
+			break;
 		case 'W':
 			wrap = strtol(optarg, NULL, 10);
 			if (!wrap) {
@@ -156,11 +651,28 @@ int main(int argc, char *argv[])
 		case 'f':
 			file_name = optarg;
 			break;
+		case 'j':
+			input_threads = strtoul(optarg, NULL, 10);
+			if (!input_threads) {
+				fprintf(stderr, "Invalid number of threads '%s'\n", optarg);
+				return 1;
+			}
+			break;
+		case 'b':
+			block_size = strtoul(optarg, NULL, 10);
+			if (!block_size) {
+				fprintf(stderr, "Invalid block scalar size '%s'\n", optarg);
+				return 1;
+			}
+			break;
 		case ':':
 			fprintf(stderr, "Option needs a value\n");
 			return 1;
 		case '?':
-			fprintf(stderr, "Unknown option '%c'\n", optopt);
+			if (optopt)
+				fprintf(stderr, "Unknown option '%c'\n", optopt);
+			else
+				fprintf(stderr, "Unknown option '%s'\n", argv[optind - 1]);
 			return 1;
         default:
             fprintf(stderr, "Unhandled option '%c'\n", opt);
@@ -193,17 +705,118 @@ int main(int argc, char *argv[])
 		return 3;
 	}
 
+	if (follow) {
+		if (use_index || exists || count || digest || shape || pipelined || input_threads > 1 || block_size) {
+			fprintf(stderr, "Follow mode can't be combined with -i, -j, -b, -e, -c, -d, -P or --shape\n");
+			return 1;
+		}
+		yaml_emitter_t emitter;
+		yaml_emitter_initialize(&emitter);
+		yaml_emitter_set_output(&emitter, write_output, stdout);
+		yaml_emitter_set_width(&emitter, (int) wrap);
+		int res = parse_and_follow(fileno(file != NULL ? file : stdin), &emitter, path, flow, raw, delimiter);
+		yaml_emitter_delete(&emitter);
+		yaml_path_destroy(path);
+		if (file != NULL)
+			fclose(file);
+		return res ? 4 : 0;
+	}
+
+	yaml_path_index_t *index = NULL;
+	if (use_index) {
+		if (file_name == NULL) {
+			fprintf(stderr, "Index needs an input file\n");
+			return 1;
+		}
+		size_t index_name_len = strlen(file_name) + sizeof(YAMLP_INDEX_SUFFIX);
+		char *index_name = malloc(index_name_len);
+		if (index_name == NULL) {
+			fprintf(stderr, "Memory error: Not enough memory for index\n");
+			return 1;
+		}
+		snprintf(index_name, index_name_len, "%s"YAMLP_INDEX_SUFFIX, file_name);
+		index = yaml_path_index_open(file_name, index_name);
+		if (index == NULL) {
+			if (yaml_path_index_build(file_name, index_name, YAMLP_INDEX_DEPTH))
+				fprintf(stderr, "Unable to build index '%s', the whole file will be parsed\n", index_name);
+			else
+				index = yaml_path_index_open(file_name, index_name);
+		}
+		free(index_name);
+	}
+
 	yaml_parser_t parser;
 	yaml_emitter_t emitter;
+	int skipped = 0;
 
 	yaml_parser_initialize(&parser);
-	yaml_parser_set_input_file(&parser, file != NULL ? file : stdin);
+	if (index != NULL) {
+		yaml_path_index_seek(index, path, &parser);
+	} else {
+		stream = yaml_path_input_open(fileno(file != NULL ? file : stdin));
+		if (stream == NULL) {
+			fprintf(stderr, "Memory error: Not enough memory for input\n");
+			return 1;
+		}
+		yaml_path_input_set_parser(stream, &parser);
+		if (pipelined && yaml_path_input_set_readahead(stream)) {
+			fprintf(stderr, "Unable to start the input thread\n");
+			return 1;
+		}
+
+		// The parser is used if the file can't be mapped, unselected documents
+		// of a mapped file are skipped unparsed
+		struct stat st;
+		int documents = path_string[strspn(path_string, " \t")] == '#';
+		if (file != NULL && (input_threads > 1 || block_size || documents) && yaml_path_input_compression_get(stream) == YAML_PATH_COMPRESSION_NONE
+		    && !fstat(fileno(file), &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+			void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+			if (map != MAP_FAILED) {
+				input = map;
+				input_size = st.st_size;
+			}
+		}
+
+		// Nothing is printed for unmatched input in these modes
+		if (file != NULL && (raw || exists || count || digest || shape) && yaml_path_input_compression_get(stream) == YAML_PATH_COMPRESSION_NONE)
+			skipped = prefilter_file(file, path);
+	}
 
 	yaml_emitter_initialize(&emitter);
-	yaml_emitter_set_output_file(&emitter, stdout);
+	if (pipelined && !exists && !count && !digest && !shape) {
+		output = yaml_path_output_open(fileno(stdout));
+		if (output == NULL) {
+			fprintf(stderr, "Unable to start the output thread\n");
+			return 1;
+		}
+		yaml_path_output_set_emitter(output, &emitter);
+	} else {
+		yaml_emitter_set_output(&emitter, write_output, stdout);
+	}
 	yaml_emitter_set_width(&emitter, (int) wrap);
 
-	if (parse_and_emit(&parser, &emitter, path, flow)) {
+	int res = 0;
+	if (exists || count == 1) {
+		size_t matched = 0;
+		if (!skipped && parse_and_count(&parser, path, exists ? 1 : 0, &matched))
+			return 4;
+		// Decompression of the rest of the input is stopped
+		yaml_path_input_close(stream);
+		stream = NULL;
+		if (exists)
+			res = matched ? 0 : 5;
+		else
+			printf("%zu\n", matched);
+	} else if (count) {
+		if (!skipped && parse_and_print_sizes(&parser, path))
+			return 4;
+	} else if (digest) {
+		if (!skipped && parse_and_print_digests(&parser, path, digest > 1))
+			return 4;
+	} else if (shape) {
+		if (parse_and_print_shape(&parser, &emitter, path, skipped, shape_depth, flow))
+			return 4;
+	} else if (!skipped && (raw ? parse_and_print(&parser, path, delimiter) : parse_and_emit(&parser, &emitter, path, flow))) {
 		return 4;
 	}
 
@@ -211,8 +824,13 @@ int main(int argc, char *argv[])
 	yaml_emitter_delete(&emitter);
 
 	yaml_path_destroy(path);
+	yaml_path_input_close(stream);
+	yaml_path_output_close(output);
+	yaml_path_index_close(index);
+	if (input != NULL)
+		munmap((void *)input, input_size);
 	if (file != NULL)
 		fclose(file);
 
-	return 0;
+	return res;
 }
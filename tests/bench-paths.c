@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 Red Hat Inc., Durham, North Carolina.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "yaml-path.h"
+
+// Filter cost per event of the planned matcher and of the generic engine,
+// the events of the file are parsed once and replayed for each path:
+//
+//     bench-paths <file> <path>...
+
+#define BENCH_ROUNDS 7
+#define BENCH_EVENTS (1000 * 1000)
+
+static double
+bench_run (yaml_path_t *path, yaml_parser_t *parser, yaml_event_t *events, size_t count, size_t *selected)
+{
+	size_t repeat = BENCH_EVENTS / count + 1;
+	struct timespec start, end;
+	*selected = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t r = 0; r < repeat; r++)
+		for (size_t i = 0; i < count; i++)
+			*selected += yaml_path_filter_event(path, parser, &events[i]) != YAML_PATH_FILTER_RESULT_OUT;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / (repeat * count);
+}
+
+// Best of the rounds, both engines are expected to select the same events
+static int
+bench_path (char *s_path, yaml_parser_t *parser, yaml_event_t *events, size_t count)
+{
+	double best[2] = {1e9, 1e9};
+	size_t selected[2];
+	for (int generic = 0; generic < 2; generic++) {
+		yaml_path_t *path = yaml_path_create();
+		yaml_path_set_generic(path, generic);
+		if (yaml_path_parse(path, s_path)) {
+			fprintf(stderr, "Invalid path '%s': %s\n", s_path, yaml_path_error_get(path)->message);
+			yaml_path_destroy(path);
+			return 1;
+		}
+		for (int k = 0; k < BENCH_ROUNDS; k++) {
+			double ns = bench_run(path, parser, events, count, &selected[generic]);
+			if (ns < best[generic])
+				best[generic] = ns;
+		}
+		yaml_path_destroy(path);
+	}
+	printf("%-40s planned %6.2f  generic %6.2f ns/event\n", s_path, best[0], best[1]);
+	if (selected[0] != selected[1]) {
+		fprintf(stderr, "Engines differ for '%s': %zu != %zu events\n", s_path, selected[0], selected[1]);
+		return 1;
+	}
+	return 0;
+}
+
+int main (int argc, char *argv[])
+{
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <file> <path>...\n", argv[0]);
+		return 1;
+	}
+	FILE *file = fopen(argv[1], "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open file '%s'\n", argv[1]);
+		return 1;
+	}
+
+	yaml_parser_t parser;
+	yaml_parser_initialize(&parser);
+	yaml_parser_set_input_file(&parser, file);
+	size_t count = 0, alloc = 1024;
+	yaml_event_t *events = malloc(alloc * sizeof(*events));
+	int res = events == NULL;
+	while (!res) {
+		if (count == alloc) {
+			yaml_event_t *grown = realloc(events, alloc * 2 * sizeof(*events));
+			if (grown == NULL) {
+				res = 1;
+				break;
+			}
+			events = grown;
+			alloc *= 2;
+		}
+		if (!yaml_parser_parse(&parser, &events[count])) {
+			fprintf(stderr, "Parser error: %s\n", parser.problem);
+			res = 1;
+			break;
+		}
+		if (events[count++].type == YAML_STREAM_END_EVENT)
+			break;
+	}
+
+	for (int i = 2; i < argc && !res; i++)
+		res = bench_path(argv[i], &parser, events, count);
+
+	for (size_t i = 0; i < count; i++)
+		yaml_event_delete(&events[i]);
+	free(events);
+	yaml_parser_delete(&parser);
+	fclose(file);
+	return res;
+}
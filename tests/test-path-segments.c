@@ -2,11 +2,15 @@
 // Copyright (c) 2020 Red Hat Inc., Durham, North Carolina.
 
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "yaml-path.h"
 
 
 #define PATH_STRING_LEN 1024
+#define PATH_BUNDLE_MAX 256
+#define PATH_BUNDLE_FILE "test-path-segments.ypb"
 
 static int
 test_result = 0;
@@ -14,6 +18,13 @@ test_result = 0;
 static char
 yp_s[PATH_STRING_LEN] = {0};
 
+// Good paths are saved into a bundle at the end
+static yaml_path_t*
+yp_bundle[PATH_BUNDLE_MAX];
+
+static size_t
+yp_bundle_count = 0;
+
 
 #define ASCII_ERR "\033[0;33m"
 #define ASCII_RST "\033[0;0m"
@@ -30,6 +41,10 @@ yp_test (char *p, int expected_failure)
 			test_result++;
 		}
 		printf(" -> %s: %s\n", yp_s, expected_failure ? ASCII_RST"FAILED" : "OK");
+		if (yp_bundle_count < PATH_BUNDLE_MAX) {
+			yp_bundle[yp_bundle_count++] = yp;
+			return;
+		}
 	} else {
 		const yaml_path_error_t *ype = yaml_path_error_get(yp);
 		if (!expected_failure) {
@@ -44,6 +59,44 @@ yp_test (char *p, int expected_failure)
 #define yp_test_good(p)    yp_test(p, 0)
 #define yp_test_invalid(p) yp_test(p, 1)
 
+static void
+yp_test_bundle (void)
+{
+	char s[PATH_STRING_LEN];
+	printf("bundle of %zu paths", yp_bundle_count);
+	int res = yaml_path_bundle_write(PATH_BUNDLE_FILE, yp_bundle, yp_bundle_count);
+	yaml_path_bundle_t *bundle = res ? NULL : yaml_path_bundle_open(PATH_BUNDLE_FILE);
+	if (bundle == NULL || yaml_path_bundle_count(bundle) != yp_bundle_count) {
+		printf(ASCII_ERR" -- unable to write or open: FAILED"ASCII_RST"\n");
+		test_result++;
+	} else {
+		yaml_path_t *yp = yaml_path_create();
+		size_t failed = 0;
+		for (size_t i = 0; i < yp_bundle_count; i++) {
+			yaml_path_snprint(yp_bundle[i], yp_s, PATH_STRING_LEN);
+			if (yaml_path_bundle_get(bundle, i, yp)) {
+				printf(ASCII_ERR"\n%s -- %s"ASCII_RST, yp_s, yaml_path_error_get(yp)->message);
+				failed++;
+				continue;
+			}
+			yaml_path_snprint(yp, s, PATH_STRING_LEN);
+			if (strcmp(s, yp_s)) {
+				printf(ASCII_ERR"\n%s != %s"ASCII_RST, yp_s, s);
+				failed++;
+			}
+		}
+		if (yaml_path_bundle_get(bundle, yp_bundle_count, yp) != -1)
+			failed++;
+		printf(failed ? ": "ASCII_ERR"FAILED"ASCII_RST"\n" : ": OK\n");
+		test_result += failed;
+		yaml_path_destroy(yp);
+	}
+	yaml_path_bundle_close(bundle);
+	unlink(PATH_BUNDLE_FILE);
+	for (size_t i = 0; i < yp_bundle_count; i++)
+		yaml_path_destroy(yp_bundle[i]);
+}
+
 
 int main (int argc, char *argv[])
 {
@@ -87,6 +140,19 @@ int main (int argc, char *argv[])
 	yp_test_good("el.*");
 	yp_test_good("el[*]");
 	yp_test_good("el['*']");
+	yp_test_good(".metadata.labels[~'^app\\.kubernetes\\.io/']");
+	yp_test_good(".data[~\"\\.crt$\"]");
+	yp_test_good("el[~\"it's\"].key");
+	yp_test_good("el[~'^(a|b)[[:digit:]]{2}$']");
+	yp_test_good("el[~'$']");
+	yp_test_good("el[~'x$']");
+
+	yp_test_good("#0");
+	yp_test_good("#5000.metadata.name");
+	yp_test_good("#[1,3]$.key");
+	yp_test_good("#[2:5][0]");
+	yp_test_good("#[2:]&anc");
+	yp_test_good("#[:3].key");
 
 	yp_test_invalid("$$");
 	yp_test_invalid("$&");
@@ -140,5 +206,23 @@ int main (int argc, char *argv[])
 	yp_test_invalid("el['key',invalid]");
 	yp_test_invalid("el['first',]");
 
+	yp_test_invalid("el[~'(']");
+	yp_test_invalid("el[~'']");
+	yp_test_invalid("el[~abc]");
+	yp_test_invalid("el[~'abc'");
+	yp_test_invalid("el[~'abc");
+
+	yp_test_invalid("#");
+	yp_test_invalid("#[]");
+	yp_test_invalid("#-1");
+	yp_test_invalid("#[1,]");
+	yp_test_invalid("#[1:2");
+	yp_test_invalid("#1key");
+	yp_test_invalid("#1#2");
+	yp_test_invalid("$#1");
+	yp_test_invalid("#[:3]key");
+
+	yp_test_bundle();
+
 	return test_result;
 }
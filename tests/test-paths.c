@@ -3,7 +3,9 @@
 
 #include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "yaml-path.h"
 
@@ -19,38 +21,6 @@ rstrip (char *s)
 	}
 }
 
-static const char*
-yp_event_name (yaml_event_type_t event_type)
-{
-	switch (event_type) {
-	case YAML_NO_EVENT:
-		return "no-event";
-	case YAML_STREAM_START_EVENT:
-		return "stream-start-event";
-	case YAML_STREAM_END_EVENT:
-		return "stream-end-event";
-	case YAML_DOCUMENT_START_EVENT:
-		return "document-start-event";
-	case YAML_DOCUMENT_END_EVENT:
-		return "document-end-event";
-	case YAML_ALIAS_EVENT:
-		return "alias-event";
-	case YAML_SCALAR_EVENT:
-		return "scalar-event";
-	case YAML_SEQUENCE_START_EVENT:
-		return "sequence-start-event";
-	case YAML_SEQUENCE_END_EVENT:
-		return "sequence-end-event";
-	case YAML_MAPPING_START_EVENT:
-		return "mapping-start-event";
-	case YAML_MAPPING_END_EVENT:
-		return "mapping-end-event";
-	default:
-		return "unknown-event";
-	}
-}
-
-
 static char*
 yaml;
 
@@ -64,6 +34,23 @@ yaml_out_len = 0;
 static int
 test_result = 0;
 
+// Paths are matched by the generic engine only
+static int
+generic = 0;
+
+
+static yaml_path_t*
+yp_path_create (const char *path)
+{
+	yaml_path_t *yp = yaml_path_create();
+	yaml_path_set_generic(yp, generic);
+	if (yaml_path_parse(yp, (char *)path)) {
+		printf("Path error: %s\n", yaml_path_error_get(yp)->message);
+		yaml_path_destroy(yp);
+		return NULL;
+	}
+	return yp;
+}
 
 static int
 yp_run (char *path)
@@ -72,12 +59,9 @@ yp_run (char *path)
 	yaml_emitter_t emitter;
 	int res = 0;
 
-	yaml_path_t *yp = yaml_path_create();
-	if (yaml_path_parse(yp, path)) {
-		printf("Path error: %s\n", yaml_path_error_get(yp)->message);
-		yaml_path_destroy(yp);
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
 		return 1;
-	}
 
 	//char spath[YAML_STRING_LEN] = {0};
 	//yaml_path_snprint(yp, spath, YAML_STRING_LEN);
@@ -91,117 +75,864 @@ yp_run (char *path)
 	yaml_emitter_set_output_string(&emitter, (unsigned char *)yaml_out, YAML_STRING_LEN, &yaml_out_len);
 	yaml_emitter_set_width(&emitter, -1);
 
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	yaml_path_driver_set_output_emitter(driver, &emitter);
+
+	if (yaml_path_driver_run(driver, yp, &parser)) {
+		const yaml_path_error_t *error = yaml_path_driver_error_get(driver);
+		yaml_emitter_flush(&emitter);
+		printf("%s --> %s error (%s at %zu)", yaml_out, error->type == YAML_PATH_ERROR_INPUT ? "Parser" : "Emitter", error->message, error->pos);
+		res = error->type == YAML_PATH_ERROR_INPUT ? 1 : 2;
+	}
+
+	yaml_path_driver_destroy(driver);
+
+	yaml_parser_delete(&parser);
+	yaml_emitter_delete(&emitter);
+
+	yaml_path_destroy(yp);
+
+	rstrip(yaml_out);
+	return res;
+}
+
+static size_t feed_chunk;
+static int index_seek;
+
+// The input is written to a file, the part holding the matches is parsed
+static int
+yp_run_index (yaml_path_driver_t *driver, yaml_path_t *yp, const char *input)
+{
+	char file_name[] = "/tmp/test-paths-XXXXXX";
+	char index_name[sizeof(file_name) + 4];
+	int fd = mkstemp(file_name);
+	if (fd < 0)
+		return 1;
+	snprintf(index_name, sizeof(index_name), "%s.ypi", file_name);
+	int res = write(fd, input, strlen(input)) != (ssize_t)strlen(input);
+	close(fd);
+
+	yaml_path_index_t *index = NULL;
+	if (!res && !yaml_path_index_build(file_name, index_name, 4))
+		index = yaml_path_index_open(file_name, index_name);
+	if (index != NULL) {
+		yaml_parser_t parser;
+		yaml_parser_initialize(&parser);
+		yaml_path_index_seek(index, yp, &parser);
+		yaml_mark_t start, origin;
+		yaml_path_index_origin_get(index, &start, &origin);
+		yaml_path_driver_set_input_origin(driver, &start, &origin);
+		res = yaml_path_driver_run(driver, yp, &parser);
+		yaml_parser_delete(&parser);
+		yaml_path_index_close(index);
+	} else {
+		printf("Index error\n");
+		res = 1;
+	}
+	unlink(index_name);
+	unlink(file_name);
+	return res;
+}
+
+// The input is pushed in pieces of `feed_chunk`, parsed from an indexed file
+// with `index_seek` (and then as a string with the same path if it's 2), or
+// run as a string
+static int
+yp_driver_run (yaml_path_driver_t *driver, yaml_path_t *yp, const char *input)
+{
+	int res = 0;
+	if (feed_chunk) {
+		size_t size = strlen(input);
+		for (size_t pos = 0; pos < size && !res; pos += feed_chunk) {
+			size_t chunk = size - pos < feed_chunk ? size - pos : feed_chunk;
+			res = yaml_path_driver_feed(driver, yp, (const unsigned char *)input + pos, chunk);
+		}
+		if (!res)
+			res = yaml_path_driver_feed_end(driver, yp);
+	} else if (index_seek) {
+		res = yp_run_index(driver, yp, input);
+		if (!res && index_seek > 1)
+			res = yaml_path_driver_run_string(driver, yp, (const unsigned char *)input, strlen(input));
+	} else {
+		res = yaml_path_driver_run_string(driver, yp, (const unsigned char *)input, strlen(input));
+	}
+	if (res) {
+		printf("Driver error: %s\n", yaml_path_driver_error_get(driver)->message);
+		res = 1;
+	}
+	return res;
+}
+
+static void
+yp_match_handler (void *data, const yaml_path_match_t *match)
+{
+	size_t len = strlen(yaml_out);
+	snprintf(yaml_out + len, YAML_STRING_LEN - len, "%s%.*s", len ? "|" : "",
+	         (int)(match->end_mark.index - match->start_mark.index), yaml + match->start_mark.index);
+	(*(size_t *)data)++;
+}
+
+static int
+yp_run_matches (char *path)
+{
+	yaml_parser_t parser;
 	yaml_event_t event;
-	yaml_event_type_t event_type, prev_event_type = YAML_NO_EVENT;
-	yaml_path_filter_result_t result, prev_result = 0;
+	yaml_event_type_t event_type;
+	size_t matches = 0;
+	int res = 0;
+
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+	yaml_path_set_match_handler(yp, yp_match_handler, &matches);
+
+	yaml_parser_initialize(&parser);
+	yaml_parser_set_input_string(&parser, (const unsigned char *)yaml, strlen(yaml));
+	memset(yaml_out, 0, YAML_STRING_LEN);
 
 	do {
 		if (!yaml_parser_parse(&parser, &event)) {
-			switch (parser.error) {
-			case YAML_MEMORY_ERROR:
-				printf("Memory error: Not enough memory for parsing\n");
-				break;
-			case YAML_READER_ERROR:
-				if (parser.problem_value != -1) {
-					printf("Reader error: %s: #%X at %ld\n", parser.problem, parser.problem_value, (long)parser.problem_offset);
-				} else {
-					printf("Reader error: %s at %ld\n", parser.problem, (long)parser.problem_offset);
-				}
-				break;
-			case YAML_SCANNER_ERROR:
-				if (parser.context) {
-					printf("Scanner error: %s at line %d, column %d\n%s at line %d, column %d\n", parser.context, (int)parser.context_mark.line+1, (int)parser.context_mark.column+1, parser.problem, (int)parser.problem_mark.line+1, (int)parser.problem_mark.column+1);
-				} else {
-					printf("Scanner error: %s at line %d, column %d\n", parser.problem, (int)parser.problem_mark.line+1, (int)parser.problem_mark.column+1);
-				}
-				break;
-			case YAML_PARSER_ERROR:
-				if (parser.context) {
-					printf("Parser error: %s at line %d, column %d\n%s at line %d, column %d\n", parser.context, (int)parser.context_mark.line+1, (int)parser.context_mark.column+1, parser.problem, (int)parser.problem_mark.line+1, (int)parser.problem_mark.column+1);
-				} else {
-					printf("Parser error: %s at line %d, column %d\n", parser.problem, (int)parser.problem_mark.line+1, (int)parser.problem_mark.column+1);
-				}
-				break;
-			default:
-				printf("Internal error\n");
-				break;
-			}
+			printf("Parser error: %s\n", parser.problem);
 			res = 1;
-			goto error;
-		} else {
-			event_type = event.type;
-			result = yaml_path_filter_event(yp, &parser, &event);
-			if (result == YAML_PATH_FILTER_RESULT_OUT) {
-				yaml_event_delete(&event);
-			} else {
-				if ((prev_event_type == YAML_DOCUMENT_START_EVENT && event_type == YAML_DOCUMENT_END_EVENT)
-					|| (prev_result == YAML_PATH_FILTER_RESULT_IN_DANGLING_KEY
-						&& (event_type == YAML_MAPPING_END_EVENT || event_type == YAML_SEQUENCE_END_EVENT || result == YAML_PATH_FILTER_RESULT_IN_DANGLING_KEY))) {
-					yaml_event_t null_event= {0};
-					yaml_scalar_event_initialize(&null_event, NULL, (yaml_char_t *)"!!null", (yaml_char_t *)"null", 4, 1, 0, YAML_ANY_SCALAR_STYLE);
-					yaml_emitter_emit(&emitter, &null_event);
-				}
-				prev_result = result;
-				prev_event_type = event_type;
-				if (!yaml_emitter_emit(&emitter, &event)) {
-					yaml_emitter_flush(&emitter);
-					printf("%s --> Error after '%s': ", yaml_out, yp_event_name(event.type));
-					switch (emitter.error)
-					{
-					case YAML_MEMORY_ERROR:
-						printf("Memory error (Not enough memory for emitting)");
-						break;
-					case YAML_WRITER_ERROR:
-						printf("Writer error (%s)", emitter.problem);
-						break;
-					case YAML_EMITTER_ERROR:
-						printf("Emitter error (%s)", emitter.problem);
-						break;
-					default:
-						printf("Internal error");
-						break;
-					}
-					res = 2;
-					goto error;
-				}
-			}
+			break;
 		}
+		event_type = event.type;
+		yaml_path_filter_event(yp, &parser, &event);
+		yaml_event_delete(&event);
 	} while (event_type != YAML_STREAM_END_EVENT);
 
-error:
 	yaml_parser_delete(&parser);
+	yaml_path_destroy(yp);
+
+	return res;
+}
+
+// Matches found by the driver at their byte offsets (at the marks for the
+// indexed input), with the lines they start at
+static void
+yp_match_line_handler (void *data, const yaml_path_match_t *match)
+{
+	size_t start = match->start_offset, end = match->end_offset;
+	if (start == SIZE_MAX) {
+		start = match->start_mark.index;
+		end = match->end_mark.index;
+	}
+	size_t len = strlen(yaml_out);
+	snprintf(yaml_out + len, YAML_STRING_LEN - len, "%s%.*s@%zu", len ? "|" : "",
+	         (int)(end - start), yaml + start, match->start_mark.line);
+	(*(size_t *)data)++;
+}
+
+static int
+yp_run_driver_matches (char *path)
+{
+	size_t matches = 0;
+
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+	yaml_path_set_match_handler(yp, yp_match_line_handler, &matches);
+
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+
+	memset(yaml_out, 0, YAML_STRING_LEN);
+	int res = yp_driver_run(driver, yp, yaml);
+
+	yaml_path_driver_destroy(driver);
+	yaml_path_destroy(yp);
+
+	return res;
+}
+
+static int
+yp_event_handler (void *data, yaml_event_t *event)
+{
+	size_t len = strlen(yaml_out);
+	switch (event->type) {
+	case YAML_SCALAR_EVENT:
+		snprintf(yaml_out + len, YAML_STRING_LEN - len, "%s ", event->data.scalar.value);
+		break;
+	case YAML_ALIAS_EVENT:
+		snprintf(yaml_out + len, YAML_STRING_LEN - len, "*%s ", event->data.alias.anchor);
+		break;
+	case YAML_SEQUENCE_START_EVENT:
+		snprintf(yaml_out + len, YAML_STRING_LEN - len, "[ ");
+		break;
+	case YAML_SEQUENCE_END_EVENT:
+		snprintf(yaml_out + len, YAML_STRING_LEN - len, "] ");
+		break;
+	case YAML_MAPPING_START_EVENT:
+		snprintf(yaml_out + len, YAML_STRING_LEN - len, "{ ");
+		break;
+	case YAML_MAPPING_END_EVENT:
+		snprintf(yaml_out + len, YAML_STRING_LEN - len, "} ");
+		break;
+	default:
+		break;
+	}
+	(*(size_t *)data)++;
+	return 1;
+}
+
+static int
+yp_run_events (char *path)
+{
+	size_t events = 0;
+
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	yaml_path_driver_set_output_handler(driver, yp_event_handler, &events);
+
+	memset(yaml_out, 0, YAML_STRING_LEN);
+	int res = yp_driver_run(driver, yp, yaml);
+	rstrip(yaml_out);
+
+	yaml_path_driver_destroy(driver);
+	yaml_path_destroy(yp);
+
+	return res;
+}
+
+// Events sent while the input is pushed in pieces of 3, and (after '|') at
+// its end
+static int
+yp_run_feed (char *path)
+{
+	size_t events = 0;
+
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	yaml_path_driver_set_output_handler(driver, yp_event_handler, &events);
+
+	memset(yaml_out, 0, YAML_STRING_LEN);
+	int res = 0;
+	size_t size = strlen(yaml);
+	for (size_t pos = 0; pos < size && !res; pos += 3)
+		res = yaml_path_driver_feed(driver, yp, (const unsigned char *)yaml + pos, size - pos < 3 ? size - pos : 3);
+	strcat(yaml_out, "| ");
+	if (!res)
+		res = yaml_path_driver_feed_end(driver, yp);
+	if (res)
+		printf("Driver error: %s\n", yaml_path_driver_error_get(driver)->message);
+	rstrip(yaml_out);
+
+	yaml_path_driver_destroy(driver);
+	yaml_path_destroy(yp);
+
+	return res;
+}
+
+static int
+yp_run_values (char *path)
+{
+	char buffer[8];
+	yaml_path_values_t values;
+	yaml_path_values_init(&values, buffer, sizeof(buffer));
+
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+	yaml_path_set_value_handler(yp, yaml_path_values_handler, &values);
+
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	yaml_path_driver_set_output_handler(driver, NULL, NULL);
+
+	int res = yp_driver_run(driver, yp, yaml) || values.error;
+	memset(yaml_out, 0, YAML_STRING_LEN);
+	for (size_t i = 0; i < values.count; i++) {
+		size_t len = strlen(yaml_out);
+		const char *quote = values.items[i].style == YAML_PLAIN_SCALAR_STYLE ? "" : "'";
+		snprintf(yaml_out + len, YAML_STRING_LEN - len, "%s%s%s%s ", values.items[i].tag != NULL ? values.items[i].tag : "",
+		         quote, values.items[i].value, quote);
+	}
+
+	rstrip(yaml_out);
+
+	yaml_path_driver_destroy(driver);
+	yaml_path_destroy(yp);
+	yaml_path_values_delete(&values);
+
+	return res;
+}
+
+static int
+yp_run_column (char *path, yaml_path_column_type_t type)
+{
+	yaml_path_column_t column;
+	yaml_path_column_init(&column, type);
+
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+	yaml_path_set_value_handler(yp, yaml_path_column_handler, &column);
+
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	yaml_path_driver_set_output_handler(driver, NULL, NULL);
+
+	int res = yp_driver_run(driver, yp, yaml) || column.error;
+	memset(yaml_out, 0, YAML_STRING_LEN);
+	for (size_t i = 0; i < column.count; i++) {
+		size_t len = strlen(yaml_out);
+		if (!(column.validity[i / 8] & 1 << i % 8))
+			snprintf(yaml_out + len, YAML_STRING_LEN - len, "- ");
+		else if (type == YAML_PATH_COLUMN_INT64)
+			snprintf(yaml_out + len, YAML_STRING_LEN - len, "%lld ", (long long)column.data.ints[i]);
+		else if (type == YAML_PATH_COLUMN_DOUBLE)
+			snprintf(yaml_out + len, YAML_STRING_LEN - len, "%g ", column.data.doubles[i]);
+		else
+			snprintf(yaml_out + len, YAML_STRING_LEN - len, "%d ", column.data.bools[i / 8] >> i % 8 & 1);
+	}
+
+	rstrip(yaml_out);
+
+	yaml_path_driver_destroy(driver);
+	yaml_path_destroy(yp);
+	yaml_path_column_delete(&column);
+
+	return res;
+}
+
+// Values (joined from chunks) are hashed in the order of the handler calls
+static int
+yp_chunk_hash_handler (void *data, const yaml_path_value_t *chunk, int last)
+{
+	size_t *hash = data;
+	for (size_t i = 0; i < chunk->length; i++)
+		*hash = *hash * 31 + (unsigned char)chunk->value[i];
+	if (last)
+		*hash = *hash * 31 + chunk->start_mark.index;
+	return 1;
+}
+
+static void
+yp_value_hash_handler (void *data, const yaml_path_value_t *value)
+{
+	yp_chunk_hash_handler(data, value, 1);
+}
+
+// Block scalars of at least this size are decoded by the driver (and passed
+// to the chunk handler)
+static size_t limits_blocks;
+
+static int
+yp_run_limits (char *path, const yaml_path_limits_t *limits, int emit)
+{
+	size_t events = 0;
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return -1;
+
+	yaml_emitter_t emitter;
+	yaml_emitter_initialize(&emitter);
+	size_t written;
+	yaml_emitter_set_output_string(&emitter, (unsigned char *)yaml_out, YAML_STRING_LEN - 1, &written);
+
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	if (emit > 0)
+		yaml_path_driver_set_output_emitter(driver, &emitter);
+	else if (emit == 0)
+		yaml_path_driver_set_output_handler(driver, yp_event_handler, &events);
+	yaml_path_driver_set_limits(driver, limits);
+	size_t hash = 0;
+	if (limits_blocks) {
+		yaml_path_set_value_handler(yp, yp_value_hash_handler, &hash);
+		yaml_path_driver_set_chunk_handler(driver, limits_blocks, yp_chunk_hash_handler, &hash);
+	}
+
+	memset(yaml_out, 0, YAML_STRING_LEN);
+	yaml_path_driver_run_string(driver, yp, (const unsigned char *)yaml, strlen(yaml));
+	int res = yaml_path_driver_error_get(driver)->type;
+
+	yaml_path_driver_destroy(driver);
 	yaml_emitter_delete(&emitter);
+	yaml_path_destroy(yp);
+
+	return res;
+}
+
+static int
+yp_run_count (char *path, size_t limit, size_t *count)
+{
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+
+	yaml_parser_t parser;
+	yaml_parser_initialize(&parser);
+	yaml_parser_set_input_string(&parser, (const unsigned char *)yaml, strlen(yaml));
+
+	// The match handler of the path is kept for the following runs
+	size_t matches = 0;
+	yaml_path_set_match_handler(yp, yp_match_handler, &matches);
+
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	yaml_path_driver_set_output_handler(driver, NULL, NULL);
+	int res = yaml_path_driver_count(driver, yp, &parser, limit, count);
+	yaml_parser_delete(&parser);
+
+	memset(yaml_out, 0, YAML_STRING_LEN);
+	yaml_parser_initialize(&parser);
+	yaml_parser_set_input_string(&parser, (const unsigned char *)yaml, strlen(yaml));
+	if (!res && (matches || yaml_path_driver_run(driver, yp, &parser) || matches < *count)) {
+		printf("Match handler replaced ");
+		res = 1;
+	}
 
+	yaml_path_driver_destroy(driver);
+	yaml_parser_delete(&parser);
 	yaml_path_destroy(yp);
 
 	return res;
 }
 
-#define ASCII_ERR "\033[0;33m"
-#define ASCII_RST "\033[0;0m"
+// Count the events filtered inside of matched containers
+static int
+yp_run_passthrough (char *path, size_t *events)
+{
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+
+	yaml_parser_t parser;
+	yaml_event_t event;
+	yaml_event_type_t event_type;
+	int res = 0;
+	yaml_parser_initialize(&parser);
+	yaml_parser_set_input_string(&parser, (const unsigned char *)yaml, strlen(yaml));
+
+	*events = 0;
+	do {
+		if (!yaml_parser_parse(&parser, &event)) {
+			printf("Parser error: %s\n", parser.problem);
+			res = 1;
+			break;
+		}
+		event_type = event.type;
+		// Events within the container are passed (its start sets the level)
+		size_t level = yaml_path_passthrough_get(yp);
+		if (yaml_path_filter_event(yp, &parser, &event) != YAML_PATH_FILTER_RESULT_OUT && level)
+			(*events)++;
+		yaml_event_delete(&event);
+	} while (event_type != YAML_STREAM_END_EVENT);
+
+	yaml_parser_delete(&parser);
+	yaml_path_destroy(yp);
+
+	return res;
+}
+
+// Hash of the filtered events with their positions in the input
+static int
+yp_hash_handler (void *data, yaml_event_t *event)
+{
+	size_t *hash = data;
+	*hash = *hash * 31 + event->type;
+	*hash = *hash * 31 + event->start_mark.index;
+	if (event->type == YAML_SCALAR_EVENT) {
+		for (size_t i = 0; i < event->data.scalar.length; i++)
+			*hash = *hash * 31 + event->data.scalar.value[i];
+	}
+	return 1;
+}
+
+static int
+yp_run_parallel (char *path, const char *input, size_t threads, size_t *hash)
+{
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+
+	*hash = 0;
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	yaml_path_driver_set_output_handler(driver, yp_hash_handler, hash);
+	yaml_path_driver_set_threads(driver, threads);
+	int res = yp_driver_run(driver, yp, input);
+
+	yaml_path_driver_destroy(driver);
+	yaml_path_destroy(yp);
+
+	return res;
+}
+
+static int
+yp_run_blocks (char *path, const char *input, size_t min_size, int chunks, size_t *hash)
+{
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+
+	*hash = 0;
+	yaml_path_set_value_handler(yp, yp_value_hash_handler, hash);
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	yaml_path_driver_set_output_handler(driver, yp_hash_handler, hash);
+	yaml_path_driver_set_chunk_handler(driver, min_size, chunks ? yp_chunk_hash_handler : NULL, hash);
+	int res = yp_driver_run(driver, yp, input);
+
+	yaml_path_driver_destroy(driver);
+	yaml_path_destroy(yp);
+
+	return res;
+}
+
+#define YP_DIGESTS_MAX 26
+
+typedef struct yp_digests {
+	unsigned char items[YP_DIGESTS_MAX][YAML_PATH_DIGEST_SIZE];
+	size_t count;
+	char classes[YP_DIGESTS_MAX + 1]; // Same letters for equal digests
+} yp_digests_t;
 
 static void
-yp_test (char *path, char *yaml_exp)
+yp_digest_handler (void *data, const unsigned char *digest)
 {
-	printf("%s "ASCII_ERR, path);
-	if (!yp_run(path)) {
-		rstrip(yaml_out);
-		if (!strcmp(yaml_exp, yaml_out)) {
-			printf(ASCII_RST"(%s): OK\n", yaml_exp);
-			return;
+	yp_digests_t *digests = data;
+	if (digests->count == YP_DIGESTS_MAX)
+		return;
+	size_t i = 0;
+	while (i < digests->count && memcmp(digests->items[i], digest, YAML_PATH_DIGEST_SIZE))
+		i++;
+	memcpy(digests->items[digests->count], digest, YAML_PATH_DIGEST_SIZE);
+	digests->classes[digests->count] = i < digests->count ? digests->classes[i] : (char)('a' + digests->count);
+	digests->classes[++digests->count] = '\0';
+}
+
+static int
+yp_run_digests (char *path, const char *input, int sort_keys, yp_digests_t *digests)
+{
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+
+	memset(digests, 0, sizeof(*digests));
+	yaml_path_digest_t digest;
+	yaml_path_digest_init(&digest, sort_keys, yp_digest_handler, digests);
+	yaml_path_set_node_handler(yp, yaml_path_digest_node_handler, &digest);
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	yaml_path_driver_set_output_handler(driver, NULL, NULL);
+	int res = yp_driver_run(driver, yp, input);
+	if (digest.error)
+		res = 1;
+
+	yaml_path_driver_destroy(driver);
+	yaml_path_digest_delete(&digest);
+	yaml_path_destroy(yp);
+
+	return res;
+}
+
+static int
+yp_run_shape (char *path, const char *input, size_t max_depth)
+{
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+
+	yaml_path_shape_t shape;
+	yaml_path_shape_init(&shape, max_depth);
+	yaml_path_set_node_handler(yp, yaml_path_shape_node_handler, &shape);
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	yaml_path_driver_set_output_handler(driver, NULL, NULL);
+	int res = yp_driver_run(driver, yp, input);
+	if (shape.error)
+		res = 1;
+
+	yaml_emitter_t emitter;
+	yaml_emitter_initialize(&emitter);
+	memset(yaml_out, 0, YAML_STRING_LEN);
+	yaml_emitter_set_output_string(&emitter, (unsigned char *)yaml_out, YAML_STRING_LEN, &yaml_out_len);
+	yaml_emitter_set_width(&emitter, -1);
+	if (!res && yaml_path_shape_emit(&shape, &emitter, 1))
+		res = 1;
+
+	rstrip(yaml_out);
+
+	yaml_emitter_delete(&emitter);
+	yaml_path_driver_destroy(driver);
+	yaml_path_shape_delete(&shape);
+	yaml_path_destroy(yp);
+
+	return res;
+}
+
+static void
+yp_dom_print (const yaml_path_dom_node_t *node)
+{
+	const char *anchor = node->type != YAML_PATH_DOM_ALIAS ? node->anchor : NULL;
+	size_t len = strlen(yaml_out);
+	snprintf(yaml_out + len, YAML_STRING_LEN - len, "%s%s%s%s%s",
+	         node->tag != NULL ? node->tag : "", node->tag != NULL ? " " : "",
+	         anchor != NULL ? "&" : "", anchor != NULL ? anchor : "", anchor != NULL ? " " : "");
+	len = strlen(yaml_out);
+	switch (node->type) {
+	case YAML_PATH_DOM_SCALAR:
+		snprintf(yaml_out + len, YAML_STRING_LEN - len, "%s", node->value);
+		break;
+	case YAML_PATH_DOM_ALIAS:
+		snprintf(yaml_out + len, YAML_STRING_LEN - len, "*%s", node->anchor);
+		break;
+	case YAML_PATH_DOM_SEQUENCE:
+	case YAML_PATH_DOM_MAPPING: {
+			int mapping = node->type == YAML_PATH_DOM_MAPPING;
+			snprintf(yaml_out + len, YAML_STRING_LEN - len, mapping ? "{" : "[");
+			for (size_t i = 0; i < node->length; i++) {
+				len = strlen(yaml_out);
+				if (i)
+					snprintf(yaml_out + len, YAML_STRING_LEN - len, mapping && i % 2 ? ": " : ", ");
+				yp_dom_print(&node->children[i]);
+			}
+			len = strlen(yaml_out);
+			snprintf(yaml_out + len, YAML_STRING_LEN - len, mapping ? "}" : "]");
 		}
-		printf("(%s != %s)"ASCII_RST": FAILED\n", yaml_exp, yaml_out);
+		break;
+	}
+}
+
+// Matched nodes separated by '|', or the value of the key in the first one
+static int
+yp_run_dom (char *path, const char *input, const char *key)
+{
+	yaml_path_t *yp = yp_path_create(path);
+	if (yp == NULL)
+		return 1;
+
+	yaml_path_dom_t dom;
+	yaml_path_dom_init(&dom);
+	yaml_path_set_node_handler(yp, yaml_path_dom_node_handler, &dom);
+	yaml_path_driver_t *driver = yaml_path_driver_create();
+	yaml_path_driver_set_output_handler(driver, NULL, NULL);
+	int res = yp_driver_run(driver, yp, input);
+	if (dom.error)
+		res = 1;
+
+	memset(yaml_out, 0, YAML_STRING_LEN);
+	if (key != NULL) {
+		const yaml_path_dom_node_t *node = yaml_path_dom_mapping_get(dom.count ? &dom.roots[0] : NULL, key);
+		if (node != NULL)
+			yp_dom_print(node);
 	} else {
+		for (size_t i = 0; i < dom.count; i++) {
+			if (i)
+				strcat(yaml_out, "|");
+			yp_dom_print(&dom.roots[i]);
+		}
+	}
+
+	yaml_path_driver_destroy(driver);
+	yaml_path_dom_delete(&dom);
+	yaml_path_destroy(yp);
+
+	return res;
+}
+
+#define YP_LOCATIONS_MAX 16
+
+// Positions are "line:column" or "@index" separated by spaces, the paths
+// found are separated by '|' ('-' if the position wasn't reached)
+static int
+yp_run_locate (const char *input, const char *positions)
+{
+	yaml_path_location_t locations[YP_LOCATIONS_MAX];
+	char paths[YP_LOCATIONS_MAX][64];
+	size_t count = 0;
+	int len = 0;
+	memset(locations, 0, sizeof(locations));
+	for (const char *p = positions; count < YP_LOCATIONS_MAX && *p; p += len) {
+		yaml_path_location_t *location = &locations[count];
+		if (sscanf(p, " @%zu%n", &location->index, &len) != 1) {
+			if (sscanf(p, " %zu:%zu%n", &location->line, &location->column, &len) != 2)
+				break;
+			location->by_line = 1;
+		}
+		location->path = paths[count];
+		location->path_size = sizeof(paths[count]);
+		count++;
+	}
+
+	yaml_parser_t parser;
+	yaml_parser_initialize(&parser);
+	yaml_parser_set_input_string(&parser, (const unsigned char *)input, strlen(input));
+	int res = yaml_path_locate(&parser, locations, count);
+	yaml_parser_delete(&parser);
+
+	memset(yaml_out, 0, YAML_STRING_LEN);
+	for (size_t i = 0; i < count; i++) {
+		size_t out_len = strlen(yaml_out);
+		snprintf(yaml_out + out_len, YAML_STRING_LEN - out_len, "%s%s", i ? "|" : "", locations[i].path_length ? locations[i].path : "-");
+	}
+	return res;
+}
+
+#define ASCII_ERR "\033[0;33m"
+#define ASCII_RST "\033[0;0m"
+
+// Compare the output of the run (`res` is its result) with the expected one
+static void
+yp_report (int res, const char *exp, const char *out)
+{
+	if (res) {
 		printf(ASCII_RST": ERROR\n");
+	} else if (strcmp(exp, out)) {
+		printf("(%s != %s)"ASCII_RST": FAILED\n", exp, out);
+	} else {
+		printf(ASCII_RST"(%s): OK\n", exp);
+		return;
 	}
 	test_result++;
 }
 
+static void
+yp_report_size (int res, size_t exp, size_t out)
+{
+	char exp_s[32], out_s[32];
+	snprintf(exp_s, sizeof(exp_s), "%zu", exp);
+	snprintf(out_s, sizeof(out_s), "%zu", out);
+	yp_report(res, exp_s, out_s);
+}
 
-int main (int argc, char *argv[])
+static void
+yp_test (char *path, char *yaml_exp)
 {
-    (void) argc; (void) argv; // Yep, we don't need them
+	printf("%s "ASCII_ERR, path);
+	yp_report(yp_run(path), yaml_exp, yaml_out);
+}
+
+static void
+yp_test_matches (char *path, char *matches_exp)
+{
+	printf("%s (matches) "ASCII_ERR, path);
+	yp_report(yp_run_matches(path), matches_exp, yaml_out);
+}
+
+static void
+yp_test_driver_matches (char *path, char *matches_exp)
+{
+	printf("%s (driver matches) "ASCII_ERR, path);
+	yp_report(yp_run_driver_matches(path), matches_exp, yaml_out);
+}
+
+static void
+yp_test_events (char *path, char *events_exp)
+{
+	printf("%s (events) "ASCII_ERR, path);
+	yp_report(yp_run_events(path), events_exp, yaml_out);
+}
+
+static void
+yp_test_feed (char *path, char *events_exp)
+{
+	printf("%s (feed) "ASCII_ERR, path);
+	yp_report(yp_run_feed(path), events_exp, yaml_out);
+}
+
+static void
+yp_test_values (char *path, char *values_exp)
+{
+	printf("%s (values) "ASCII_ERR, path);
+	yp_report(yp_run_values(path), values_exp, yaml_out);
+}
+
+static void
+yp_test_column (char *path, yaml_path_column_type_t type, char *column_exp)
+{
+	printf("%s (column) "ASCII_ERR, path);
+	yp_report(yp_run_column(path, type), column_exp, yaml_out);
+}
+
+static void
+yp_test_count (char *path, size_t limit, size_t count_exp)
+{
+	size_t count = 0;
+	printf("%s (count) "ASCII_ERR, path);
+	int res = yp_run_count(path, limit, &count);
+	yp_report_size(res, count_exp, count);
+}
+
+static void
+yp_test_passthrough (char *path, size_t events_exp)
+{
+	size_t events = 0;
+	printf("%s (passthrough) "ASCII_ERR, path);
+	int res = yp_run_passthrough(path, &events);
+	yp_report_size(res, events_exp, events);
+}
+
+// Same events are expected from the serial and the parallel run
+static void
+yp_test_parallel (char *path, const char *input, size_t threads)
+{
+	size_t hash_exp = 0, hash = 0;
+	printf("%s (%zu threads) "ASCII_ERR, path, threads);
+	int res = yp_run_parallel(path, input, 1, &hash_exp) || yp_run_parallel(path, input, threads, &hash);
+	yp_report_size(res, hash_exp, hash);
+}
+
+static void
+yp_test_blocks (char *path, const char *input, size_t min_size, int chunks)
+{
+	size_t hash_exp = 0, hash = 0;
+	printf("%s (blocks of %zu%s) "ASCII_ERR, path, min_size, chunks ? " in chunks" : "");
+	int res = yp_run_blocks(path, input, 0, 0, &hash_exp) || yp_run_blocks(path, input, min_size, chunks, &hash);
+	yp_report_size(res, hash_exp, hash);
+}
+
+static void
+yp_test_limits (char *path, const yaml_path_limits_t *limits, int emit, int error_exp)
+{
+	printf("%s (limits) "ASCII_ERR, path);
+	int error = yp_run_limits(path, limits, emit);
+	yp_report_size(error < 0, error_exp, error);
+}
+
+static void
+yp_test_digests (char *path, const char *input, int sort_keys, char *classes_exp)
+{
+	yp_digests_t digests;
+	printf("%s (digests%s) "ASCII_ERR, path, sort_keys ? " of sorted keys" : "");
+	int res = yp_run_digests(path, input, sort_keys, &digests);
+	yp_report(res, classes_exp, digests.classes);
+}
+
+static void
+yp_test_shape (char *path, const char *input, size_t max_depth, char *yaml_exp)
+{
+	printf("%s (shape of %zu levels) "ASCII_ERR, path, max_depth);
+	yp_report(yp_run_shape(path, input, max_depth), yaml_exp, yaml_out);
+}
 
+static void
+yp_test_dom (char *path, const char *input, const char *key, char *yaml_exp)
+{
+	printf("%s (DOM%s%s) "ASCII_ERR, path, key != NULL ? " of key " : "", key != NULL ? key : "");
+	yp_report(yp_run_dom(path, input, key), yaml_exp, yaml_out);
+}
+
+static void
+yp_test_locate (const char *input, const char *positions, char *paths_exp)
+{
+	printf("%s (locate) "ASCII_ERR, positions);
+	yp_report(yp_run_locate(input, positions), paths_exp, yaml_out);
+}
+
+static void
+yp_test_prefilter (char *path, const char *input, int res_exp)
+{
+	printf("%s (prefilter) "ASCII_ERR, path);
+	yaml_path_t *yp = yp_path_create(path);
+	int res = yp != NULL ? yaml_path_prefilter(yp, (const unsigned char *)input, strlen(input)) : 0;
+	yaml_path_destroy(yp);
+	yp_report_size(yp == NULL, res_exp, res);
+}
+
+
+static void
+yp_tests (void)
+{
 	yaml =
 		"{"
 			"first: {"
@@ -244,6 +975,8 @@ int main (int argc, char *argv[])
 	yp_test(".first.Arr[:][2]",          "[6]");
 	yp_test(".first.Arr[:][0,1]",        "[[11, 12], ['31', '32'], [4, 5]]");
 	yp_test(".first.Arr[:][1]",          "[12, '32', 5]");
+	yp_test(".first.Arr[0,2][1]",        "[12, '32']");
+	yp_test(".3rd[:].a.A[1]",            "[1]");
 	yp_test(".second[2].abc",            "null");
 	yp_test(".second[0].z",              "*anc");
 	yp_test("&anc",                      "&anc [1, 2]");
@@ -257,6 +990,325 @@ int main (int argc, char *argv[])
 	yp_test(".second[:]['abc','def'][:]","[{'abc': &anc [1, 2], 'def': [11, 22]}, {'abc': [3, 4], 'def': null}]");
 	yp_test(".second[0]['abc','def']",   "{'abc': &anc [1, 2], 'def': [11, 22]}");
 	yp_test(".3rd[:].*.*[:]",            "[{'a': {'A': [0, 1], 'AA': [2, 3]}, 'b': {'A': [10, 11], 'BB': [9, 8]}}, {'z': {'A': [0, 1], 'BB': [22, 33]}}, &x {'q': null}]");
+	yp_test(".second[0][~'^ab']",        "{'abc': &anc [1, 2], 'abcdef': 2}");
+	yp_test(".second[:][~'def$']",       "[{'def': [11, 22], 'abcdef': 2}, {'def': {'z': '!'}, 'abcdef': 4}]");
+	yp_test(".second[0][~'^(abc|q)$']",  "{'abc': &anc [1, 2], 'q': 'Q'}");
+	yp_test(".second[0][~'^xyz$']",      "{}");
+	yp_test(".first.Arr[4][~'$']",       "{'k': 'val', 0: 0}");
+	yp_test(".first.Arr[4][~'k$']",      "{'k': 'val'}");
+	yp_test(".first.Arr[4][~'^']",       "{'k': 'val', 0: 0}");
+	yp_test(".first[~'^[A-Z]a'].*",      "{'Map': {1: '1'}}");
+	yp_test(".first.Arr[4][~'k']",       "{'k': 'val'}");
+
+
+	//                Path                        Matched nodes in the source YAML
+
+	yp_test_matches("$.first.Map",               "{1: '1'}");
+	yp_test_matches(".first.Arr[:][0]",          "11|'31'|4");
+	yp_test_matches(".first.Arr[:].k",           "'val'");
+	yp_test_matches(".second[2].abc",            "");
+	yp_test_matches(".second[0].z",              "*anc");
+	yp_test_matches("&anc",                      "&anc [1, 2]");
+	yp_test_matches(".second[:]['abc','q']",     "&anc [1, 2]|'Q'|[3, 4]");
+	yp_test_matches(".3rd[:].*.A",               "[0, 1]|[10, 11]|[0, 1]");
+	yp_test_matches(".3rd[:][~'^[ab]$'].A",      "[0, 1]|[10, 11]");
+
+	yp_test_count(".first.Arr[:][0]",            0, 3);
+	yp_test_count(".first.Arr[:][0]",            1, 1);
+	yp_test_count(".second[:]['abc','q']",       2, 2);
+	yp_test_count(".second[2].abc",              1, 0);
+
+	yp_test_passthrough(".first.Map",            3);
+	yp_test_passthrough(".first.Arr[:]",         18);
+	yp_test_passthrough(".second[:]['abc','q']", 6);
+	yp_test_passthrough(".first.Nop",            0);
+
+	//               Path                         Filtered events passed to the handler
+
+	yp_test_events(".first.Arr[:][0]",           "[ 11 31 4 ]");
+	yp_test_events(".second[2].abc",             "null");
+	yp_test_events(".second[:]['abc','def'].z",  "[ { abc null def null } { abc null def ! } ]");
+
+	yp_test_values(".first.Arr[:][0]",           "11 '31' 4");
+	yp_test_values(".first.Arr[0,3][:]",         "11 12 4 5 6 7 8 9");
+	yp_test_values(".first.Arr",                 "");
+	yp_test_values(".first['Nop','Yep']",        "0 '1'");
+	yp_test_values(".second[:].z",               "'zzz'");
+	yp_test_values("&anc[:]",                    "1 2");
+
+	yp_test_limits(".first",   &(yaml_path_limits_t){.max_depth = 5}, 0, YAML_PATH_ERROR_NONE);
+	yp_test_limits(".first",   &(yaml_path_limits_t){.max_depth = 4}, 0, YAML_PATH_ERROR_LIMIT_DEPTH);
+	yp_test_limits(".first",   &(yaml_path_limits_t){.max_events = 20}, 0, YAML_PATH_ERROR_LIMIT_EVENTS);
+	yp_test_limits(".first",   &(yaml_path_limits_t){.max_scalar_length = 2}, 0, YAML_PATH_ERROR_LIMIT_SCALAR);
+	yp_test_limits(".first",   &(yaml_path_limits_t){.max_output_bytes = 10}, 0, YAML_PATH_ERROR_LIMIT_OUTPUT);
+	yp_test_limits(".first",   &(yaml_path_limits_t){.max_output_bytes = 10}, 1, YAML_PATH_ERROR_LIMIT_OUTPUT);
+	yp_test_limits(".first",   &(yaml_path_limits_t){.max_output_bytes = 1000}, 1, YAML_PATH_ERROR_NONE);
+	yp_test_limits(".first",   &(yaml_path_limits_t){.timeout_ms = 1000}, 0, YAML_PATH_ERROR_NONE);
+
+	// The clock is checked only every few hundred events
+	char *yaml_saved = yaml;
+	size_t deadline_items = 500000;
+	char *deadline_input = malloc(deadline_items * 3 + 2);
+	if (deadline_input != NULL) {
+		deadline_input[0] = '[';
+		for (size_t i = 0; i < deadline_items; i++)
+			memcpy(deadline_input + 1 + i * 3, "0, ", 3);
+		strcpy(deadline_input + deadline_items * 3 - 1, "]");
+		yaml = deadline_input;
+		yp_test_limits("[0]",  &(yaml_path_limits_t){.timeout_ms = 1}, 0, YAML_PATH_ERROR_LIMIT_DEADLINE);
+		yaml = yaml_saved;
+		free(deadline_input);
+	}
+
+	// Equal digests are marked by the same letters
+	const char *digest_input =
+		"- {a: 1, b: [true, ~, 's']}\n"
+		"- {\"a\": 0x1, b: [True, null, s]}\n"
+		"- b: [TRUE, '', s]\n"
+		"  a: 1\n"
+		"- {b: [true, ~, 's'], a: 1.0}\n"
+		"- !map {a: 1, b: [true, ~, 's']}\n"
+		"- &x {b: [true, ~, s], a: !!int '1'}\n"
+		"- *x\n"
+		"- {a: -0.0, b: {y: .NaN, x: [{q: 1, p: 2}]}}\n"
+		"- {b: {x: [{p: 2, q: 1}], y: .nan}, a: 0.0}\n";
+	yp_test_digests("[:]",                digest_input, 0, "aacdefghi");
+	yp_test_digests("[:]",                digest_input, 1, "aacdeaghh");
+	yp_test_digests("[:].b",              digest_input, 0, "aacaaagh");
+	yp_test_digests("[0,4].b[:]",         digest_input, 0, "abcabc");
+	yp_test_digests("[:]",                "[5, ! 5, '5', !!str 5]", 0, "abbb");
+
+	const char *shape_input =
+		"- {name: a, ports: [{port: 80}, {port: 443, tls: true}]}\n"
+		"- {name: b, ports: [], [complex]: key}\n"
+		"- &x {name: c, labels: {app: x}}\n"
+		"- *x\n"
+		"- 5\n";
+	yp_test_shape("[:]",                  shape_input, 0, "{mapping: 3, pairs: 7, scalar: 1, alias: 1, keys: {name: {scalar: 3}, ports: {sequence: 2, items: 2, item: {mapping: 2, pairs: 3, keys: {port: {scalar: 2}, tls: {scalar: 1}}}}, labels: {mapping: 1, pairs: 1, keys: {app: {scalar: 1}}}}, other: {scalar: 1}}");
+	yp_test_shape("$",                    shape_input, 2, "{sequence: 1, items: 5, item: {mapping: 3, pairs: 7, scalar: 1, alias: 1}}");
+	yp_test_shape("[1].ports",            shape_input, 0, "{sequence: 1}");
+	yp_test_shape(".missing",             shape_input, 0, "{}");
+
+	const char *dom_input =
+		"items:\n"
+		"- {name: a, ports: [80, 443], &p spec: !t {x: ''}}\n"
+		"- {name: b, ports: [], ref: *p, [c]: d}\n"
+		"- name: " "0123456789012345678901234567890123456789012345678901234567890123456789\n"
+		"other: [1, 2, 3]\n";
+	yp_test_dom(".items[:]",              dom_input, NULL,  "{name: a, ports: [80, 443], &p spec: !t {x: }}|{name: b, ports: [], ref: *p, [c]: d}|{name: 0123456789012345678901234567890123456789012345678901234567890123456789}");
+	yp_test_dom(".items[:].ports",        dom_input, NULL,  "[80, 443]|[]");
+	yp_test_dom(".items[1]",              dom_input, "ref", "*p");
+	yp_test_dom(".items[0]",              dom_input, "spec", "!t {x: }");
+	yp_test_dom(".items[0]",              dom_input, "nope", "");
+	yp_test_dom(".missing",               dom_input, NULL,  "");
+
+	const char *locate_input =
+		"spec:\n"
+		"  containers:\n"
+		"  - name: a\n"
+		"    image: x\n"
+		"  - {name: b, image: 'y'}\n"
+		"  - name: c\n"
+		"    image: z   # here\n"
+		"  'a.b': [1, *q]\n"
+		"  [complex]: {k: v}\n"
+		"---\n"
+		"- [2, 3]\n"
+		"}\n";
+	yp_test_locate(locate_input, "6:11 2:6 0:0",                     ".spec.containers[2].image|.spec.containers[0].name|.spec");
+	yp_test_locate(locate_input, "4:0 4:15 @67 6:15",                ".spec.containers[1]|.spec.containers[1].image|.spec.containers[1].image|.spec.containers[2]");
+	yp_test_locate(locate_input, "1:2 7:0 7:12 8:14",                ".spec.containers|.spec['a.b']|.spec['a.b'][1]|.spec");
+	yp_test_locate(locate_input, "9:0 10:5 3:4",                     "#1|#1[0][1]|.spec.containers[0].image");
+	yp_test_locate("a: [1, 2]\nb: }\n", "0:4",                       ".a[0]");
+	yp_test_locate("a: 1\n", "0:3 5:0",                              ".a|-");
+
+	yp_test_prefilter(".spec.containers", "kind: Service\nspec: {ports: [80]}\n", 0);
+	yp_test_prefilter(".spec.containers", "kind: Pod\nspec:\n  containers: []\n", 1);
+	yp_test_prefilter(".metadata.name",   "\"meta\\x64ata\": {name: x}\n", 1);
+	yp_test_prefilter("['a b'].c",        "c: 1\n", 1);
+	yp_test_prefilter("&anc.key",         "a: &anc {k: 1}\n", 0);
+	yp_test_prefilter("$[0]",             "a: 1\n", 1);
+	yp_test_prefilter(".key",             "", 0);
+
+	yaml =
+		"# Stream of documents\n"
+		"a: 0\n"
+		"--- {a: 1}\n"
+		"---\n"
+		"a: [2]\n"
+		"--- {a: 3}\n";
+
+	yp_test("#1.a",                      "--- 1");
+	yp_test("#[0,2].a",                  "0\n--- [2]");
+	yp_test("#[1:].a",                   "--- 1\n--- [2]\n--- 3");
+	yp_test("#[4:].a",                   "");
+	yp_test_events("#2",                 "{ a [ 2 ] }");
+	yp_test_events("#[0,3].a",           "0 3");
+	yp_test_events("#[1:3].a",           "1 [ 2 ]");
+
+	feed_chunk = 3;
+	yp_test_events(".a",                 "0 1 [ 2 ] 3");
+	yp_test_events("#[1,3].a",           "1 3");
+
+	yaml = "a: 0\n...\n--- {a: 1}\n";
+	yp_test_events(".a",                 "0 1");
+	yaml = "a: 0\n...\na: [1]\n... # end\n{a: 2}\n";
+	yp_test_events(".a",                 "0 [ 1 ] 2");
+	yp_test_events("#1.a",               "[ 1 ]");
+
+	yaml = "--- {a: &x [1], b: 2}\n--- {b: &x [3], c: [4]}\n";
+	yp_test_events("&x",                 "[ 1 ] [ 3 ]");
+	feed_chunk = 0;
+	yp_test_events("&x",                 "[ 1 ] [ 3 ]");
+
+	// Documents parsed on their own keep their positions in the input
+	yaml = "a: 1\n---\na: 2\n---\na: 3\n";
+	yp_test_driver_matches("#1.a",       "2@2");
+	yp_test_driver_matches("#[0,2].a",   "1@0|3@4");
+	feed_chunk = 3;
+	yp_test_driver_matches(".a",         "1@0|2@2|3@4");
+	yp_test_driver_matches("#1.a",       "2@2");
+	yaml = "a: 1\n---\na: 2\n";
+	yp_test_driver_matches(".a",         "1@0|2@2");
+	yaml = "x: 0\n---\na: 1\nb:\n  a: 2\nc: 3\n";
+	yp_test_driver_matches(".b.a",       "2@4");
+	yp_test_driver_matches("#1.c",       "3@5");
+	feed_chunk = 0;
+
+	// Matches are at byte offsets, marks count characters
+	yaml = "\xef\xbb\xbf\xc3\xa9: 1\nkey: \xc3\xbc\nb: [\xc3\xa4, 2]\n---\n\xe2\x82\xac: {c: \xc3\xb6}\n";
+	yp_test_driver_matches(".key",       "\xc3\xbc@1");
+	yp_test_driver_matches(".b",         "[\xc3\xa4, 2]@2");
+	yp_test_driver_matches("#1.\xe2\x82\xac", "{c: \xc3\xb6}@4");
+	feed_chunk = 3;
+	yp_test_driver_matches("#1.*.c",     "\xc3\xb6@4");
+	yp_test_driver_matches(".b",         "[\xc3\xa4, 2]@2");
+	feed_chunk = 0;
+
+	// Entries of the root collection are sent once the next one starts
+	yaml = "a: 1\nb: [2]\nc: 3\n";
+	yp_test_feed("[*]",                  "{ a 1 b [ 2 ] | c 3 }");
+	yp_test_feed(".b",                   "[ 2 ] |");
+	yaml = "- 1\n- [2]\n# end\n- 3\n...\n- 4\n- 5\n";
+	yp_test_feed("[:]",                  "[ 1 [ 2 ] 3 ] [ 4 | 5 ]");
+	yaml = "%YAML 1.1\n---\na:\n- 1\n- 2\nb: 3\n";
+	yp_test_feed("[*]",                  "{ a [ 1 2 ] | b 3 }");
+	yaml = "%YAML 1.1\n--- {a: 0}\n...\n%YAML 1.1\n---\na: 1\n";
+	yp_test_feed(".a",                   "0 | 1");
+	yp_test_events("#1.a",               "1");
+	// The rest of the document is parsed at its end if an entry doesn't
+	// parse on its own
+	yaml = "a: 1\nb: \"x\ny\"\nc: 3\n";
+	yp_test_feed("[*]",                  "{ a 1 | b x y c 3 }");
+	yaml = "%TAG !e! tag:e,2000:\n---\na: 1\nb: !e!x 2\nc: 3\n";
+	yp_test_feed("[*]",                  "{ a 1 | b 2 c 3 }");
+	yaml = "x\ny\nz\n";
+	yp_test_feed("$",                    "| x y z");
+
+	// Parts of indexed files keep their positions in the file
+	index_seek = 1;
+	yaml = "x: 0\na:\n  b:\n    c: 1\n";
+	yp_test_driver_matches(".a.b.c",     "1@3");
+	yaml = "---\nx: [0]\ny: {z: [1, 2]}\n...\n";
+	yp_test_driver_matches(".y.z[1]",    "2@2");
+	yp_test_driver_matches(".y",         "{z: [1, 2]}@2");
+	// Steps skipped by the seek don't stick to the path
+	index_seek = 2;
+	yp_test_driver_matches(".y.z[1]",    "2@2|2@2");
+	yp_test_driver_matches(".y",         "{z: [1, 2]}@2|{z: [1, 2]}@2");
+	index_seek = 0;
+
+	yaml =
+		"metrics:\n"
+		"- {value: 1}\n"
+		"- {value: -2.5}\n"
+		"- {value: 0x10}\n"
+		"- {value: ~}\n"
+		"- {value: '3'}\n"
+		"- {value: true}\n"
+		"- {value: -.inf}\n"
+		"- {value: 1e3}\n"
+		"- {value: !!int '7'}\n"
+		"- {value: 9223372036854775808}\n"
+		"- {value: FALSE}\n"
+		"- {value: ! 5}\n";
+
+	yp_test_column(".metrics[:].value", YAML_PATH_COLUMN_INT64,  "1 - 16 - - - - - 7 - - -");
+	yp_test_column(".metrics[:].value", YAML_PATH_COLUMN_DOUBLE, "1 -2.5 16 - - - -inf 1000 7 9.22337e+18 - -");
+	yp_test_column(".metrics[:].value", YAML_PATH_COLUMN_BOOL,   "- - - - - 1 - - - - 0 -");
+
+	// Large sequences are split into chunks for the parallel parsing
+	size_t big_size = 4096 * 128;
+	char *big = malloc(big_size), *pos = big;
+	pos += sprintf(pos, "# Items\nitems:\n");
+	for (int i = 0; i < 4096; i++) {
+		pos += sprintf(pos, "- name: item-%d # comment\n  data: {a: [%d, 'x']}\n\n  text: |\n    line %d\n\n    - not an item\n", i, i, i);
+	}
+	sprintf(pos, "other: [1]\n");
+	yp_test_parallel(".items[:].name",   big, 4);
+	yp_test_parallel(".items[:]",        big, 3);
+	yp_test_parallel(".items",           big, 4);
+
+	pos = big;
+	for (int i = 0; i < 8192; i++)
+		pos += sprintf(pos, "- [{x: %d}, \"%d\"]\n", i, i);
+	yp_test_parallel("[:][0].x",         big, 4);
+	yp_test_parallel("[:]",              big, 8);
+	// Quoted scalars continued by item lines split the later chunks wrong, the
+	// serial run follows the sent items
+	for (int i = 0; i < 8192; i++)
+		pos += sprintf(pos, "- \"%d\n- %d\"\n", i, i);
+	yp_test_parallel("[:]",              big, 4);
+
+	// Large block scalars are decoded from the input by the driver
+	pos = big;
+	pos += sprintf(pos, "kind: Secret # comment\ndata:\n  cert: |\n");
+	for (int i = 0; i < 8192; i++)
+		pos += sprintf(pos, "    line %d\n%s", i, i % 100 ? "" : "\n");
+	pos += sprintf(pos, "  folded: !!str >-\n\n    a\n    b\n\n      more\n    c\n    d\n\n\n");
+	pos += sprintf(pos, "  'keep': |+\n    kept\n\n\n  \"tab\": >2\n     \tx\n    y\n  small: {a: '|'}\n");
+	pos += sprintf(pos, "items:\n- |\n  item\n- - key: &a >+\n      deep\n      fold\n\n  - \"quoted |\n    text\"\n");
+	sprintf(pos, "--- |\n root\n...\n--- >\n  last\n   ");
+	yp_test_blocks(".data.cert",         big, 16, 1);
+	yp_test_blocks(".data.cert",         big, 16, 0);
+	yp_test_blocks(".data.*",            big, 1, 1);
+	yp_test_blocks(".data",              big, 1, 1);
+	yp_test_blocks(".items[:]",          big, 1, 0);
+	yp_test_blocks(".items[1][0].key",   big, 1, 1);
+	yp_test_blocks("$",                  big, 1, 1);
+	// Selected documents are parsed in the blocks mode too
+	yp_test_blocks("#0.data.cert",       big, 16, 1);
+	yp_test_blocks("#0.items[:]",        big, 1, 0);
+	yp_test_blocks("#1",                 big, 1, 1);
+	yp_test_blocks("#2",                 big, 1, 1);
+	free(big);
+	// Quotes inside plain scalars, a header line continuing a plain scalar
+	yp_test_blocks(".b",                 "a: x 'y\nb: \"it's\nc: |\n  zzzzzzzzzzzz\n\"\n", 1, 1);
+	yp_test_blocks("$",                  "a: x 'y\nb: \"it's\nc: |\n  zzzzzzzzzzzz\n\"\n", 1, 0);
+	yp_test_blocks("$",                  "key:\n  plain start\n  - |\n    zzzzzzzzzzzz\nb: |\n  bbbbbbbbbbbb\n", 1, 1);
+	yp_test_blocks("#1",                 "---\n---\nkey:\n  plain start\n  - |\n    zzzzzzzzzzzz\nb: |\n  bbbbbbbbbbbb\n", 1, 1);
+
+	// Limits see the values of the block scalars, not the placeholders
+	yaml = "a: |\n  zzzzzzzzzzzz\n  zzzzzzzzzzzz\nb: 1\n";
+	limits_blocks = 1;
+	yp_test_limits("$",        &(yaml_path_limits_t){.max_scalar_length = 20}, 1, YAML_PATH_ERROR_LIMIT_SCALAR);
+	yp_test_limits(".b",       &(yaml_path_limits_t){.max_scalar_length = 20}, 0, YAML_PATH_ERROR_LIMIT_SCALAR);
+	yp_test_limits("$",        &(yaml_path_limits_t){.max_scalar_length = 26}, 1, YAML_PATH_ERROR_NONE);
+	// Chunks of the values count as output (no output is set with -1)
+	yp_test_limits(".a",       &(yaml_path_limits_t){.max_output_bytes = 20}, -1, YAML_PATH_ERROR_LIMIT_OUTPUT);
+	yp_test_limits(".a",       &(yaml_path_limits_t){.max_output_bytes = 26}, -1, YAML_PATH_ERROR_NONE);
+	limits_blocks = 0;
+}
+
+int main (int argc, char *argv[])
+{
+    (void) argc; (void) argv; // Yep, we don't need them
+
+	yp_tests();
+	// Same results are expected from both engines
+	printf("\nGeneric engine:\n\n");
+	generic = 1;
+	yp_tests();
 
 	return test_result;
 }
@@ -17,6 +17,38 @@ yamlp_test()
 	fi
 }
 
+yamlp_index_test()
+{
+	echo "$1 (index):"
+	echo -n "	($2) "
+	cp "$1" "${BINARY_DIR:-../build}/index-test.yaml" || return 1
+	out=$("${BINARY_DIR:-../build}/yamlp" -F -f "${BINARY_DIR:-../build}/index-test.yaml" "$2") || return 1
+	out_index=$("${BINARY_DIR:-../build}/yamlp" -F -i -f "${BINARY_DIR:-../build}/index-test.yaml" "$2") || return 1
+	out_reuse=$("${BINARY_DIR:-../build}/yamlp" -F -i -f "${BINARY_DIR:-../build}/index-test.yaml" "$2") || return 1
+	rm -f "${BINARY_DIR:-../build}/index-test.yaml" "${BINARY_DIR:-../build}/index-test.yaml.ypi"
+	echo -n "-> $out_reuse"
+	if [ "$out_index" != "$out" ] || [ "$out_reuse" != "$out" ]; then
+		echo ": FAILED, expected result: $out"
+		return 2
+	else
+		echo ": OK"
+	fi
+}
+
+yamlp_raw_test()
+{
+	echo "$2 $1:"
+	echo -n "	($3) "
+	out=$("${BINARY_DIR:-../build}/yamlp" "$2" -f "$1" "$3" | tr '\n\0' '|,') || return 1
+	echo -n "-> $out"
+	if [ "$out" != "$4" ]; then
+		echo ": FAILED, expected result: $4"
+		return 2
+	else
+		echo ": OK"
+	fi
+}
+
 yamlp_test "${SOURCE_DIR:-..}/res/openshift-logging.yaml" ".spec.pipelines[:].inputSource" "[logs.app, logs.infra, logs.audit]"
 res=$((res+$?))
 
@@ -24,4 +56,214 @@ yamlp_test "${SOURCE_DIR:-..}/res/openshift-upgradeable.yaml" ".status.condition
            '[{status: "False", type: Degraded}, {status: "False", type: Progressing}, {status: "True", type: Available}, {status: "True", type: Upgradeable}]'
 res=$((res+$?))
 
+yamlp_raw_test "${SOURCE_DIR:-..}/res/openshift-logging.yaml" -r ".spec.pipelines[:].inputSource" "logs.app|logs.infra|logs.audit|"
+res=$((res+$?))
+
+yamlp_raw_test "${SOURCE_DIR:-..}/res/openshift-upgradeable.yaml" -0 ".status.conditions[:]['status','type']" \
+               "False,Degraded,False,Progressing,True,Available,True,Upgradeable,"
+res=$((res+$?))
+
+yamlp_raw_test "${SOURCE_DIR:-..}/res/openshift-logging.yaml" -P ".spec.pipelines[:].inputSource" "- logs.app|- logs.infra|- logs.audit|"
+res=$((res+$?))
+
+yamlp_raw_test "${SOURCE_DIR:-..}/res/openshift-upgradeable.yaml" -P0 ".status.conditions[:].type" "Degraded,Progressing,Available,Upgradeable,"
+res=$((res+$?))
+
+yamlp_raw_test "${SOURCE_DIR:-..}/res/openshift-logging.yaml" -c ".spec.pipelines[:].outputRefs[:]" "4|"
+res=$((res+$?))
+
+yamlp_raw_test "${SOURCE_DIR:-..}/res/openshift-logging.yaml" -cc ".spec.pipelines[:].outputRefs" "2|1|1|"
+res=$((res+$?))
+
+yamlp_raw_test "${SOURCE_DIR:-..}/res/openshift-logging.yaml" -c ".spec.containers[:]" "0|"
+res=$((res+$?))
+
+yamlp_exists_test()
+{
+	echo "-e $1:"
+	echo -n "	($2) "
+	"${BINARY_DIR:-../build}/yamlp" -e -f "$1" "$2"
+	out=$?
+	echo -n "-> $out"
+	if [ "$out" != "$3" ]; then
+		echo ": FAILED, expected result: $3"
+		return 2
+	else
+		echo ": OK"
+	fi
+}
+
+yamlp_exists_test "${SOURCE_DIR:-..}/res/openshift-logging.yaml" ".spec.pipelines[2].name" 0
+res=$((res+$?))
+
+yamlp_exists_test "${SOURCE_DIR:-..}/res/openshift-logging.yaml" ".spec.pipelines[3].name" 5
+res=$((res+$?))
+
+yamlp_exists_test "${SOURCE_DIR:-..}/res/openshift-logging.yaml" ".spec.containers" 5
+res=$((res+$?))
+
+yamlp_gzip_test()
+{
+	echo "$1 (gzip):"
+	echo -n "	($2) "
+	command -v gzip > /dev/null || { echo "-> no gzip: SKIPPED"; return 0; }
+	gzip -c "$1" > "${BINARY_DIR:-../build}/gzip-test.yaml.gz" || return 1
+	out=$("${BINARY_DIR:-../build}/yamlp" -F -f "$1" "$2") || return 1
+	out_gzip=$("${BINARY_DIR:-../build}/yamlp" -F -f "${BINARY_DIR:-../build}/gzip-test.yaml.gz" "$2") || return 1
+	out_stdin=$(cat "${BINARY_DIR:-../build}/gzip-test.yaml.gz" "${BINARY_DIR:-../build}/gzip-test.yaml.gz" | "${BINARY_DIR:-../build}/yamlp" -c "$2") || return 1
+	rm -f "${BINARY_DIR:-../build}/gzip-test.yaml.gz"
+	echo -n "-> $out_gzip"
+	if [ "$out_gzip" != "$out" ]; then
+		echo ": FAILED, expected result: $out"
+		return 2
+	elif [ "$out_stdin" != "2" ]; then
+		echo ": FAILED, expected 2 matches in the concatenated stream: $out_stdin"
+		return 2
+	else
+		echo ": OK"
+	fi
+}
+
+yamlp_gzip_test "${SOURCE_DIR:-..}/res/openshift-logging.yaml" ".spec.pipelines[1]"
+res=$((res+$?))
+
+yamlp_follow_test()
+{
+	echo "$1 (follow):"
+	echo -n "	($2) "
+	out=$("${BINARY_DIR:-../build}/yamlp" -F -f "$1" "$2") || return 1
+	out_follow=$({ cat "$1"; printf '\n---\n'; cat "$1"; } | "${BINARY_DIR:-../build}/yamlp" --follow -F "$2") || return 1
+	echo -n "-> $out_follow"
+	if [ "$out_follow" != "$(printf -- '%s\n--- %s' "$out" "$out")" ]; then
+		echo ": FAILED, expected result: $out (twice)"
+		return 2
+	else
+		echo ": OK"
+	fi
+}
+
+yamlp_follow_test "${SOURCE_DIR:-..}/res/openshift-upgradeable.yaml" ".status.conditions[0].type"
+res=$((res+$?))
+
+yamlp_follow_truncate_test()
+{
+	echo "follow (truncated):"
+	echo -n "	($1) "
+	file="${BINARY_DIR:-../build}/follow-test.yaml"
+	printf 'a: 1\n---\na: 2\n' > "$file"
+	"${BINARY_DIR:-../build}/yamlp" --follow -f "$file" "$1" > "$file.out" 2> /dev/null &
+	pid=$!
+	# The follow interval is 100 ms
+	sleep 0.5
+	: > "$file"
+	sleep 0.5
+	printf 'a: 3\n' >> "$file"
+	sleep 0.5
+	printf -- '---\na: 4\n' >> "$file"
+	sleep 0.5
+	kill -INT $pid
+	wait $pid
+	status=$?
+	out=$(tr '\n' '|' < "$file.out")
+	rm -f "$file" "$file.out"
+	echo -n "-> $out"
+	if [ $status != 0 ] || [ "$out" != "$2" ]; then
+		echo ": FAILED, expected result: $2"
+		return 2
+	else
+		echo ": OK"
+	fi
+}
+
+yamlp_follow_truncate_test ".a" "1|--- 2|--- 3|--- 4|"
+res=$((res+$?))
+
+yamlp_block_test()
+{
+	echo "$1 (blocks):"
+	echo -n "	($2) "
+	out=$("${BINARY_DIR:-../build}/yamlp" -0 -f "$1" "$2" | od -c) || return 1
+	out_block=$("${BINARY_DIR:-../build}/yamlp" -b 1 -0 -f "$1" "$2" | od -c) || return 1
+	out_emit=$("${BINARY_DIR:-../build}/yamlp" -F -f "$1" "$2") || return 1
+	out_block_emit=$("${BINARY_DIR:-../build}/yamlp" -b 1 -F -f "$1" "$2") || return 1
+	echo -n "-> $(echo "$out_block" | wc -l) lines"
+	if [ "$out_block" != "$out" ] || [ "$out_block_emit" != "$out_emit" ]; then
+		echo ": FAILED, expected result: $out"
+		return 2
+	else
+		echo ": OK"
+	fi
+}
+
+yamlp_block_test "${SOURCE_DIR:-..}/res/openshift-configmap.yaml" ".data.*"
+res=$((res+$?))
+
+yamlp_digest_test()
+{
+	echo "$1 (digests):"
+	echo -n "	($2) "
+	out=$("${BINARY_DIR:-../build}/yamlp" -dd -f "$1" "$2") || return 1
+	# Same content in the flow style
+	out_flow=$("${BINARY_DIR:-../build}/yamlp" -F -f "$1" '$' | "${BINARY_DIR:-../build}/yamlp" -dd "$2") || return 1
+	echo -n "-> $(echo "$out" | wc -l) digests"
+	if [ "$out_flow" != "$out" ] || [ -z "$out" ]; then
+		echo ": FAILED, expected result: $out"
+		return 2
+	else
+		echo ": OK"
+	fi
+}
+
+yamlp_digest_test "${SOURCE_DIR:-..}/res/openshift-upgradeable.yaml" ".status.conditions[:]"
+res=$((res+$?))
+
+yamlp_shape_test()
+{
+	echo "$1 (shape):"
+	echo -n "	($2) "
+	out=$("${BINARY_DIR:-../build}/yamlp" -F --shape -f "$1" "$2") || return 1
+	# Same content in the flow style
+	out_flow=$("${BINARY_DIR:-../build}/yamlp" -F -f "$1" '$' | "${BINARY_DIR:-../build}/yamlp" -F --shape "$2") || return 1
+	# The file is skipped, the shape is empty
+	out_missing=$("${BINARY_DIR:-../build}/yamlp" -F --shape -f "$1" "$2.missingKey") || return 1
+	echo -n "-> $(echo "$out" | wc -c) bytes"
+	if [ "$out_flow" != "$out" ] || [ "$out_missing" != "{}" ] || [ "$out" = "{}" ]; then
+		echo ": FAILED, expected result: $out"
+		return 2
+	else
+		echo ": OK"
+	fi
+}
+
+yamlp_shape_test "${SOURCE_DIR:-..}/res/openshift-upgradeable.yaml" ".status.conditions"
+res=$((res+$?))
+
+yamlp_documents_test()
+{
+	echo "documents:"
+	echo -n "	($1) "
+	file="${BINARY_DIR:-../build}/documents-test.yaml"
+	# The unselected document is skipped without parsing
+	printf 'a: [1\n---\na: 2\n' > "$file"
+	out=$("${BINARY_DIR:-../build}/yamlp" -F -f "$file" "$1")
+	status=$?
+	rm -f "$file"
+	echo -n "-> $out"
+	if [ $status != 0 ] || [ "$out" != "$2" ]; then
+		echo ": FAILED, expected result: $2"
+		return 2
+	else
+		echo ": OK"
+	fi
+}
+
+yamlp_documents_test "#1.a" "--- 2"
+res=$((res+$?))
+
+yamlp_index_test "${SOURCE_DIR:-..}/res/openshift-logging.yaml" ".spec.pipelines[1].outputRefs"
+res=$((res+$?))
+
+yamlp_index_test "${SOURCE_DIR:-..}/res/openshift-upgradeable.yaml" ".status.conditions[:]['status','type']"
+res=$((res+$?))
+
 exit $res